@@ -23,12 +23,26 @@ del *.pdb > NUL 2> NUL
 
 REM USING GLSL IN VK USING GLSLANGVALIDATOR
 call glslangValidator -DGRID_FRUSTUM=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_grid_frustum.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DINSTANCE_CULLING=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_instance_culling.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DDRAW_COMPACTION=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_draw_compaction.spv %CodeDir%\tiled_deferred_shaders.cpp
 call glslangValidator -DLIGHT_CULLING=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_light_culling.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DLIGHT_CULLING=1 -DLIGHT_BITMASK=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_light_culling_bitmask.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator --target-env vulkan1.1 -DLIGHT_CULLING=1 -DSUBGROUP_OPS=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_light_culling_subgroup.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DCLUSTER_LIGHT_CULLING=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_cluster_light_culling.spv %CodeDir%\tiled_deferred_shaders.cpp
 call glslangValidator -DGBUFFER_VERT=1 -S vert -e main -g -V -o %DataDir%\shader_tiled_deferred_gbuffer_vert.spv %CodeDir%\tiled_deferred_shaders.cpp
 call glslangValidator -DGBUFFER_FRAG=1 -S frag -e main -g -V -o %DataDir%\shader_tiled_deferred_gbuffer_frag.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DGBUFFER_FRAG=1 -DGBUFFER_COMPACT=1 -S frag -e main -g -V -o %DataDir%\shader_tiled_deferred_gbuffer_compact_frag.spv %CodeDir%\tiled_deferred_shaders.cpp
 call glslangValidator -DTILED_DEFERRED_LIGHTING_VERT=1 -S vert -e main -g -V -o %DataDir%\shader_tiled_deferred_lighting_vert.spv %CodeDir%\tiled_deferred_shaders.cpp
 call glslangValidator -DTILED_DEFERRED_LIGHTING_FRAG=1 -S frag -e main -g -V -o %DataDir%\shader_tiled_deferred_lighting_frag.spv %CodeDir%\tiled_deferred_shaders.cpp
-
+call glslangValidator -DTILED_DEFERRED_LIGHTING_FRAG=1 -DGBUFFER_COMPACT=1 -S frag -e main -g -V -o %DataDir%\shader_tiled_deferred_lighting_compact_frag.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DTILED_DEFERRED_LIGHTING_COMP=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_lighting_comp.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DTILED_DEFERRED_LIGHTING_COMP=1 -DGBUFFER_COMPACT=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_lighting_compact_comp.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DTILED_DEFERRED_LIGHTING_COMP=1 -DLIGHTING_BUCKET=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_lighting_directional_comp.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DTILED_DEFERRED_LIGHTING_COMP=1 -DLIGHTING_BUCKET=2 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_lighting_point_comp.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DTILED_DEFERRED_LIGHTING_COMP=1 -DLIGHTING_BUCKET=1 -DGBUFFER_COMPACT=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_lighting_directional_compact_comp.spv %CodeDir%\tiled_deferred_shaders.cpp
+call glslangValidator -DTILED_DEFERRED_LIGHTING_COMP=1 -DLIGHTING_BUCKET=2 -DGBUFFER_COMPACT=1 -S comp -e main -g -V -o %DataDir%\shader_tiled_deferred_lighting_point_compact_comp.spv %CodeDir%\tiled_deferred_shaders.cpp
+
+call glslangValidator -DVERTEX_SHADER=1 -S vert -e main -g -V -o %DataDir%\shader_copy_to_swap_vert.spv %CodeDir%\shader_copy_to_swap.cpp
 call glslangValidator -DFRAGMENT_SHADER=1 -S frag -e main -g -V -o %DataDir%\shader_copy_to_swap_frag.spv %CodeDir%\shader_copy_to_swap.cpp
 
 REM USING HLSL IN VK USING DXC
@@ -21,6 +21,7 @@ struct instance_entry
     float SpecularPower;
     float RimBound;
     float RimThreshold;
+    uint MeshId;
 };
 
 #define SCENE_DESCRIPTOR_LAYOUT(set_number)                             \
@@ -40,12 +41,7 @@ struct instance_entry
         point_light PointLights[];                                      \
     };                                                                  \
                                                                         \
-    layout(set = set_number, binding = 3) buffer point_light_transforms \
-    {                                                                   \
-        mat4 PointLightTransforms[];                                    \
-    };                                                                  \
-                                                                        \
-    layout(set = set_number, binding = 4) buffer directional_light_buffer \
+    layout(set = set_number, binding = 3) buffer directional_light_buffer \
     {                                                                   \
         directional_light DirectionalLight;                             \
     };                                                                  \
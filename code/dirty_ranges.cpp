@@ -0,0 +1,103 @@
+
+inline dirty_ranges DirtyRangesCreate(linear_arena* Arena, u32 MaxNumElements)
+{
+    dirty_ranges Result = {};
+    Result.MaxNumElements = MaxNumElements;
+    u32 NumWords = (MaxNumElements + 63) / 64;
+    Result.Bits = PushArray(Arena, u64, NumWords);
+    for (u32 WordId = 0; WordId < NumWords; ++WordId)
+    {
+        Result.Bits[WordId] = 0;
+    }
+    Result.MinWord = NumWords;
+    Result.MaxWord = 0;
+
+    return Result;
+}
+
+inline void DirtyRangesMark(dirty_ranges* Ranges, u32 ElementId)
+{
+    Assert(ElementId < Ranges->MaxNumElements);
+    u32 WordId = ElementId / 64;
+    Ranges->Bits[WordId] |= u64(1) << (ElementId % 64);
+    Ranges->MinWord = Min(Ranges->MinWord, WordId);
+    Ranges->MaxWord = Max(Ranges->MaxWord, WordId + 1);
+}
+
+inline void DirtyRangesMarkRange(dirty_ranges* Ranges, u32 FirstElementId, u32 NumElements)
+{
+    if (NumElements == 0)
+    {
+        return;
+    }
+    
+    u32 OnePastLast = FirstElementId + NumElements;
+    Assert(OnePastLast <= Ranges->MaxNumElements);
+    for (u32 ElementId = FirstElementId; ElementId < OnePastLast;)
+    {
+        u32 WordId = ElementId / 64;
+        u32 BitId = ElementId % 64;
+        u32 NumBits = Min(64 - BitId, OnePastLast - ElementId);
+        u64 Mask = NumBits == 64 ? ~u64(0) : ((u64(1) << NumBits) - 1) << BitId;
+        Ranges->Bits[WordId] |= Mask;
+        ElementId += NumBits;
+    }
+    Ranges->MinWord = Min(Ranges->MinWord, FirstElementId / 64);
+    Ranges->MaxWord = Max(Ranges->MaxWord, (OnePastLast - 1) / 64 + 1);
+}
+
+inline b32 DirtyRangesEmpty(dirty_ranges* Ranges)
+{
+    b32 Result = Ranges->MinWord >= Ranges->MaxWord;
+    return Result;
+}
+
+/*
+
+  NOTE: Pushes copies of the dirty elements of Src into DstBuffer (same element offsets) and clears the dirty bits. Returns the
+        number of copies, the caller declares the transfer write on the graph if there were any.
+  
+ */
+inline u32 DirtyRangesUpload(dirty_ranges* Ranges, frame_staging* Staging, VkBuffer DstBuffer, void* Src, u32 ElementSize)
+{
+    u32 NumRuns = 0;
+    u32 RunStarts[DIRTY_RANGES_MAX_COPIES];
+    u32 RunEnds[DIRTY_RANGES_MAX_COPIES];
+    
+    for (u32 WordId = Ranges->MinWord; WordId < Ranges->MaxWord; ++WordId)
+    {
+        u64 Word = Ranges->Bits[WordId];
+        Ranges->Bits[WordId] = 0;
+        for (u32 BitId = 0; Word != 0; ++BitId, Word >>= 1)
+        {
+            if (!(Word & 1))
+            {
+                continue;
+            }
+            
+            u32 ElementId = 64 * WordId + BitId;
+            if (NumRuns > 0 && (ElementId - RunEnds[NumRuns - 1] <= DIRTY_RANGES_MERGE_GAP || NumRuns == DIRTY_RANGES_MAX_COPIES))
+            {
+                RunEnds[NumRuns - 1] = ElementId + 1;
+            }
+            else
+            {
+                RunStarts[NumRuns] = ElementId;
+                RunEnds[NumRuns] = ElementId + 1;
+                NumRuns += 1;
+            }
+        }
+    }
+    Ranges->MinWord = (Ranges->MaxNumElements + 63) / 64;
+    Ranges->MaxWord = 0;
+
+    for (u32 RunId = 0; RunId < NumRuns; ++RunId)
+    {
+        VkDeviceSize Offset = VkDeviceSize(ElementSize) * RunStarts[RunId];
+        VkDeviceSize Size = VkDeviceSize(ElementSize) * (RunEnds[RunId] - RunStarts[RunId]);
+        void* Dst = FrameStagingPushRange(Staging, DstBuffer, Offset, Size);
+        Copy((u8*)Src + Offset, Dst, Size);
+    }
+
+    return NumRuns;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+/*
+
+  NOTE: Tracks which elements of a retained array changed since the last upload, one bit per element. The upload walks the dirty
+        words only and turns runs of dirty elements into copy regions. Runs with small clean gaps between them get merged since an
+        extra copy costs more than a few bytes, and past the copy budget everything left goes into one last region.
+
+ */
+
+#define DIRTY_RANGES_MERGE_GAP 8
+#define DIRTY_RANGES_MAX_COPIES 8
+
+struct dirty_ranges
+{
+    u32 MaxNumElements;
+    u64* Bits;
+    
+    // NOTE: Words [MinWord, MaxWord) hold every dirty bit
+    u32 MinWord;
+    u32 MaxWord;
+};
@@ -0,0 +1,112 @@
+
+inline u32 HostCoherentMemoryTypeGet(u32 MemoryTypeBits, VkMemoryPropertyFlags PreferredFlags = 0)
+{
+    VkPhysicalDeviceMemoryProperties MemoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(RenderState->PhysicalDevice, &MemoryProperties);
+    VkMemoryPropertyFlags RequiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    u32 Result = 0xFFFFFFFF;
+    
+    // NOTE: First try with the preferred flags on top, then settle for any host coherent type
+    VkMemoryPropertyFlags SearchFlags[] = { RequiredFlags | PreferredFlags, RequiredFlags };
+    for (u32 SearchId = 0; SearchId < ArrayCount(SearchFlags) && Result == 0xFFFFFFFF; ++SearchId)
+    {
+        for (u32 TypeId = 0; TypeId < MemoryProperties.memoryTypeCount; ++TypeId)
+        {
+            if ((MemoryTypeBits & (1 << TypeId)) &&
+                (MemoryProperties.memoryTypes[TypeId].propertyFlags & SearchFlags[SearchId]) == SearchFlags[SearchId])
+            {
+                Result = TypeId;
+                break;
+            }
+        }
+    }
+    Assert(Result != 0xFFFFFFFF);
+
+    return Result;
+}
+
+inline void FrameStagingBlockCreate(frame_staging_block* Block, VkDeviceSize Size)
+{
+    Block->Size = Size;
+
+    VkBufferCreateInfo BufferCreateInfo = {};
+    BufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    BufferCreateInfo.size = Size;
+    BufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkCheckResult(vkCreateBuffer(RenderState->Device, &BufferCreateInfo, 0, &Block->Buffer));
+
+    VkMemoryRequirements MemoryRequirements;
+    vkGetBufferMemoryRequirements(RenderState->Device, Block->Buffer, &MemoryRequirements);
+    Block->Memory = VkMemoryAllocate(RenderState->Device, HostCoherentMemoryTypeGet(MemoryRequirements.memoryTypeBits), MemoryRequirements.size);
+    VkCheckResult(vkBindBufferMemory(RenderState->Device, Block->Buffer, Block->Memory, 0));
+    VkCheckResult(vkMapMemory(RenderState->Device, Block->Memory, 0, VK_WHOLE_SIZE, 0, (void**)&Block->Data));
+}
+
+inline void FrameStagingCreate(frame_staging* Staging, VkDeviceSize BlockSize)
+{
+    *Staging = {};
+    Staging->BlockSize = BlockSize;
+    Staging->NumBlocks = 1;
+    FrameStagingBlockCreate(Staging->Blocks + 0, BlockSize);
+}
+
+inline void FrameStagingReset(frame_staging* Staging)
+{
+    // NOTE: Only once the GPU finished the frame that last used this staging memory
+    Staging->CurrBlock = 0;
+    Staging->Used = 0;
+    Staging->NumCopies = 0;
+}
+
+inline void* FrameStagingPushRange(frame_staging* Staging, VkBuffer DstBuffer, VkDeviceSize DstOffset, VkDeviceSize Size)
+{
+    VkDeviceSize Offset = (Staging->Used + FRAME_STAGING_ALIGNMENT - 1) & ~VkDeviceSize(FRAME_STAGING_ALIGNMENT - 1);
+    while (Offset + Size > Staging->Blocks[Staging->CurrBlock].Size)
+    {
+        // NOTE: Move on to the next block, blocks we kept from earlier frames get skipped if they are too small
+        Staging->CurrBlock += 1;
+        Offset = 0;
+        if (Staging->CurrBlock == Staging->NumBlocks)
+        {
+            Assert(Staging->NumBlocks < FRAME_STAGING_MAX_BLOCKS);
+            VkDeviceSize BlockSize = Staging->BlockSize;
+            while (BlockSize < Size)
+            {
+                BlockSize = 2 * BlockSize;
+            }
+            FrameStagingBlockCreate(Staging->Blocks + Staging->NumBlocks++, BlockSize);
+        }
+    }
+    Assert(Staging->NumCopies < FRAME_STAGING_MAX_COPIES);
+    frame_staging_block* Block = Staging->Blocks + Staging->CurrBlock;
+    Staging->Used = Offset + Size;
+
+    frame_staging_copy* Copy = Staging->Copies + Staging->NumCopies++;
+    Copy->SrcBuffer = Block->Buffer;
+    Copy->DstBuffer = DstBuffer;
+    Copy->Region = {};
+    Copy->Region.srcOffset = Offset;
+    Copy->Region.dstOffset = DstOffset;
+    Copy->Region.size = Size;
+
+    void* Result = Block->Data + Offset;
+    return Result;
+}
+
+inline void* FrameStagingPush(frame_staging* Staging, VkBuffer DstBuffer, VkDeviceSize Size)
+{
+    void* Result = FrameStagingPushRange(Staging, DstBuffer, 0, Size);
+    return Result;
+}
+
+inline void FrameStagingFlush(frame_staging* Staging, VkCommandBuffer CmdBuffer)
+{
+    // NOTE: No barriers here, the render graph's upload pass declares the writes
+    for (u32 CopyId = 0; CopyId < Staging->NumCopies; ++CopyId)
+    {
+        frame_staging_copy* Copy = Staging->Copies + CopyId;
+        vkCmdCopyBuffer(CmdBuffer, Copy->SrcBuffer, Copy->DstBuffer, 1, &Copy->Region);
+    }
+    Staging->NumCopies = 0;
+}
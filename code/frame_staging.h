@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+
+  NOTE: Per frame staging memory for the data that has to end up in device local buffers (the indirect draw commands the culling
+        pass fills in, dirty ranges of the retained scene), everything else gets read straight out of the upload ring. Every frame
+        in flight owns one of these, so the CPU can write the next frame while the GPU still copies out of the previous ones. It
+        gets reset once the frames fence passed, the copies into the device local buffers are recorded by the frames upload pass
+        (the queue orders them after the last frame's reads).
+
+        It starts out with one block and chains more as a frame needs them (a grown scene array gets uploaded in full). Blocks are
+        kept across resets, so after the first big frame nothing gets allocated anymore.
+
+ */
+
+#define FRAME_STAGING_MAX_COPIES 64
+#define FRAME_STAGING_MAX_BLOCKS 16
+#define FRAME_STAGING_ALIGNMENT 16
+
+struct frame_staging_copy
+{
+    VkBuffer SrcBuffer;
+    VkBuffer DstBuffer;
+    VkBufferCopy Region;
+};
+
+struct frame_staging_block
+{
+    VkBuffer Buffer;
+    VkDeviceMemory Memory;
+    u8* Data;
+    VkDeviceSize Size;
+};
+
+struct frame_staging
+{
+    VkDeviceSize BlockSize;
+    u32 NumBlocks;
+    frame_staging_block Blocks[FRAME_STAGING_MAX_BLOCKS];
+    
+    u32 CurrBlock;
+    VkDeviceSize Used; // NOTE: Of the current block
+
+    u32 NumCopies;
+    frame_staging_copy Copies[FRAME_STAGING_MAX_COPIES];
+};
+
+#define FrameStagingPushStruct(Staging, DstBuffer, type) (type*)FrameStagingPush(Staging, DstBuffer, sizeof(type))
+#define FrameStagingPushArray(Staging, DstBuffer, type, Count) (type*)FrameStagingPush(Staging, DstBuffer, sizeof(type)*(Count))
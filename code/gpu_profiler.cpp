@@ -0,0 +1,217 @@
+
+#include <stdio.h>
+
+inline void GpuProfilerCreate(gpu_profiler* Profiler)
+{
+    *Profiler = {};
+
+    VkQueryPoolCreateInfo CreateInfo = {};
+    CreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    CreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    CreateInfo.queryCount = 2 * GPU_PROFILER_MAX_TIMERS_PER_FRAME * GPU_PROFILER_FRAME_LATENCY;
+    VkCheckResult(vkCreateQueryPool(RenderState->Device, &CreateInfo, 0, &Profiler->QueryPool));
+
+    VkPhysicalDeviceProperties Properties;
+    vkGetPhysicalDeviceProperties(RenderState->PhysicalDevice, &Properties);
+    Profiler->TimestampPeriod = Properties.limits.timestampPeriod;
+}
+
+inline void GpuProfilerDestroy(gpu_profiler* Profiler)
+{
+    vkDestroyQueryPool(RenderState->Device, Profiler->QueryPool, 0);
+    *Profiler = {};
+}
+
+inline b32 GpuProfilerNameEqual(const char* A, const char* B)
+{
+    while (*A && *A == *B)
+    {
+        A++;
+        B++;
+    }
+
+    b32 Result = *A == *B;
+    return Result;
+}
+
+inline u32 GpuProfilerPassGetId(gpu_profiler* Profiler, const char* Name)
+{
+    for (u32 PassId = 0; PassId < Profiler->NumPasses; ++PassId)
+    {
+        if (GpuProfilerNameEqual(Profiler->Passes[PassId].Name, Name))
+        {
+            return PassId;
+        }
+    }
+
+    Assert(Profiler->NumPasses < GPU_PROFILER_MAX_PASSES);
+    u32 Result = Profiler->NumPasses++;
+    Profiler->Passes[Result] = {};
+    Profiler->Passes[Result].Name = Name;
+    
+    return Result;
+}
+
+inline void GpuProfilerSampleAdd(gpu_profiler_pass* Pass, f32 TimeMs)
+{
+    Pass->History[Pass->NextSample] = TimeMs;
+    Pass->NextSample = (Pass->NextSample + 1) % GPU_PROFILER_HISTORY_SIZE;
+    Pass->NumSamples = Min(Pass->NumSamples + 1, u32(GPU_PROFILER_HISTORY_SIZE));
+    Pass->TotalSamples += 1;
+}
+
+inline void GpuProfilerFrameBegin(gpu_profiler* Profiler, VkCommandBuffer CmdBuffer)
+{
+    u32 FrameSlot = Profiler->FrameId % GPU_PROFILER_FRAME_LATENCY;
+    u32 FirstQuery = 2 * GPU_PROFILER_MAX_TIMERS_PER_FRAME * FrameSlot;
+    gpu_profiler_frame* Frame = Profiler->Frames + FrameSlot;
+
+    // NOTE: Collect the timers this slot recorded GPU_PROFILER_FRAME_LATENCY frames ago. We don't pass the wait bit, if the GPU is that
+    // far behind we drop the samples instead of stalling
+    if (Frame->NumTimers > 0)
+    {
+        u64 Timestamps[2 * GPU_PROFILER_MAX_TIMERS_PER_FRAME];
+        VkResult Result = vkGetQueryPoolResults(RenderState->Device, Profiler->QueryPool, FirstQuery, 2 * Frame->NumTimers,
+                                                sizeof(Timestamps), Timestamps, sizeof(u64), VK_QUERY_RESULT_64_BIT);
+        if (Result == VK_SUCCESS)
+        {
+            // NOTE: Passes that are timed more than once in a frame get their times summed
+            f32 PassTimes[GPU_PROFILER_MAX_PASSES] = {};
+            b32 PassUsed[GPU_PROFILER_MAX_PASSES] = {};
+            for (u32 TimerId = 0; TimerId < Frame->NumTimers; ++TimerId)
+            {
+                u64 Delta = Timestamps[2*TimerId + 1] - Timestamps[2*TimerId + 0];
+                u32 PassId = Frame->PassIds[TimerId];
+                PassTimes[PassId] += f32(f64(Delta) * f64(Profiler->TimestampPeriod) / 1000000.0);
+                PassUsed[PassId] = true;
+            }
+
+            for (u32 PassId = 0; PassId < Profiler->NumPasses; ++PassId)
+            {
+                if (PassUsed[PassId])
+                {
+                    GpuProfilerSampleAdd(Profiler->Passes + PassId, PassTimes[PassId]);
+                }
+            }
+        }
+    }
+
+    Frame->NumTimers = 0;
+    vkCmdResetQueryPool(CmdBuffer, Profiler->QueryPool, FirstQuery, 2 * GPU_PROFILER_MAX_TIMERS_PER_FRAME);
+}
+
+inline void GpuProfilerFrameEnd(gpu_profiler* Profiler)
+{
+    Profiler->FrameId += 1;
+}
+
+inline u32 GpuProfilerPassBegin(gpu_profiler* Profiler, VkCommandBuffer CmdBuffer, const char* Name)
+{
+    u32 FrameSlot = Profiler->FrameId % GPU_PROFILER_FRAME_LATENCY;
+    gpu_profiler_frame* Frame = Profiler->Frames + FrameSlot;
+    
+    Assert(Frame->NumTimers < GPU_PROFILER_MAX_TIMERS_PER_FRAME);
+    u32 TimerId = Frame->NumTimers++;
+    Frame->PassIds[TimerId] = GpuProfilerPassGetId(Profiler, Name);
+
+    u32 Query = 2 * (GPU_PROFILER_MAX_TIMERS_PER_FRAME * FrameSlot + TimerId);
+    vkCmdWriteTimestamp(CmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, Profiler->QueryPool, Query);
+
+    return TimerId;
+}
+
+inline void GpuProfilerPassEnd(gpu_profiler* Profiler, VkCommandBuffer CmdBuffer, u32 TimerId)
+{
+    u32 FrameSlot = Profiler->FrameId % GPU_PROFILER_FRAME_LATENCY;
+    u32 Query = 2 * (GPU_PROFILER_MAX_TIMERS_PER_FRAME * FrameSlot + TimerId) + 1;
+    vkCmdWriteTimestamp(CmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, Profiler->QueryPool, Query);
+}
+
+inline gpu_profiler_stats GpuProfilerStatsGet(gpu_profiler* Profiler, u32 PassId)
+{
+    gpu_profiler_stats Result = {};
+    gpu_profiler_pass* Pass = Profiler->Passes + PassId;
+    if (Pass->NumSamples == 0)
+    {
+        return Result;
+    }
+
+    // NOTE: Insertion sort a copy of the history, its only a few hundred samples
+    f32 Sorted[GPU_PROFILER_HISTORY_SIZE];
+    f32 Sum = 0.0f;
+    for (u32 SampleId = 0; SampleId < Pass->NumSamples; ++SampleId)
+    {
+        f32 Sample = Pass->History[SampleId];
+        Sum += Sample;
+
+        u32 InsertId = SampleId;
+        while (InsertId > 0 && Sorted[InsertId - 1] > Sample)
+        {
+            Sorted[InsertId] = Sorted[InsertId - 1];
+            InsertId -= 1;
+        }
+        Sorted[InsertId] = Sample;
+    }
+
+    u32 P99Id = Min((Pass->NumSamples * 99) / 100, Pass->NumSamples - 1);
+    Result.MinMs = Sorted[0];
+    Result.AvgMs = Sum / f32(Pass->NumSamples);
+    Result.P99Ms = Sorted[P99Id];
+    Result.NumSamples = Pass->NumSamples;
+    
+    return Result;
+}
+
+inline gpu_profiler_stats GpuProfilerStatsGet(gpu_profiler* Profiler, const char* Name)
+{
+    gpu_profiler_stats Result = GpuProfilerStatsGet(Profiler, GpuProfilerPassGetId(Profiler, Name));
+    return Result;
+}
+
+inline void GpuProfilerHistoryClear(gpu_profiler* Profiler)
+{
+    // NOTE: Drops the samples taken so far, TotalSamples keeps counting
+    for (u32 PassId = 0; PassId < Profiler->NumPasses; ++PassId)
+    {
+        Profiler->Passes[PassId].NumSamples = 0;
+        Profiler->Passes[PassId].NextSample = 0;
+    }
+}
+
+/*
+
+  NOTE: Returns true if the pass got a sample since *LastTotalSamples, OutMs gets the newest one.
+
+ */
+inline b32 GpuProfilerLatestSampleGet(gpu_profiler* Profiler, const char* Name, u32* LastTotalSamples, f32* OutMs)
+{
+    gpu_profiler_pass* Pass = Profiler->Passes + GpuProfilerPassGetId(Profiler, Name);
+    b32 Result = Pass->TotalSamples != *LastTotalSamples;
+    if (Result)
+    {
+        u32 LatestSample = (Pass->NextSample + GPU_PROFILER_HISTORY_SIZE - 1) % GPU_PROFILER_HISTORY_SIZE;
+        *OutMs = Pass->History[LatestSample];
+        *LastTotalSamples = Pass->TotalSamples;
+    }
+
+    return Result;
+}
+
+inline b32 GpuProfilerCsvWrite(gpu_profiler* Profiler, const char* FileName)
+{
+    FILE* File = fopen(FileName, "wb");
+    if (!File)
+    {
+        return false;
+    }
+
+    fprintf(File, "pass,min_ms,avg_ms,p99_ms,num_samples\n");
+    for (u32 PassId = 0; PassId < Profiler->NumPasses; ++PassId)
+    {
+        gpu_profiler_stats Stats = GpuProfilerStatsGet(Profiler, PassId);
+        fprintf(File, "%s,%f,%f,%f,%u\n", Profiler->Passes[PassId].Name, Stats.MinMs, Stats.AvgMs, Stats.P99Ms, Stats.NumSamples);
+    }
+    
+    fclose(File);
+    return true;
+}
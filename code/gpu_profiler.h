@@ -0,0 +1,48 @@
+#pragma once
+
+/*
+
+  NOTE: GPU timestamp profiler. Every pass we wrap gets a begin/end timestamp pair. Query results are read back when a frame slot gets
+        reused, GPU_PROFILER_FRAME_LATENCY frames after it was recorded, so we never wait on the GPU to get our timings.
+  
+ */
+
+#define GPU_PROFILER_MAX_PASSES 32
+#define GPU_PROFILER_MAX_TIMERS_PER_FRAME 64
+#define GPU_PROFILER_FRAME_LATENCY 4
+#define GPU_PROFILER_HISTORY_SIZE 256
+
+struct gpu_profiler_pass
+{
+    const char* Name;
+    u32 NumSamples;
+    u32 NextSample;
+    u32 TotalSamples; // NOTE: Never wraps back, lets callers tell if a new sample arrived
+    f32 History[GPU_PROFILER_HISTORY_SIZE];
+};
+
+struct gpu_profiler_stats
+{
+    f32 MinMs;
+    f32 AvgMs;
+    f32 P99Ms;
+    u32 NumSamples;
+};
+
+struct gpu_profiler_frame
+{
+    u32 NumTimers;
+    u32 PassIds[GPU_PROFILER_MAX_TIMERS_PER_FRAME];
+};
+
+struct gpu_profiler
+{
+    VkQueryPool QueryPool;
+    f32 TimestampPeriod;
+
+    u32 NumPasses;
+    gpu_profiler_pass Passes[GPU_PROFILER_MAX_PASSES];
+
+    u32 FrameId;
+    gpu_profiler_frame Frames[GPU_PROFILER_FRAME_LATENCY];
+};
@@ -0,0 +1,352 @@
+
+//
+// NOTE: Platform
+//
+
+#ifdef _WIN32
+
+inline u32 AtomicAddU32(volatile u32* Value, u32 Addend)
+{
+    // NOTE: Returns the new value
+    u32 Result = u32(InterlockedExchangeAdd((volatile LONG*)Value, LONG(Addend))) + Addend;
+    return Result;
+}
+
+inline u32 AtomicCompareExchangeU32(volatile u32* Value, u32 New, u32 Expected)
+{
+    // NOTE: Returns the old value
+    u32 Result = u32(InterlockedCompareExchange((volatile LONG*)Value, LONG(New), LONG(Expected)));
+    return Result;
+}
+
+inline u32 AtomicLoadU32(volatile u32* Value)
+{
+    u32 Result = u32(InterlockedCompareExchange((volatile LONG*)Value, 0, 0));
+    return Result;
+}
+
+inline void AtomicStoreU32(volatile u32* Value, u32 New)
+{
+    InterlockedExchange((volatile LONG*)Value, LONG(New));
+}
+
+inline void ThreadYield()
+{
+    YieldProcessor();
+}
+
+inline u32 JobSystemNumCoresGet()
+{
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+    u32 Result = u32(SystemInfo.dwNumberOfProcessors);
+    return Result;
+}
+
+inline void JobSystemWake(job_system* System, u32 Count)
+{
+    ReleaseSemaphore(System->WakeSemaphore, LONG(Count), 0);
+}
+
+inline void JobSystemSleep(job_system* System)
+{
+    WaitForSingleObject(System->WakeSemaphore, INFINITE);
+}
+
+#else
+
+inline u32 AtomicAddU32(volatile u32* Value, u32 Addend)
+{
+    // NOTE: Returns the new value
+    u32 Result = __atomic_add_fetch(Value, Addend, __ATOMIC_ACQ_REL);
+    return Result;
+}
+
+inline u32 AtomicCompareExchangeU32(volatile u32* Value, u32 New, u32 Expected)
+{
+    // NOTE: Returns the old value
+    __atomic_compare_exchange_n(Value, &Expected, New, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return Expected;
+}
+
+inline u32 AtomicLoadU32(volatile u32* Value)
+{
+    u32 Result = __atomic_load_n(Value, __ATOMIC_ACQUIRE);
+    return Result;
+}
+
+inline void AtomicStoreU32(volatile u32* Value, u32 New)
+{
+    __atomic_store_n(Value, New, __ATOMIC_RELEASE);
+}
+
+inline void ThreadYield()
+{
+    sched_yield();
+}
+
+inline u32 JobSystemNumCoresGet()
+{
+    u32 Result = u32(sysconf(_SC_NPROCESSORS_ONLN));
+    return Result;
+}
+
+inline void JobSystemWake(job_system* System, u32 Count)
+{
+    for (u32 WakeId = 0; WakeId < Count; ++WakeId)
+    {
+        sem_post(&System->WakeSemaphore);
+    }
+}
+
+inline void JobSystemSleep(job_system* System)
+{
+    while (sem_wait(&System->WakeSemaphore) != 0)
+    {
+    }
+}
+
+#endif
+
+//
+// NOTE: Queues
+//
+
+inline void JobQueueLock(job_queue* Queue)
+{
+    while (AtomicCompareExchangeU32(&Queue->Lock, 1, 0) != 0)
+    {
+        ThreadYield();
+    }
+}
+
+inline void JobQueueUnlock(job_queue* Queue)
+{
+    AtomicStoreU32(&Queue->Lock, 0);
+}
+
+inline b32 JobQueuePopBack(job_queue* Queue, job* OutJob)
+{
+    // NOTE: The owner takes the newest job, its data is the most likely to still be in cache
+    b32 Result = false;
+    JobQueueLock(Queue);
+    if (Queue->Head != Queue->Tail)
+    {
+        Queue->Tail -= 1;
+        *OutJob = Queue->Jobs[Queue->Tail % JOB_QUEUE_SIZE];
+        Result = true;
+    }
+    JobQueueUnlock(Queue);
+
+    return Result;
+}
+
+inline b32 JobQueueStealFront(job_queue* Queue, job* OutJob)
+{
+    b32 Result = false;
+    JobQueueLock(Queue);
+    if (Queue->Head != Queue->Tail)
+    {
+        *OutJob = Queue->Jobs[Queue->Head % JOB_QUEUE_SIZE];
+        Queue->Head += 1;
+        Result = true;
+    }
+    JobQueueUnlock(Queue);
+
+    return Result;
+}
+
+inline b32 JobSystemJobGet(job_system* System, u32 WorkerId, job* OutJob)
+{
+    b32 Result = JobQueuePopBack(&System->Workers[WorkerId].Queue, OutJob);
+    for (u32 Offset = 1; !Result && Offset < System->NumWorkers; ++Offset)
+    {
+        u32 VictimId = (WorkerId + Offset) % System->NumWorkers;
+        Result = JobQueueStealFront(&System->Workers[VictimId].Queue, OutJob);
+    }
+
+    return Result;
+}
+
+inline void JobRun(job_system* System, u32 WorkerId, job* Job)
+{
+    // NOTE: The job gets a copy of the workers arena, so its allocations are gone once it returns
+    linear_arena Arena = System->Workers[WorkerId].Arena;
+    Job->Callback(WorkerId, &Arena, Job->Data);
+    AtomicAddU32(&Job->Counter->NumPending, u32(-1));
+}
+
+//
+// NOTE: Workers
+//
+
+inline void JobWorkerLoop(job_worker* Worker)
+{
+    job_system* System = Worker->System;
+    u32 WorkerId = u32(Worker - System->Workers);
+    while (!AtomicLoadU32(&System->Quit))
+    {
+        job Job;
+        if (JobSystemJobGet(System, WorkerId, &Job))
+        {
+            JobRun(System, WorkerId, &Job);
+        }
+        else
+        {
+            JobSystemSleep(System);
+        }
+    }
+}
+
+#ifdef _WIN32
+DWORD WINAPI JobWorkerThreadEntry(LPVOID Param)
+{
+    JobWorkerLoop((job_worker*)Param);
+    return 0;
+}
+#else
+void* JobWorkerThreadEntry(void* Param)
+{
+    JobWorkerLoop((job_worker*)Param);
+    return 0;
+}
+#endif
+
+inline void JobSystemStart(job_system* System)
+{
+    System->Quit = 0;
+#ifdef _WIN32
+    System->WakeSemaphore = CreateSemaphoreEx(0, 0, LONG_MAX, 0, 0, SEMAPHORE_ALL_ACCESS);
+#else
+    sem_init(&System->WakeSemaphore, 0, 0);
+#endif
+
+    // NOTE: Worker 0 is the thread that created the system
+    for (u32 WorkerId = 1; WorkerId < System->NumWorkers; ++WorkerId)
+    {
+        job_worker* Worker = System->Workers + WorkerId;
+#ifdef _WIN32
+        System->Threads[WorkerId] = CreateThread(0, 0, JobWorkerThreadEntry, Worker, 0, 0);
+        Assert(System->Threads[WorkerId]);
+#else
+        int Error = pthread_create(System->Threads + WorkerId, 0, JobWorkerThreadEntry, Worker);
+        Assert(Error == 0);
+#endif
+    }
+}
+
+inline void JobSystemStop(job_system* System)
+{
+    // NOTE: Only call this with no jobs pending, the workers finish what they are on and exit instead of going back to sleep
+    AtomicStoreU32(&System->Quit, 1);
+    JobSystemWake(System, System->NumWorkers);
+    for (u32 WorkerId = 1; WorkerId < System->NumWorkers; ++WorkerId)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(System->Threads[WorkerId], INFINITE);
+        CloseHandle(System->Threads[WorkerId]);
+#else
+        pthread_join(System->Threads[WorkerId], 0);
+#endif
+    }
+    
+#ifdef _WIN32
+    CloseHandle(System->WakeSemaphore);
+#else
+    sem_destroy(&System->WakeSemaphore);
+#endif
+}
+
+/*
+
+  NOTE: NumWorkers includes the main thread, 0 uses every core we have.
+
+ */
+inline void JobSystemCreate(job_system* System, linear_arena* Arena, u32 NumWorkers)
+{
+    if (NumWorkers == 0)
+    {
+        NumWorkers = JobSystemNumCoresGet();
+    }
+    System->NumWorkers = Min(Max(NumWorkers, 1u), u32(JOB_SYSTEM_MAX_WORKERS));
+
+    for (u32 WorkerId = 0; WorkerId < System->NumWorkers; ++WorkerId)
+    {
+        job_worker* Worker = System->Workers + WorkerId;
+        Worker->System = System;
+        Worker->Queue.Lock = 0;
+        Worker->Queue.Head = 0;
+        Worker->Queue.Tail = 0;
+        Worker->Arena = LinearSubArena(Arena, JOB_WORKER_ARENA_SIZE);
+    }
+
+    JobSystemStart(System);
+}
+
+inline void JobSystemPush(job_system* System, u32 WorkerId, job_callback* Callback, void* Data, job_counter* Counter)
+{
+    AtomicAddU32(&Counter->NumPending, 1);
+
+    job_queue* Queue = &System->Workers[WorkerId].Queue;
+    JobQueueLock(Queue);
+    Assert(Queue->Tail - Queue->Head < JOB_QUEUE_SIZE);
+    job* Job = Queue->Jobs + (Queue->Tail % JOB_QUEUE_SIZE);
+    Job->Callback = Callback;
+    Job->Data = Data;
+    Job->Counter = Counter;
+    Queue->Tail += 1;
+    JobQueueUnlock(Queue);
+
+    JobSystemWake(System, 1);
+}
+
+inline void JobSystemWait(job_system* System, u32 WorkerId, job_counter* Counter)
+{
+    // NOTE: Runs jobs (ours first, then stolen ones) until everything the counter tracks is done
+    while (AtomicLoadU32(&Counter->NumPending) > 0)
+    {
+        job Job;
+        if (JobSystemJobGet(System, WorkerId, &Job))
+        {
+            JobRun(System, WorkerId, &Job);
+        }
+        else
+        {
+            ThreadYield();
+        }
+    }
+}
+
+//
+// NOTE: Worker Command Buffers
+//
+
+inline void WorkerCommandBuffersCreate(worker_command_buffers* Commands, u32 NumPools, u32 QueueFamilyIndex)
+{
+    *Commands = {};
+    Commands->NumPools = NumPools;
+    for (u32 PoolId = 0; PoolId < NumPools; ++PoolId)
+    {
+        VkCommandPoolCreateInfo PoolCreateInfo = {};
+        PoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        PoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        PoolCreateInfo.queueFamilyIndex = QueueFamilyIndex;
+        VkCheckResult(vkCreateCommandPool(RenderState->Device, &PoolCreateInfo, 0, Commands->Pools + PoolId));
+
+        VkCommandBufferAllocateInfo AllocateInfo = {};
+        AllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        AllocateInfo.commandPool = Commands->Pools[PoolId];
+        AllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        AllocateInfo.commandBufferCount = 1;
+        VkCheckResult(vkAllocateCommandBuffers(RenderState->Device, &AllocateInfo, Commands->Buffers + PoolId));
+    }
+}
+
+inline void WorkerCommandBuffersReset(worker_command_buffers* Commands)
+{
+    // NOTE: Only once the frame that recorded into these is done on the GPU
+    for (u32 PoolId = 0; PoolId < Commands->NumPools; ++PoolId)
+    {
+        VkCheckResult(vkResetCommandPool(RenderState->Device, Commands->Pools[PoolId], 0));
+    }
+}
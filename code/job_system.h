@@ -0,0 +1,87 @@
+#pragma once
+
+/*
+
+  NOTE: Work stealing job system. Worker 0 is the main thread, the rest are OS threads that sleep on a semaphore while there is nothing
+        to do. Every worker owns a queue, jobs get pushed onto the queue of the thread pushing them and the owner pops from the back
+        while idle workers steal from the front of the other queues. Waiting on a counter runs jobs instead of blocking, so the main
+        thread helps out with its own work.
+
+        Every worker has its own linear arena for scratch memory. A job gets a copy of it, so everything it allocates is gone once it
+        returns.
+
+        The state is plain data (no std::thread/std::mutex) since it lives in demo_state, which gets zeroed by assignment.
+
+        The worker threads run code out of the demo module, so they have to be stopped before that module goes away. JobSystemStop
+        joins them and JobSystemStart spawns new ones running the current code (CodeReload does both). Nothing can be in flight
+        across a stop, every frame waits on its jobs before it returns. Pipeline builds are the exception, they run across frames and
+        get finished before a stop (PipelineCacheBuildFinish).
+
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#define JOB_SYSTEM_MAX_WORKERS 32
+#define JOB_QUEUE_SIZE 256
+#define JOB_WORKER_ARENA_SIZE MegaBytes(4)
+
+#define JOB_CALLBACK(name) void name(u32 WorkerId, linear_arena* Arena, void* Data)
+typedef JOB_CALLBACK(job_callback);
+
+struct job_counter
+{
+    volatile u32 NumPending;
+};
+
+struct job
+{
+    job_callback* Callback;
+    void* Data;
+    job_counter* Counter;
+};
+
+struct job_queue
+{
+    volatile u32 Lock;
+    u32 Head;
+    u32 Tail;
+    job Jobs[JOB_QUEUE_SIZE];
+};
+
+struct job_system;
+struct job_worker
+{
+    job_system* System;
+    job_queue Queue;
+    linear_arena Arena;
+};
+
+struct job_system
+{
+    u32 NumWorkers;
+    job_worker Workers[JOB_SYSTEM_MAX_WORKERS];
+    volatile u32 Quit;
+
+#ifdef _WIN32
+    HANDLE WakeSemaphore;
+    HANDLE Threads[JOB_SYSTEM_MAX_WORKERS];
+#else
+    sem_t WakeSemaphore;
+    pthread_t Threads[JOB_SYSTEM_MAX_WORKERS];
+#endif
+};
+
+// NOTE: One command pool per worker for a frame, so the workers can record secondary command buffers without locking
+struct worker_command_buffers
+{
+    u32 NumPools;
+    VkCommandPool Pools[JOB_SYSTEM_MAX_WORKERS];
+    VkCommandBuffer Buffers[JOB_SYSTEM_MAX_WORKERS];
+};
@@ -0,0 +1,437 @@
+/*
+
+  NOTE: Headless benchmark runner. Runs the demo against an offscreen target (no window, no swap chain) for a fixed number of frames
+        with a scripted camera and prints per frame CPU and GPU timings as JSON to stdout. Works with any Vulkan ICD, including
+        lavapipe (VK_ICD_FILENAMES=.../lvp_icd.x86_64.json).
+
+        Usage: see HeadlessUsagePrint. Unknown arguments, a flag without its value or a value that doesn't parse (counts are plain
+        decimal numbers, -frames, -width and -height at least 1, toggles 0 or 1) print the usage and exit with an error.
+
+        -meshes N adds N meshes with their own materials, every one is a draw group of its own. The GBuffer only gets recorded by
+        several workers once there are GBUFFER_MIN_DRAW_GROUPS_PER_JOB groups per job, so -meshes 64 and up exercises that path.
+
+        under_water_headless -transformbench N skips the renderer and times the batched point transform against the scalar loop
+        over N entries (100000 is a good size).
+
+ */
+
+#define HEADLESS 1
+#include "under_water_demo.cpp"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+inline f64 LinuxTimeGetMs()
+{
+    timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    f64 Result = f64(Time.tv_sec) * 1000.0 + f64(Time.tv_nsec) / 1000000.0;
+    return Result;
+}
+
+inline void HeadlessUsagePrint()
+{
+    fprintf(stderr,
+            "Usage: under_water_headless [-frames N] [-warmup N] [-width W] [-height H] [-csv pass_timings.csv]\n"
+            "                            [-lights N] [-lightcull tiled|clustered|bitmask]\n"
+            "                            [-gbuffer full|compact] [-lighting fragment|compute|classified] [-inflight 1-3]\n"
+            "                            [-specular 0|1] [-rim 0|1] [-caustics 0|1] [-tilesize 8|16|32|auto]\n"
+            "                            [-animate 0|1] [-jobs 0|1] [-meshes N]\n"
+            "       under_water_headless -transformbench N\n");
+}
+
+inline b32 HeadlessU32Parse(const char* String, u32* OutValue)
+{
+    // NOTE: Plain decimal digits only, strtoul would take signs and leading spaces and stop at the first junk character
+    if (String[0] < '0' || String[0] > '9')
+    {
+        return false;
+    }
+
+    char* End = 0;
+    unsigned long Value = strtoul(String, &End, 10);
+    b32 Result = *End == 0 && Value <= 0xFFFFFFFF;
+    *OutValue = u32(Value);
+    return Result;
+}
+
+inline soa_v3 HeadlessSoaV3Alloc(u32 Count)
+{
+    soa_v3 Result = {};
+    Result.X = (f32*)calloc(Count, sizeof(f32));
+    Result.Y = (f32*)calloc(Count, sizeof(f32));
+    Result.Z = (f32*)calloc(Count, sizeof(f32));
+
+    return Result;
+}
+
+inline void HeadlessSoaV3Free(soa_v3 Soa)
+{
+    free(Soa.X);
+    free(Soa.Y);
+    free(Soa.Z);
+}
+
+inline int TransformBenchRun(u32 NumEntries)
+{
+    u32 NumIterations = 200;
+    soa_v3 In = HeadlessSoaV3Alloc(NumEntries);
+    soa_v3 Out = HeadlessSoaV3Alloc(NumEntries);
+    for (u32 EntryId = 0; EntryId < NumEntries; ++EntryId)
+    {
+        In.X[EntryId] = f32(EntryId % 97);
+        In.Y[EntryId] = f32(EntryId % 31);
+        In.Z[EntryId] = f32(EntryId % 13);
+    }
+    m4 Transform = M4Pos(V3(1.0f, 2.0f, 3.0f)) * M4Scale(V3(0.5f));
+
+    // NOTE: Best of all iterations, the first ones also pay for faulting the pages in
+    f64 ScalarMs = 1e9;
+    f64 BatchMs = 1e9;
+    f32 CheckSum = 0.0f;
+    for (u32 IterationId = 0; IterationId < NumIterations; ++IterationId)
+    {
+        f64 StartTime = LinuxTimeGetMs();
+        TransformBatchPointsScalar(Transform, In, Out, 0, NumEntries);
+        f64 EndTime = LinuxTimeGetMs();
+        ScalarMs = EndTime - StartTime < ScalarMs ? EndTime - StartTime : ScalarMs;
+        CheckSum += Out.X[IterationId % NumEntries];
+
+        StartTime = LinuxTimeGetMs();
+        TransformBatchPoints(Transform, In, Out, NumEntries);
+        EndTime = LinuxTimeGetMs();
+        BatchMs = EndTime - StartTime < BatchMs ? EndTime - StartTime : BatchMs;
+        CheckSum += Out.X[IterationId % NumEntries];
+    }
+
+#if defined(__AVX2__)
+    const char* PathName = "avx2";
+#elif defined(__SSE2__)
+    const char* PathName = "sse";
+#else
+    const char* PathName = "scalar";
+#endif
+    
+    printf("{\n");
+    printf("  \"entries\": %u,\n", NumEntries);
+    printf("  \"iterations\": %u,\n", NumIterations);
+    printf("  \"path\": \"%s\",\n", PathName);
+    printf("  \"scalar_ms\": %.4f,\n", ScalarMs);
+    printf("  \"batch_ms\": %.4f,\n", BatchMs);
+    printf("  \"speedup\": %.2f,\n", ScalarMs / BatchMs);
+    printf("  \"checksum\": %.2f\n", CheckSum);
+    printf("}\n");
+
+    HeadlessSoaV3Free(In);
+    HeadlessSoaV3Free(Out);
+    
+    return 0;
+}
+
+int main(int ArgCount, char** Args)
+{
+    u32 NumFrames = 600;
+    u32 NumWarmupFrames = 16;
+    u32 Width = 1920;
+    u32 Height = 1080;
+    const char* CsvFileName = 0;
+    u32 NumLights = 0;
+    u32 NumMeshes = 0;
+    light_cull_mode LightCullMode = LightCullMode_Tiled;
+    gbuffer_layout GBufferLayout = GBufferLayout_Full;
+    lighting_mode LightingMode = LightingMode_Fragment;
+    b32 SpecularEnabled = false;
+    b32 RimEnabled = true;
+    b32 CausticsEnabled = true;
+    u32 TileSize = TILE_SIZE_IN_PIXELS; // NOTE: 0 runs the tile size tuner
+    u32 NumFramesInFlight = 2;
+    b32 AnimateLights = false;
+    b32 JobsEnabled = true;
+    u32 NumTransformBenchEntries = 0;
+    for (int ArgId = 1; ArgId < ArgCount; ArgId += 2)
+    {
+        if (ArgId + 1 >= ArgCount)
+        {
+            fprintf(stderr, "Missing value for %s\n", Args[ArgId]);
+            HeadlessUsagePrint();
+            return 1;
+        }
+
+        const char* Arg = Args[ArgId];
+        const char* ValueString = Args[ArgId + 1];
+        u32 Value = 0;
+        b32 IsNumber = HeadlessU32Parse(ValueString, &Value);
+        b32 IsBool = IsNumber && Value <= 1;
+        b32 ValidValue = true;
+        if (strcmp(Arg, "-csv") == 0) { CsvFileName = ValueString; }
+        else if (strcmp(Arg, "-lights") == 0) { NumLights = Value; ValidValue = IsNumber; }
+        else if (strcmp(Arg, "-meshes") == 0) { NumMeshes = Value; ValidValue = IsNumber; }
+        else if (strcmp(Arg, "-lightcull") == 0)
+        {
+            if (strcmp(ValueString, "tiled") == 0) { LightCullMode = LightCullMode_Tiled; }
+            else if (strcmp(ValueString, "clustered") == 0) { LightCullMode = LightCullMode_Clustered; }
+            else if (strcmp(ValueString, "bitmask") == 0) { LightCullMode = LightCullMode_TiledBitmask; }
+            else { ValidValue = false; }
+        }
+        else if (strcmp(Arg, "-gbuffer") == 0)
+        {
+            if (strcmp(ValueString, "full") == 0) { GBufferLayout = GBufferLayout_Full; }
+            else if (strcmp(ValueString, "compact") == 0) { GBufferLayout = GBufferLayout_Compact; }
+            else { ValidValue = false; }
+        }
+        else if (strcmp(Arg, "-lighting") == 0)
+        {
+            if (strcmp(ValueString, "fragment") == 0) { LightingMode = LightingMode_Fragment; }
+            else if (strcmp(ValueString, "compute") == 0) { LightingMode = LightingMode_Compute; }
+            else if (strcmp(ValueString, "classified") == 0) { LightingMode = LightingMode_ComputeClassified; }
+            else { ValidValue = false; }
+        }
+        else if (strcmp(Arg, "-specular") == 0) { SpecularEnabled = Value != 0; ValidValue = IsBool; }
+        else if (strcmp(Arg, "-rim") == 0) { RimEnabled = Value != 0; ValidValue = IsBool; }
+        else if (strcmp(Arg, "-caustics") == 0) { CausticsEnabled = Value != 0; ValidValue = IsBool; }
+        else if (strcmp(Arg, "-tilesize") == 0)
+        {
+            // NOTE: Only the sizes the tuner picks from, anything else (including typos) would otherwise end up in the tuner as 0
+            TileSize = 0;
+            ValidValue = strcmp(ValueString, "auto") == 0;
+            for (u32 CandidateId = 0; IsNumber && CandidateId < TILE_SIZE_NUM_CANDIDATES; ++CandidateId)
+            {
+                if (Value == TiledDeferredTileSizeCandidateGet(CandidateId))
+                {
+                    TileSize = Value;
+                    ValidValue = true;
+                }
+            }
+        }
+        else if (strcmp(Arg, "-inflight") == 0)
+        {
+            NumFramesInFlight = Value;
+            ValidValue = IsNumber && Value >= 1 && Value <= DEMO_MAX_FRAMES_IN_FLIGHT;
+        }
+        else if (strcmp(Arg, "-animate") == 0) { AnimateLights = Value != 0; ValidValue = IsBool; }
+        else if (strcmp(Arg, "-jobs") == 0) { JobsEnabled = Value != 0; ValidValue = IsBool; }
+        else if (strcmp(Arg, "-transformbench") == 0) { NumTransformBenchEntries = Value; ValidValue = IsNumber && Value > 0; }
+        else if (strcmp(Arg, "-frames") == 0) { NumFrames = Value; ValidValue = IsNumber && Value > 0; }
+        else if (strcmp(Arg, "-warmup") == 0) { NumWarmupFrames = Value; ValidValue = IsNumber; }
+        else if (strcmp(Arg, "-width") == 0) { Width = Value; ValidValue = IsNumber && Value > 0; }
+        else if (strcmp(Arg, "-height") == 0) { Height = Value; ValidValue = IsNumber && Value > 0; }
+        else
+        {
+            fprintf(stderr, "Unknown argument %s\n", Arg);
+            HeadlessUsagePrint();
+            return 1;
+        }
+
+        if (!ValidValue)
+        {
+            fprintf(stderr, "Invalid value %s for %s\n", ValueString, Arg);
+            HeadlessUsagePrint();
+            return 1;
+        }
+    }
+
+    if (NumTransformBenchEntries > 0)
+    {
+        return TransformBenchRun(NumTransformBenchEntries);
+    }
+
+    void* VulkanLib = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (!VulkanLib)
+    {
+        fprintf(stderr, "Failed to load libvulkan.so.1: %s\n", dlerror());
+        return 1;
+    }
+
+    u64 ProgramMemorySize = GigaBytes(1);
+    u8* ProgramMemory = (u8*)mmap(0, ProgramMemorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ProgramMemory == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to allocate program memory\n");
+        return 1;
+    }
+
+    // NOTE: No instance or window handles, the demo creates its device without a surface and renders into its offscreen target. Init
+    // time is mostly pipeline compiles, run twice to see what the pipeline cache saves
+    f64 InitStartTime = LinuxTimeGetMs();
+    Init(VulkanLib, 0, 0, ProgramMemory, ProgramMemorySize, Width, Height);
+    f64 InitTime = LinuxTimeGetMs() - InitStartTime;
+    DemoState->NumBenchmarkLights = NumLights;
+    DemoState->NumBenchmarkMeshes = NumMeshes;
+    DemoState->TiledDeferredState.LightCullMode = LightCullMode;
+    DemoState->TiledDeferredState.GBufferLayout = GBufferLayout;
+    DemoState->TiledDeferredState.LightingMode = LightingMode;
+    DemoState->TiledDeferredState.SpecularEnabled = SpecularEnabled;
+    DemoState->TiledDeferredState.RimEnabled = RimEnabled;
+    DemoState->TiledDeferredState.CausticsEnabled = CausticsEnabled;
+    DemoState->NumFramesInFlight = NumFramesInFlight;
+    DemoState->AnimateBenchmarkLights = AnimateLights;
+    // NOTE: Without jobs everything gets recorded on the main thread
+    DemoState->JobsEnabled = JobsEnabled;
+    DemoState->TiledDeferredState.Jobs = JobsEnabled ? &DemoState->Jobs : 0;
+
+    // NOTE: The tuner benchmarks the scene we are about to measure, its frames don't count towards the results
+    f32 FrameTime = 1.0f / 60.0f;
+    tiled_deferred_state* TiledDeferredState = &DemoState->TiledDeferredState;
+    if (TileSize == 0)
+    {
+        TiledDeferredTileTuneBegin(TiledDeferredState, &DemoState->Scene);
+        while (TiledDeferredState->TileTuner.Active)
+        {
+            HeadlessMainLoop(FrameTime);
+        }
+        GpuProfilerHistoryClear(&DemoState->Profiler);
+    }
+    else if (TiledDeferredTileSizeSupported(TileSize))
+    {
+        // NOTE: Every measured frame has to run the requested size, so we wait for its pipelines here
+        TiledDeferredTileSizeSet(TiledDeferredState, TileSize, &DemoState->Scene);
+        PipelineCacheBuildFinish(&DemoState->PipelineCache, &DemoState->Jobs);
+        TiledDeferredTileSizeUpdate(TiledDeferredState, &DemoState->Scene);
+    }
+    else
+    {
+        fprintf(stderr, "Tile size %u isn't supported by the device\n", TileSize);
+        return 1;
+    }
+
+    // NOTE: GPU times arrive NumFramesInFlight frames late, so we store everything and print once the queue is drained. Frames whose
+    // timestamps never became readable stay at -1 and get left out of the output
+    u32 NumTotalFrames = NumWarmupFrames + NumFrames;
+    f64* CpuTimes = (f64*)calloc(NumTotalFrames, sizeof(f64));
+    f32* GpuTimes = (f32*)calloc(NumTotalFrames, sizeof(f32));
+    for (u32 FrameId = 0; FrameId < NumTotalFrames; ++FrameId)
+    {
+        GpuTimes[FrameId] = -1.0f;
+    }
+    
+    u32 FirstFrameId = DemoState->FrameId;
+    for (u32 FrameId = 0; FrameId < NumTotalFrames; ++FrameId)
+    {
+        f64 StartTime = LinuxTimeGetMs();
+        f32 OldGpuTime = HeadlessMainLoop(FrameTime);
+        CpuTimes[FrameId] = LinuxTimeGetMs() - StartTime;
+        if (FrameId >= NumFramesInFlight)
+        {
+            GpuTimes[FrameId - NumFramesInFlight] = OldGpuTime;
+        }
+    }
+    HeadlessFinish();
+    for (u32 FrameId = 0; FrameId < NumTotalFrames; ++FrameId)
+    {
+        if (GpuTimes[FrameId] < 0.0f)
+        {
+            GpuTimes[FrameId] = HeadlessGpuFrameTimeGet(FirstFrameId + FrameId);
+        }
+    }
+
+    u32 NumDroppedFrames = 0;
+    u32 LastReportedFrameId = NumTotalFrames;
+    for (u32 FrameId = NumWarmupFrames; FrameId < NumTotalFrames; ++FrameId)
+    {
+        if (GpuTimes[FrameId] < 0.0f)
+        {
+            NumDroppedFrames += 1;
+        }
+        else
+        {
+            LastReportedFrameId = FrameId;
+        }
+    }
+
+    printf("{\n");
+    printf("  \"width\": %u,\n", Width);
+    printf("  \"height\": %u,\n", Height);
+    printf("  \"warmup_frames\": %u,\n", NumWarmupFrames);
+    printf("  \"lights\": %u,\n", NumLights);
+    const char* LightCullModeNames[] = { "tiled", "clustered", "bitmask" };
+    printf("  \"light_cull_mode\": \"%s\",\n", LightCullModeNames[LightCullMode]);
+    printf("  \"gbuffer_layout\": \"%s\",\n", GBufferLayout == GBufferLayout_Compact ? "compact" : "full");
+    const char* LightingModeNames[] = { "fragment", "compute", "classified" };
+    printf("  \"lighting_mode\": \"%s\",\n", LightingModeNames[LightingMode]);
+    printf("  \"lighting_features\": { \"specular\": %s, \"rim\": %s, \"caustics\": %s, \"permutations\": %u },\n",
+           SpecularEnabled ? "true" : "false", RimEnabled ? "true" : "false", CausticsEnabled ? "true" : "false",
+           DemoState->TiledDeferredState.NumLightingPermutations);
+    printf("  \"tile_size\": %u,\n", TiledDeferredState->TileSize);
+    if (TileSize == 0)
+    {
+        tile_size_tuner* Tuner = &TiledDeferredState->TileTuner;
+        printf("  \"tile_tune_ms\": { ");
+        for (u32 CandidateId = 0; CandidateId < TILE_SIZE_NUM_CANDIDATES; ++CandidateId)
+        {
+            printf("\"%u\": %.4f%s", TiledDeferredTileSizeCandidateGet(CandidateId), Tuner->CandidateMs[CandidateId],
+                   CandidateId + 1 < TILE_SIZE_NUM_CANDIDATES ? ", " : "");
+        }
+        printf(" },\n");
+    }
+    printf("  \"frames_in_flight\": %u,\n", NumFramesInFlight);
+    printf("  \"animate_lights\": %s,\n", AnimateLights ? "true" : "false");
+    printf("  \"workers\": %u,\n", JobsEnabled ? DemoState->Jobs.NumWorkers : 1);
+    printf("  \"draw_groups\": %u,\n", DemoState->Scene.NumDrawGroups);
+    printf("  \"gbuffer_jobs\": %u,\n", TiledDeferredState->NumGBufferJobs);
+    printf("  \"gbuffer_draws\": \"%s\",\n", TiledDeferredState->MultiDrawIndirect ? "indirect_count" : "per_mesh");
+    printf("  \"init_ms\": %.4f,\n", InitTime);
+    printf("  \"pipeline_cache_loaded\": %s,\n", DemoState->PipelineCache.LoadedFromDisk ? "true" : "false");
+    printf("  \"dropped_frames\": %u,\n", NumDroppedFrames);
+    printf("  \"frames\": [\n");
+    for (u32 FrameId = NumWarmupFrames; FrameId < NumTotalFrames; ++FrameId)
+    {
+        if (GpuTimes[FrameId] < 0.0f)
+        {
+            continue;
+        }
+        
+        printf("    { \"frame\": %u, \"cpu_ms\": %.4f, \"gpu_ms\": %.4f }%s\n", FrameId - NumWarmupFrames, CpuTimes[FrameId], GpuTimes[FrameId],
+               FrameId < LastReportedFrameId ? "," : "");
+    }
+    printf("  ],\n");
+
+    // NOTE: Rolling per pass GPU stats from the profiler
+    gpu_profiler* Profiler = &DemoState->Profiler;
+    printf("  \"passes\": [\n");
+    for (u32 PassId = 0; PassId < Profiler->NumPasses; ++PassId)
+    {
+        gpu_profiler_stats Stats = GpuProfilerStatsGet(Profiler, PassId);
+        printf("    { \"name\": \"%s\", \"min_ms\": %.4f, \"avg_ms\": %.4f, \"p99_ms\": %.4f, \"samples\": %u }%s\n",
+               Profiler->Passes[PassId].Name, Stats.MinMs, Stats.AvgMs, Stats.P99Ms, Stats.NumSamples,
+               PassId + 1 < Profiler->NumPasses ? "," : "");
+    }
+    printf("  ],\n");
+
+    // NOTE: Light index list sizing, overflows mean some tile lights got dropped
+    light_list_stats* LightListStats = &DemoState->TiledDeferredState.LightListStats;
+    printf("  \"light_lists\": { \"required_o\": %u, \"required_t\": %u, \"capacity_o\": %u, \"capacity_t\": %u, "
+           "\"tile_overflows\": %u, \"list_truncations\": %u, \"resizes\": %u },\n",
+           LightListStats->Required_O, LightListStats->Required_T, DemoState->TiledDeferredState.LightIndexList_O.Capacity,
+           DemoState->TiledDeferredState.LightIndexList_T.Capacity, LightListStats->NumTileOverflows, LightListStats->NumListTruncations,
+           LightListStats->NumResizes);
+
+    // NOTE: Barriers of the last frame and how much memory aliasing saved on the transients
+    render_graph_stats* GraphStats = &DemoState->RenderGraph.Stats;
+    printf("  \"render_graph\": { \"barriers\": %u, \"image_barriers\": %u, \"placements\": %u, \"transient_mb\": %.2f, "
+           "\"transient_unaliased_mb\": %.2f }\n",
+           GraphStats->NumPipelineBarriers, GraphStats->NumImageBarriers, GraphStats->NumPlacements,
+           f64(GraphStats->TransientBytes) / (1024.0 * 1024.0), f64(GraphStats->TransientBytesUnaliased) / (1024.0 * 1024.0));
+    printf("}\n");
+
+    if (LightListStats->NumTileOverflows > 0 || LightListStats->NumListTruncations > 0)
+    {
+        fprintf(stderr, "Light lists overflowed: %u tiles hit the 1024 light limit, %u tiles were truncated by the list capacity\n",
+                LightListStats->NumTileOverflows, LightListStats->NumListTruncations);
+    }
+
+    if (CsvFileName && !GpuProfilerCsvWrite(Profiler, CsvFileName))
+    {
+        fprintf(stderr, "Failed to write %s\n", CsvFileName);
+    }
+
+    // NOTE: Saves the permutations the run compiled (tile sizes, lighting features) into the pipeline cache for the next one
+    Destroy();
+    free(CpuTimes);
+    free(GpuTimes);
+
+    return 0;
+}
@@ -0,0 +1,699 @@
+
+//
+// NOTE: Files
+//
+
+inline u8* PipelineFileRead(linear_arena* Arena, const char* FileName, u64* OutSize)
+{
+    u8* Result = 0;
+    *OutSize = 0;
+
+    FILE* File = fopen(FileName, "rb");
+    if (File)
+    {
+        fseek(File, 0, SEEK_END);
+        long Size = ftell(File);
+        fseek(File, 0, SEEK_SET);
+        if (Size > 0)
+        {
+            Result = PushArray(Arena, u8, Size);
+            if (fread(Result, 1, Size, File) == size_t(Size))
+            {
+                *OutSize = u64(Size);
+            }
+            else
+            {
+                Result = 0;
+            }
+        }
+        fclose(File);
+    }
+
+    return Result;
+}
+
+//
+// NOTE: Cache
+//
+
+inline pipeline_cache_header PipelineCacheHeaderGet()
+{
+    VkPhysicalDeviceProperties Properties;
+    vkGetPhysicalDeviceProperties(RenderState->PhysicalDevice, &Properties);
+
+    pipeline_cache_header Result = {};
+    Result.Magic = PIPELINE_CACHE_MAGIC;
+    Result.Version = PIPELINE_CACHE_VERSION;
+    Result.VendorId = Properties.vendorID;
+    Result.DeviceId = Properties.deviceID;
+    Result.DriverVersion = Properties.driverVersion;
+    Copy(Properties.pipelineCacheUUID, Result.CacheUuid, VK_UUID_SIZE);
+
+    return Result;
+}
+
+inline void PipelineCacheCreate(pipeline_cache* Cache, linear_arena* TempArena, const char* FileName)
+{
+    *Cache = {};
+    Cache->FileName = FileName;
+
+    // NOTE: The file data only has to live until the driver copied it into the cache
+    linear_arena Arena = *TempArena;
+    u64 FileSize = 0;
+    u8* FileData = PipelineFileRead(&Arena, FileName, &FileSize);
+
+    VkPipelineCacheCreateInfo CreateInfo = {};
+    CreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (FileData && FileSize >= sizeof(pipeline_cache_header))
+    {
+        pipeline_cache_header Expected = PipelineCacheHeaderGet();
+        pipeline_cache_header* Header = (pipeline_cache_header*)FileData;
+        b32 Matches = (Header->Magic == Expected.Magic &&
+                       Header->Version == Expected.Version &&
+                       Header->VendorId == Expected.VendorId &&
+                       Header->DeviceId == Expected.DeviceId &&
+                       Header->DriverVersion == Expected.DriverVersion &&
+                       memcmp(Header->CacheUuid, Expected.CacheUuid, VK_UUID_SIZE) == 0 &&
+                       Header->DataSize == FileSize - sizeof(pipeline_cache_header));
+        if (Matches)
+        {
+            CreateInfo.initialDataSize = size_t(Header->DataSize);
+            CreateInfo.pInitialData = Header + 1;
+            Cache->LoadedFromDisk = true;
+        }
+    }
+
+    VkCheckResult(vkCreatePipelineCache(RenderState->Device, &CreateInfo, 0, &Cache->Handle));
+}
+
+inline b32 PipelineCacheSave(pipeline_cache* Cache, linear_arena* TempArena)
+{
+    linear_arena Arena = *TempArena;
+
+    size_t DataSize = 0;
+    VkCheckResult(vkGetPipelineCacheData(RenderState->Device, Cache->Handle, &DataSize, 0));
+    u8* Data = PushArray(&Arena, u8, DataSize);
+    VkCheckResult(vkGetPipelineCacheData(RenderState->Device, Cache->Handle, &DataSize, Data));
+
+    FILE* File = fopen(Cache->FileName, "wb");
+    if (!File)
+    {
+        return false;
+    }
+
+    pipeline_cache_header Header = PipelineCacheHeaderGet();
+    Header.DataSize = DataSize;
+    fwrite(&Header, sizeof(Header), 1, File);
+    fwrite(Data, 1, DataSize, File);
+    fclose(File);
+    Cache->Unsaved = false;
+
+    return true;
+}
+
+//
+// NOTE: Pipelines
+//
+
+inline pipeline_entry* PipelineEntryAdd(pipeline_cache* Cache, const char* ShaderName, const char* MainFuncName, VkDescriptorSetLayout* Layouts,
+                                        u32 NumLayouts, u32* SpecConstants, u32 NumSpecConstants, VkPushConstantRange* PushConstants)
+{
+    Assert(Cache->NumPipelines < PIPELINE_MAX_PIPELINES);
+    Assert(NumSpecConstants <= PIPELINE_MAX_SPEC_CONSTANTS);
+    pipeline_entry* Result = Cache->Pipelines + Cache->NumPipelines++;
+    *Result = {};
+    Result->ShaderName = ShaderName;
+    Result->MainFuncName = MainFuncName;
+    Result->NumSpecConstants = NumSpecConstants;
+    for (u32 ConstantId = 0; ConstantId < NumSpecConstants; ++ConstantId)
+    {
+        Result->SpecConstants[ConstantId] = SpecConstants[ConstantId];
+    }
+
+    VkPipelineLayoutCreateInfo LayoutCreateInfo = {};
+    LayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    LayoutCreateInfo.setLayoutCount = NumLayouts;
+    LayoutCreateInfo.pSetLayouts = Layouts;
+    LayoutCreateInfo.pushConstantRangeCount = PushConstants ? 1 : 0;
+    LayoutCreateInfo.pPushConstantRanges = PushConstants;
+    VkCheckResult(vkCreatePipelineLayout(RenderState->Device, &LayoutCreateInfo, 0, &Result->Pipeline.Layout));
+
+    return Result;
+}
+
+inline vk_pipeline* PipelineComputeAddSpecialized(pipeline_cache* Cache, const char* ShaderName, const char* MainFuncName,
+                                                  VkDescriptorSetLayout* Layouts, u32 NumLayouts, u32* SpecConstants, u32 NumSpecConstants)
+{
+    pipeline_entry* Entry = PipelineEntryAdd(Cache, ShaderName, MainFuncName, Layouts, NumLayouts, SpecConstants, NumSpecConstants, 0);
+    vk_pipeline* Result = &Entry->Pipeline;
+    return Result;
+}
+
+inline vk_pipeline* PipelineComputeAdd(pipeline_cache* Cache, const char* ShaderName, const char* MainFuncName, VkDescriptorSetLayout* Layouts,
+                                       u32 NumLayouts)
+{
+    vk_pipeline* Result = PipelineComputeAddSpecialized(Cache, ShaderName, MainFuncName, Layouts, NumLayouts, 0, 0);
+    return Result;
+}
+
+inline pipeline_graphics_desc PipelineGraphicsDescBegin(const char* VertShaderName, VkRenderPass RenderPass)
+{
+    pipeline_graphics_desc Result = {};
+    Result.VertShaderName = VertShaderName;
+    Result.RenderPass = RenderPass;
+    Result.DepthCompareOp = VK_COMPARE_OP_ALWAYS;
+    
+    return Result;
+}
+
+inline void PipelineGraphicsVertexAttributeAdd(pipeline_graphics_desc* Desc, VkFormat Format, u32 Size)
+{
+    Assert(Desc->NumVertexAttributes < PIPELINE_MAX_VERTEX_ATTRIBUTES);
+    Desc->VertexFormats[Desc->NumVertexAttributes] = Format;
+    Desc->VertexSizes[Desc->NumVertexAttributes] = Size;
+    Desc->NumVertexAttributes += 1;
+}
+
+inline void PipelineGraphicsDepthAdd(pipeline_graphics_desc* Desc, VkCompareOp CompareOp)
+{
+    Desc->DepthEnabled = true;
+    Desc->DepthCompareOp = CompareOp;
+}
+
+// NOTE: One range starting at offset 0, the stages share it
+inline void PipelineGraphicsPushConstantsAdd(pipeline_graphics_desc* Desc, VkShaderStageFlags Stages, u32 Size)
+{
+    Desc->PushConstantStages = Stages;
+    Desc->PushConstantSize = Size;
+}
+
+// NOTE: Both shaders use "main" as their entry point
+inline vk_pipeline* PipelineGraphicsAddSpecialized(pipeline_cache* Cache, pipeline_graphics_desc Desc, const char* FragShaderName,
+                                                   VkDescriptorSetLayout* Layouts, u32 NumLayouts, u32* SpecConstants, u32 NumSpecConstants)
+{
+    VkPushConstantRange PushConstants = {};
+    PushConstants.stageFlags = Desc.PushConstantStages;
+    PushConstants.size = Desc.PushConstantSize;
+    pipeline_entry* Entry = PipelineEntryAdd(Cache, FragShaderName, "main", Layouts, NumLayouts, SpecConstants, NumSpecConstants,
+                                             Desc.PushConstantSize > 0 ? &PushConstants : 0);
+    Entry->Graphics = true;
+    Entry->GraphicsDesc = Desc;
+
+    vk_pipeline* Result = &Entry->Pipeline;
+    return Result;
+}
+
+inline vk_pipeline* PipelineGraphicsAdd(pipeline_cache* Cache, pipeline_graphics_desc Desc, const char* FragShaderName,
+                                        VkDescriptorSetLayout* Layouts, u32 NumLayouts)
+{
+    vk_pipeline* Result = PipelineGraphicsAddSpecialized(Cache, Desc, FragShaderName, Layouts, NumLayouts, 0, 0);
+    return Result;
+}
+
+inline b32 PipelineShaderModuleCreate(linear_arena* Arena, const char* FileName, VkShaderModule* OutModule)
+{
+    // NOTE: A file that doesn't start with the SPIR-V magic is most likely still being written
+    u64 CodeSize = 0;
+    u8* Code = PipelineFileRead(Arena, FileName, &CodeSize);
+    if (!Code || CodeSize < 4 || (CodeSize % 4) != 0 || *(u32*)Code != 0x07230203)
+    {
+        return false;
+    }
+
+    VkShaderModuleCreateInfo ModuleCreateInfo = {};
+    ModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    ModuleCreateInfo.codeSize = size_t(CodeSize);
+    ModuleCreateInfo.pCode = (u32*)Code;
+    VkCheckResult(vkCreateShaderModule(RenderState->Device, &ModuleCreateInfo, 0, OutModule));
+
+    return true;
+}
+
+inline b32 PipelineGraphicsCompile(pipeline_cache* Cache, pipeline_entry* Entry, VkShaderModule FragModule, VkSpecializationInfo* SpecInfo,
+                                   linear_arena* Arena, VkPipeline* OutPipeline)
+{
+    pipeline_graphics_desc* Desc = &Entry->GraphicsDesc;
+    VkShaderModule VertModule;
+    if (!PipelineShaderModuleCreate(Arena, Desc->VertShaderName, &VertModule))
+    {
+        return false;
+    }
+
+    VkPipelineShaderStageCreateInfo Stages[2] = {};
+    Stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    Stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    Stages[0].module = VertModule;
+    Stages[0].pName = Entry->MainFuncName;
+    Stages[0].pSpecializationInfo = SpecInfo;
+    Stages[1] = Stages[0];
+    Stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    Stages[1].module = FragModule;
+
+    VkVertexInputBindingDescription Binding = {};
+    VkVertexInputAttributeDescription Attributes[PIPELINE_MAX_VERTEX_ATTRIBUTES] = {};
+    for (u32 AttributeId = 0; AttributeId < Desc->NumVertexAttributes; ++AttributeId)
+    {
+        Attributes[AttributeId].location = AttributeId;
+        Attributes[AttributeId].format = Desc->VertexFormats[AttributeId];
+        Attributes[AttributeId].offset = Binding.stride;
+        Binding.stride += Desc->VertexSizes[AttributeId];
+    }
+    
+    VkPipelineVertexInputStateCreateInfo VertexInput = {};
+    VertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VertexInput.vertexBindingDescriptionCount = Desc->NumVertexAttributes > 0 ? 1 : 0;
+    VertexInput.pVertexBindingDescriptions = &Binding;
+    VertexInput.vertexAttributeDescriptionCount = Desc->NumVertexAttributes;
+    VertexInput.pVertexAttributeDescriptions = Attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo InputAssembly = {};
+    InputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    InputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo Viewport = {};
+    Viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    Viewport.viewportCount = 1;
+    Viewport.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo Rasterization = {};
+    Rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    Rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    Rasterization.cullMode = VK_CULL_MODE_NONE;
+    Rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    Rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo Multisample = {};
+    Multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    Multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo DepthStencil = {};
+    DepthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    DepthStencil.depthTestEnable = Desc->DepthEnabled ? VK_TRUE : VK_FALSE;
+    DepthStencil.depthWriteEnable = Desc->DepthEnabled ? VK_TRUE : VK_FALSE;
+    DepthStencil.depthCompareOp = Desc->DepthCompareOp;
+
+    VkPipelineColorBlendAttachmentState BlendAttachments[8] = {};
+    Assert(Desc->NumColorAttachments <= ArrayCount(BlendAttachments));
+    for (u32 AttachmentId = 0; AttachmentId < Desc->NumColorAttachments; ++AttachmentId)
+    {
+        BlendAttachments[AttachmentId].colorWriteMask = (VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+                                                         VK_COLOR_COMPONENT_A_BIT);
+    }
+    
+    VkPipelineColorBlendStateCreateInfo ColorBlend = {};
+    ColorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    ColorBlend.attachmentCount = Desc->NumColorAttachments;
+    ColorBlend.pAttachments = BlendAttachments;
+
+    VkDynamicState DynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo Dynamic = {};
+    Dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    Dynamic.dynamicStateCount = ArrayCount(DynamicStates);
+    Dynamic.pDynamicStates = DynamicStates;
+    
+    VkGraphicsPipelineCreateInfo CreateInfo = {};
+    CreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    CreateInfo.stageCount = ArrayCount(Stages);
+    CreateInfo.pStages = Stages;
+    CreateInfo.pVertexInputState = &VertexInput;
+    CreateInfo.pInputAssemblyState = &InputAssembly;
+    CreateInfo.pViewportState = &Viewport;
+    CreateInfo.pRasterizationState = &Rasterization;
+    CreateInfo.pMultisampleState = &Multisample;
+    CreateInfo.pDepthStencilState = &DepthStencil;
+    CreateInfo.pColorBlendState = &ColorBlend;
+    CreateInfo.pDynamicState = &Dynamic;
+    CreateInfo.layout = Entry->Pipeline.Layout;
+    CreateInfo.renderPass = Desc->RenderPass;
+    CreateInfo.subpass = 0;
+    VkResult Result = vkCreateGraphicsPipelines(RenderState->Device, Cache->Handle, 1, &CreateInfo, 0, OutPipeline);
+    vkDestroyShaderModule(RenderState->Device, VertModule, 0);
+
+    return Result == VK_SUCCESS;
+}
+
+inline b32 PipelineCompile(pipeline_cache* Cache, pipeline_entry* Entry, linear_arena* Arena, VkPipeline* OutPipeline)
+{
+    // NOTE: Safe to call from several threads at once, the pipeline cache is internally synchronized
+    VkShaderModule Module;
+    if (!PipelineShaderModuleCreate(Arena, Entry->ShaderName, &Module))
+    {
+        return false;
+    }
+
+    VkSpecializationMapEntry MapEntries[PIPELINE_MAX_SPEC_CONSTANTS];
+    for (u32 ConstantId = 0; ConstantId < Entry->NumSpecConstants; ++ConstantId)
+    {
+        MapEntries[ConstantId].constantID = ConstantId;
+        MapEntries[ConstantId].offset = sizeof(u32) * ConstantId;
+        MapEntries[ConstantId].size = sizeof(u32);
+    }
+    
+    VkSpecializationInfo SpecInfo = {};
+    SpecInfo.mapEntryCount = Entry->NumSpecConstants;
+    SpecInfo.pMapEntries = MapEntries;
+    SpecInfo.dataSize = sizeof(u32) * Entry->NumSpecConstants;
+    SpecInfo.pData = Entry->SpecConstants;
+    VkSpecializationInfo* StageSpecInfo = Entry->NumSpecConstants > 0 ? &SpecInfo : 0;
+
+    b32 Result = false;
+    if (Entry->Graphics)
+    {
+        Result = PipelineGraphicsCompile(Cache, Entry, Module, StageSpecInfo, Arena, OutPipeline);
+    }
+    else
+    {
+        VkComputePipelineCreateInfo CreateInfo = {};
+        CreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        CreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        CreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        CreateInfo.stage.module = Module;
+        CreateInfo.stage.pName = Entry->MainFuncName;
+        CreateInfo.stage.pSpecializationInfo = StageSpecInfo;
+        CreateInfo.layout = Entry->Pipeline.Layout;
+        Result = vkCreateComputePipelines(RenderState->Device, Cache->Handle, 1, &CreateInfo, 0, OutPipeline) == VK_SUCCESS;
+    }
+    vkDestroyShaderModule(RenderState->Device, Module, 0);
+
+    return Result;
+}
+
+JOB_CALLBACK(PipelineBuildJob)
+{
+    pipeline_build_job* Job = (pipeline_build_job*)Data;
+    b32 Compiled = PipelineCompile(Job->Cache, Job->Entry, Arena, &Job->Entry->Pipeline.Handle);
+    Assert(Compiled);
+}
+
+/*
+
+  NOTE: Starts compiling every pipeline that got added since the last build, one job per pipeline. The jobs go onto the queues of the
+        worker threads so the render thread doesn't pop them first, it only helps out while it waits on jobs itself. Only the render
+        thread adds and builds, the watcher sees the new entries once NumBuilt got published.
+
+ */
+inline void PipelineCacheBuildStart(pipeline_cache* Cache, job_system* Jobs)
+{
+    for (u32 EntryId = Cache->NumBuilding; EntryId < Cache->NumPipelines; ++EntryId)
+    {
+        pipeline_build_job* Job = Cache->BuildJobs + EntryId;
+        Job->Cache = Cache;
+        Job->Entry = Cache->Pipelines + EntryId;
+
+        u32 WorkerId = Jobs->NumWorkers > 1 ? 1 + EntryId % (Jobs->NumWorkers - 1) : 0;
+        JobSystemPush(Jobs, WorkerId, PipelineBuildJob, Job, &Cache->BuildCounter);
+    }
+    Cache->NumBuilding = Cache->NumPipelines;
+}
+
+inline void PipelineCacheBuildPoll(pipeline_cache* Cache)
+{
+    // NOTE: Publishes the started entries once all of them are done
+    if (Cache->NumBuilt != Cache->NumBuilding && AtomicLoadU32(&Cache->BuildCounter.NumPending) == 0)
+    {
+        Cache->Unsaved = true;
+        AtomicStoreU32(&Cache->NumBuilt, Cache->NumBuilding);
+    }
+}
+
+inline void PipelineCacheBuildFinish(pipeline_cache* Cache, job_system* Jobs)
+{
+    JobSystemWait(Jobs, 0, &Cache->BuildCounter);
+    PipelineCacheBuildPoll(Cache);
+}
+
+inline void PipelineCacheBuild(pipeline_cache* Cache, job_system* Jobs)
+{
+    PipelineCacheBuildStart(Cache, Jobs);
+    PipelineCacheBuildFinish(Cache, Jobs);
+}
+
+inline b32 PipelineCacheBuilt(pipeline_cache* Cache, u32 NumEntries)
+{
+    // NOTE: True once the first NumEntries entries can be used
+    PipelineCacheBuildPoll(Cache);
+    b32 Result = Cache->NumBuilt >= NumEntries;
+    return Result;
+}
+
+//
+// NOTE: Hot Reload
+//
+
+inline void PipelineSwapLock(pipeline_cache* Cache)
+{
+    while (AtomicCompareExchangeU32(&Cache->SwapLock, 1, 0) != 0)
+    {
+        ThreadYield();
+    }
+}
+
+inline void PipelineSwapUnlock(pipeline_cache* Cache)
+{
+    AtomicStoreU32(&Cache->SwapLock, 0);
+}
+
+inline void PipelineWatcherFileChanged(pipeline_cache* Cache, const char* FileName)
+{
+    u32 NumBuilt = AtomicLoadU32(&Cache->NumBuilt);
+    for (u32 EntryId = 0; EntryId < NumBuilt; ++EntryId)
+    {
+        pipeline_entry* Entry = Cache->Pipelines + EntryId;
+        b32 UsesShader = (strcmp(Entry->ShaderName, FileName) == 0 ||
+                          (Entry->Graphics && strcmp(Entry->GraphicsDesc.VertShaderName, FileName) == 0));
+        if (!UsesShader)
+        {
+            continue;
+        }
+
+        // NOTE: A failed compile keeps the old pipeline, the next write to the shader tries again
+        linear_arena Arena = Cache->WatcherArena;
+        VkPipeline NewPipeline;
+        if (!PipelineCompile(Cache, Entry, &Arena, &NewPipeline))
+        {
+            continue;
+        }
+
+        // NOTE: If the render thread didn't pick up the last compile yet, that one never got used and can go right away
+        VkPipeline Replaced = VK_NULL_HANDLE;
+        PipelineSwapLock(Cache);
+        u32 SwapId = 0;
+        for (; SwapId < Cache->NumPendingSwaps; ++SwapId)
+        {
+            if (Cache->PendingSwaps[SwapId].EntryId == EntryId)
+            {
+                Replaced = Cache->PendingSwaps[SwapId].Pipeline;
+                break;
+            }
+        }
+        Cache->PendingSwaps[SwapId].EntryId = EntryId;
+        Cache->PendingSwaps[SwapId].Pipeline = NewPipeline;
+        if (SwapId == Cache->NumPendingSwaps)
+        {
+            AtomicStoreU32(&Cache->NumPendingSwaps, Cache->NumPendingSwaps + 1);
+        }
+        PipelineSwapUnlock(Cache);
+
+        if (Replaced != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(RenderState->Device, Replaced, 0);
+        }
+    }
+}
+
+inline b32 PipelineWatcherIsShader(const char* FileName)
+{
+    size_t Length = strlen(FileName);
+    b32 Result = Length > 4 && strcmp(FileName + Length - 4, ".spv") == 0;
+    return Result;
+}
+
+#ifdef _WIN32
+
+DWORD WINAPI PipelineWatcherThreadEntry(LPVOID Param)
+{
+    pipeline_cache* Cache = (pipeline_cache*)Param;
+    HANDLE Directory = CreateFileA(".", FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING,
+                                   FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, 0);
+    if (Directory == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+
+    // NOTE: Overlapped so that we can wait on the quit event next to the directory changes
+    OVERLAPPED Overlapped = {};
+    Overlapped.hEvent = CreateEvent(0, TRUE, FALSE, 0);
+    HANDLE WaitHandles[] = { Overlapped.hEvent, Cache->WatcherQuitEvent };
+    
+    DWORD Buffer[1024];
+    while (ReadDirectoryChangesW(Directory, Buffer, sizeof(Buffer), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+                                 0, &Overlapped, 0))
+    {
+        DWORD NumBytes = 0;
+        if (WaitForMultipleObjects(ArrayCount(WaitHandles), WaitHandles, FALSE, INFINITE) != WAIT_OBJECT_0 ||
+            !GetOverlappedResult(Directory, &Overlapped, &NumBytes, FALSE))
+        {
+            CancelIo(Directory);
+            GetOverlappedResult(Directory, &Overlapped, &NumBytes, TRUE);
+            break;
+        }
+        ResetEvent(Overlapped.hEvent);
+        
+        u8* CurrEvent = (u8*)Buffer;
+        while (NumBytes > 0)
+        {
+            FILE_NOTIFY_INFORMATION* Event = (FILE_NOTIFY_INFORMATION*)CurrEvent;
+            char FileName[MAX_PATH];
+            int Length = WideCharToMultiByte(CP_UTF8, 0, Event->FileName, int(Event->FileNameLength / sizeof(WCHAR)), FileName,
+                                             sizeof(FileName) - 1, 0, 0);
+            FileName[Length] = 0;
+            if (PipelineWatcherIsShader(FileName))
+            {
+                PipelineWatcherFileChanged(Cache, FileName);
+            }
+
+            if (Event->NextEntryOffset == 0)
+            {
+                break;
+            }
+            CurrEvent += Event->NextEntryOffset;
+        }
+    }
+
+    CloseHandle(Overlapped.hEvent);
+    CloseHandle(Directory);
+    return 0;
+}
+
+#else
+
+void* PipelineWatcherThreadEntry(void* Param)
+{
+    pipeline_cache* Cache = (pipeline_cache*)Param;
+    int WatchFd = inotify_init1(IN_CLOEXEC);
+    if (WatchFd < 0 || inotify_add_watch(WatchFd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        return 0;
+    }
+
+    // NOTE: Close write/moved to only fire once the shader compiler is done with the file. Anything on the quit pipe means stop
+    pollfd PollFds[2] = {};
+    PollFds[0].fd = WatchFd;
+    PollFds[0].events = POLLIN;
+    PollFds[1].fd = Cache->WatcherQuitPipe[0];
+    PollFds[1].events = POLLIN;
+    
+    alignas(inotify_event) u8 Buffer[4096];
+    while (true)
+    {
+        if (poll(PollFds, ArrayCount(PollFds), -1) < 0 || PollFds[1].revents != 0)
+        {
+            break;
+        }
+        
+        ssize_t NumBytes = read(WatchFd, Buffer, sizeof(Buffer));
+        if (NumBytes <= 0)
+        {
+            break;
+        }
+
+        for (u8* CurrEvent = Buffer; CurrEvent < Buffer + NumBytes;)
+        {
+            inotify_event* Event = (inotify_event*)CurrEvent;
+            if (Event->len > 0 && PipelineWatcherIsShader(Event->name))
+            {
+                PipelineWatcherFileChanged(Cache, Event->name);
+            }
+            CurrEvent += sizeof(inotify_event) + Event->len;
+        }
+    }
+
+    close(WatchFd);
+    return 0;
+}
+
+#endif
+
+inline void PipelineCacheWatcherStart(pipeline_cache* Cache)
+{
+#ifdef _WIN32
+    Cache->WatcherQuitEvent = CreateEvent(0, TRUE, FALSE, 0);
+    Assert(Cache->WatcherQuitEvent);
+    Cache->WatcherThread = CreateThread(0, 0, PipelineWatcherThreadEntry, Cache, 0, 0);
+    Assert(Cache->WatcherThread);
+#else
+    int Error = pipe(Cache->WatcherQuitPipe);
+    Assert(Error == 0);
+    Error = pthread_create(&Cache->WatcherThread, 0, PipelineWatcherThreadEntry, Cache);
+    Assert(Error == 0);
+#endif
+}
+
+inline void PipelineCacheWatcherStop(pipeline_cache* Cache)
+{
+    // NOTE: A compile the watcher is in the middle of still finishes and gets queued as a swap before it exits
+#ifdef _WIN32
+    SetEvent(Cache->WatcherQuitEvent);
+    WaitForSingleObject(Cache->WatcherThread, INFINITE);
+    CloseHandle(Cache->WatcherThread);
+    CloseHandle(Cache->WatcherQuitEvent);
+#else
+    u8 Quit = 1;
+    ssize_t NumWritten = write(Cache->WatcherQuitPipe[1], &Quit, sizeof(Quit));
+    Assert(NumWritten == sizeof(Quit));
+    pthread_join(Cache->WatcherThread, 0);
+    close(Cache->WatcherQuitPipe[0]);
+    close(Cache->WatcherQuitPipe[1]);
+#endif
+}
+
+/*
+
+  NOTE: Shaders are loaded relative to the working directory, so that is the directory we watch.
+
+ */
+inline void PipelineCacheWatcherCreate(pipeline_cache* Cache, linear_arena* Arena)
+{
+    Cache->WatcherArena = LinearSubArena(Arena, PIPELINE_WATCHER_ARENA_SIZE);
+    PipelineCacheWatcherStart(Cache);
+}
+
+inline void PipelineCacheFrameBegin(pipeline_cache* Cache, u32 FrameId)
+{
+    for (u32 RetiredId = 0; RetiredId < Cache->NumRetired;)
+    {
+        pipeline_retired* Retired = Cache->Retired + RetiredId;
+        if (FrameId - Retired->FrameId >= PIPELINE_RETIRE_FRAMES)
+        {
+            vkDestroyPipeline(RenderState->Device, Retired->Pipeline, 0);
+            *Retired = Cache->Retired[--Cache->NumRetired];
+        }
+        else
+        {
+            RetiredId += 1;
+        }
+    }
+
+    PipelineCacheBuildPoll(Cache);
+
+    // NOTE: The common case is a single load, nothing got recompiled
+    if (AtomicLoadU32(&Cache->NumPendingSwaps) == 0)
+    {
+        return;
+    }
+
+    PipelineSwapLock(Cache);
+    for (u32 SwapId = 0; SwapId < Cache->NumPendingSwaps; ++SwapId)
+    {
+        pipeline_swap* Swap = Cache->PendingSwaps + SwapId;
+        pipeline_entry* Entry = Cache->Pipelines + Swap->EntryId;
+
+        Assert(Cache->NumRetired < PIPELINE_MAX_RETIRED);
+        pipeline_retired* Retired = Cache->Retired + Cache->NumRetired++;
+        Retired->FrameId = FrameId;
+        Retired->Pipeline = Entry->Pipeline.Handle;
+        Entry->Pipeline.Handle = Swap->Pipeline;
+    }
+    AtomicStoreU32(&Cache->NumPendingSwaps, 0);
+    PipelineSwapUnlock(Cache);
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+/*
+
+  NOTE: Pipelines get built by us instead of the frameworks pipeline manager, so they can go through a VkPipelineCache that persists
+        on disk and get compiled in parallel on the job system (cold starts are dominated by shader compilation, especially on
+        software Vulkan). Pipelines get added first and only compiled by PipelineCacheBuild, their layouts exist right away.
+
+        The cache file starts with our own header with the device it was made on. A file from a different device, driver version or
+        pipeline cache UUID gets ignored and the cache starts out empty, the driver would reject most of that data anyway.
+
+        Graphics pipelines (gbuffer, lighting, copy to swap) are entries too. They only cover the state our passes use: one vertex
+        binding with tightly packed attributes, triangle lists, no culling, an optional depth test and color attachments without
+        blending. Viewport and scissor are dynamic, so the pipelines don't depend on the swap chain size.
+
+        Permutations: an entry can carry specialization constants, constant id i gets SpecConstants[i] (all of them 32bit, bools
+        included). Graphics pipelines hand the same constants to both stages. Entries can be added at any time, a later build only
+        compiles the new ones.
+
+        Runtime builds: PipelineCacheBuildStart hands the new entries to the job workers and returns, the render thread polls at frame
+        boundaries (PipelineCacheFrameBegin) and keeps using what it has until an entry is built. Only PipelineCacheBuild (startup)
+        waits. Nothing gets saved at runtime, shutdown saves the cache if a build added something so the next start finds those
+        permutations too. A build can't be in flight across a job system stop, PipelineCacheBuildFinish waits for it.
+
+        Hot reload: a watcher thread sleeps on directory change events (inotify, ReadDirectoryChangesW on windows) for the shader
+        directory. Every pipeline that uses a changed shader gets recompiled on the watcher thread and queued, the render thread swaps
+        it in at the next frame boundary and retires the old pipeline until the frames in flight are done with it. The frame loop
+        itself never touches the file system or compiles anything.
+
+        The watcher runs code out of the demo module like the job workers, PipelineCacheWatcherStop wakes it up and joins it and
+        PipelineCacheWatcherStart spawns a new one (CodeReload does both).
+
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define PIPELINE_CACHE_FILE_NAME "pipeline_cache.bin"
+#define PIPELINE_CACHE_MAGIC 0x50434B56 // NOTE: VKCP
+#define PIPELINE_CACHE_VERSION 1
+#define PIPELINE_MAX_PIPELINES 256
+#define PIPELINE_MAX_SPEC_CONSTANTS 8
+#define PIPELINE_MAX_SET_LAYOUTS 8
+#define PIPELINE_MAX_VERTEX_ATTRIBUTES 4
+#define PIPELINE_WATCHER_ARENA_SIZE MegaBytes(4)
+// NOTE: Has to cover the frames in flight, a replaced pipeline gets destroyed once this many newer frames started
+#define PIPELINE_RETIRE_FRAMES 3
+#define PIPELINE_MAX_RETIRED 64
+
+struct pipeline_cache_header
+{
+    u32 Magic;
+    u32 Version;
+    u32 VendorId;
+    u32 DeviceId;
+    u32 DriverVersion;
+    u8 CacheUuid[VK_UUID_SIZE];
+    u64 DataSize;
+};
+
+// NOTE: The fixed function state of a graphics pipeline, the attributes are packed one after the other in a single vertex binding
+struct pipeline_graphics_desc
+{
+    const char* VertShaderName;
+    VkRenderPass RenderPass;
+    u32 NumVertexAttributes;
+    VkFormat VertexFormats[PIPELINE_MAX_VERTEX_ATTRIBUTES];
+    u32 VertexSizes[PIPELINE_MAX_VERTEX_ATTRIBUTES];
+    b32 DepthEnabled;
+    VkCompareOp DepthCompareOp;
+    u32 NumColorAttachments;
+    VkShaderStageFlags PushConstantStages;
+    u32 PushConstantSize;
+};
+
+struct pipeline_entry
+{
+    vk_pipeline Pipeline;
+    const char* ShaderName; // NOTE: The fragment shader for graphics pipelines
+    const char* MainFuncName;
+    b32 Graphics;
+    pipeline_graphics_desc GraphicsDesc;
+    u32 NumSpecConstants;
+    u32 SpecConstants[PIPELINE_MAX_SPEC_CONSTANTS];
+};
+
+struct pipeline_cache;
+struct pipeline_build_job
+{
+    pipeline_cache* Cache;
+    pipeline_entry* Entry;
+};
+
+struct pipeline_swap
+{
+    u32 EntryId;
+    VkPipeline Pipeline;
+};
+
+struct pipeline_retired
+{
+    u32 FrameId;
+    VkPipeline Pipeline;
+};
+
+struct pipeline_cache
+{
+    VkPipelineCache Handle;
+    const char* FileName;
+    b32 LoadedFromDisk;
+    b32 Unsaved; // NOTE: A build compiled pipelines the file doesn't have yet
+
+    // NOTE: Entries [NumBuilt, NumBuilding) are compiling on the job workers, [NumBuilding, NumPipelines) didn't start yet. The watcher
+    // only looks at built entries
+    volatile u32 NumBuilt;
+    u32 NumBuilding;
+    u32 NumPipelines;
+    pipeline_entry Pipelines[PIPELINE_MAX_PIPELINES];
+    job_counter BuildCounter;
+    pipeline_build_job BuildJobs[PIPELINE_MAX_PIPELINES];
+
+    // NOTE: Written by the watcher thread, at most one pending swap per pipeline
+    linear_arena WatcherArena;
+#ifdef _WIN32
+    HANDLE WatcherThread;
+    HANDLE WatcherQuitEvent;
+#else
+    pthread_t WatcherThread;
+    int WatcherQuitPipe[2];
+#endif
+    volatile u32 SwapLock;
+    volatile u32 NumPendingSwaps;
+    pipeline_swap PendingSwaps[PIPELINE_MAX_PIPELINES];
+
+    // NOTE: Only touched by the render thread
+    u32 NumRetired;
+    pipeline_retired Retired[PIPELINE_MAX_RETIRED];
+};
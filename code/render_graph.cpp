@@ -0,0 +1,882 @@
+
+/*
+
+  NOTE: Barrier rules, per access in pass order:
+
+        - Writes and layout changes wait on everything that touched the resource since its last write (WAW + WAR) and make the last
+          write available. The first use of a transient in a frame starts from UNDEFINED and also waits on the last users of any
+          transient it shares memory with
+        - Reads only wait if the last write isn't visible to their stages/access yet, so consecutive readers share one barrier
+
+ */
+
+#define RENDER_GRAPH_WRITE_ACCESS_MASK (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | \
+                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | \
+                                        VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+inline void RenderGraphCreate(render_graph* Graph, VkDeviceSize TransientMemorySize)
+{
+    *Graph = {};
+    Graph->TransientMemorySize = TransientMemorySize;
+    Graph->TransientMemory = VkMemoryAllocate(RenderState->Device, RenderState->LocalMemoryId, TransientMemorySize);
+}
+
+//
+// NOTE: Resources
+//
+
+inline void RenderGraphResourceStateReset(render_graph_resource* Resource, VkImageLayout Layout)
+{
+    Resource->Layout = Layout;
+    Resource->WriteStages = 0;
+    Resource->WriteAccess = 0;
+    Resource->ReadStages = 0;
+    Resource->VisibleStages = 0;
+    Resource->VisibleAccess = 0;
+}
+
+inline u32 RenderGraphResourceAdd(render_graph* Graph, const char* Name, render_graph_resource_type Type)
+{
+    Assert(Graph->NumResources < RENDER_GRAPH_MAX_RESOURCES);
+    u32 Result = Graph->NumResources++;
+    render_graph_resource* Resource = Graph->Resources + Result;
+    *Resource = {};
+    Resource->Name = Name;
+    Resource->Type = Type;
+    Resource->FirstPass = RENDER_GRAPH_UNUSED;
+    Resource->LastPass = RENDER_GRAPH_UNUSED;
+    RenderGraphResourceStateReset(Resource, VK_IMAGE_LAYOUT_UNDEFINED);
+
+    return Result;
+}
+
+inline u32 RenderGraphBufferImport(render_graph* Graph, const char* Name, VkBuffer Buffer)
+{
+    u32 Result = RenderGraphResourceAdd(Graph, Name, RenderGraphResource_Buffer);
+    Graph->Resources[Result].Buffer = Buffer;
+    return Result;
+}
+
+inline void RenderGraphBufferSet(render_graph* Graph, u32 ResourceId, VkBuffer Buffer)
+{
+    // NOTE: A reallocated buffer starts without pending accesses, the old one is only freed once its frames finished
+    render_graph_resource* Resource = Graph->Resources + ResourceId;
+    Assert(Resource->Type == RenderGraphResource_Buffer);
+    if (Resource->Buffer != Buffer)
+    {
+        Resource->Buffer = Buffer;
+        RenderGraphResourceStateReset(Resource, VK_IMAGE_LAYOUT_UNDEFINED);
+    }
+}
+
+inline u32 RenderGraphImageImport(render_graph* Graph, const char* Name, VkImage Image, VkImageAspectFlags Aspect, VkImageLayout Layout)
+{
+    u32 Result = RenderGraphResourceAdd(Graph, Name, RenderGraphResource_Image);
+    render_graph_resource* Resource = Graph->Resources + Result;
+    Resource->Image = Image;
+    Resource->Aspect = Aspect;
+    Resource->Layout = Layout;
+
+    return Result;
+}
+
+inline void RenderGraphImageSet(render_graph* Graph, u32 ResourceId, VkImage Image, VkImageLayout Layout)
+{
+    render_graph_resource* Resource = Graph->Resources + ResourceId;
+    Assert(Resource->Type == RenderGraphResource_Image && !Resource->Transient);
+    if (Resource->Image != Image)
+    {
+        Resource->Image = Image;
+        RenderGraphResourceStateReset(Resource, Layout);
+    }
+}
+
+inline u32 RenderGraphTransientImageAdd(render_graph* Graph, const char* Name, VkFormat Format, VkImageUsageFlags Usage,
+                                        VkImageAspectFlags Aspect)
+{
+    u32 Result = RenderGraphResourceAdd(Graph, Name, RenderGraphResource_Image);
+    render_graph_resource* Resource = Graph->Resources + Result;
+    Resource->Transient = true;
+    Resource->Format = Format;
+    Resource->Usage = Usage;
+    Resource->Aspect = Aspect;
+    Graph->TransientsPlaced = false;
+
+    return Result;
+}
+
+inline void RenderGraphTransientsResize(render_graph* Graph, u32 Width, u32 Height)
+{
+    for (u32 ResourceId = 0; ResourceId < Graph->NumResources; ++ResourceId)
+    {
+        render_graph_resource* Resource = Graph->Resources + ResourceId;
+        if (Resource->Transient)
+        {
+            Resource->Width = Width;
+            Resource->Height = Height;
+        }
+    }
+
+    Graph->TransientsPlaced = false;
+}
+
+inline VkImage RenderGraphImageGet(render_graph* Graph, u32 ResourceId)
+{
+    VkImage Result = Graph->Resources[ResourceId].Image;
+    return Result;
+}
+
+inline VkImageView RenderGraphViewGet(render_graph* Graph, u32 ResourceId)
+{
+    VkImageView Result = Graph->Resources[ResourceId].View;
+    return Result;
+}
+
+inline VkFormat RenderGraphFormatGet(render_graph* Graph, u32 ResourceId)
+{
+    VkFormat Result = Graph->Resources[ResourceId].Format;
+    return Result;
+}
+
+//
+// NOTE: Frame Building
+//
+
+inline void RenderGraphRetire(render_graph* Graph, VkImage Image, VkImageView View, VkRenderPass RenderPass, VkFramebuffer FrameBuffer)
+{
+    Assert(Graph->NumRetired < RENDER_GRAPH_MAX_RETIRED);
+    render_graph_retired* Retired = Graph->Retired + Graph->NumRetired++;
+    Retired->FrameId = Graph->FrameId;
+    Retired->Image = Image;
+    Retired->View = View;
+    Retired->RenderPass = RenderPass;
+    Retired->FrameBuffer = FrameBuffer;
+    Retired->SwapChain = VK_NULL_HANDLE;
+}
+
+inline void RenderGraphSwapChainRetire(render_graph* Graph, VkSwapchainKHR SwapChain, VkImageView* Views, u32 NumViews)
+{
+    // NOTE: Frames in flight can still present the old images, so the swap chain and its views get freed like our own images
+    for (u32 ViewId = 0; ViewId < NumViews; ++ViewId)
+    {
+        RenderGraphRetire(Graph, VK_NULL_HANDLE, Views[ViewId], VK_NULL_HANDLE, VK_NULL_HANDLE);
+    }
+
+    Assert(Graph->NumRetired < RENDER_GRAPH_MAX_RETIRED);
+    render_graph_retired* Retired = Graph->Retired + Graph->NumRetired++;
+    *Retired = {};
+    Retired->FrameId = Graph->FrameId;
+    Retired->SwapChain = SwapChain;
+}
+
+inline void RenderGraphRetiredFree(render_graph* Graph)
+{
+    for (u32 RetiredId = 0; RetiredId < Graph->NumRetired;)
+    {
+        render_graph_retired* Retired = Graph->Retired + RetiredId;
+        if (Graph->FrameId - Retired->FrameId < RENDER_GRAPH_RETIRE_FRAMES)
+        {
+            RetiredId += 1;
+            continue;
+        }
+
+        if (Retired->FrameBuffer != VK_NULL_HANDLE)
+        {
+            vkDestroyFramebuffer(RenderState->Device, Retired->FrameBuffer, 0);
+            vkDestroyRenderPass(RenderState->Device, Retired->RenderPass, 0);
+        }
+        if (Retired->View != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(RenderState->Device, Retired->View, 0);
+        }
+        if (Retired->Image != VK_NULL_HANDLE)
+        {
+            vkDestroyImage(RenderState->Device, Retired->Image, 0);
+        }
+        if (Retired->SwapChain != VK_NULL_HANDLE)
+        {
+            vkDestroySwapchainKHR(RenderState->Device, Retired->SwapChain, 0);
+        }
+        *Retired = Graph->Retired[--Graph->NumRetired];
+    }
+}
+
+inline void RenderGraphBegin(render_graph* Graph)
+{
+    Graph->FrameId += 1;
+    RenderGraphRetiredFree(Graph);
+
+    Graph->NumPasses = 0;
+    Graph->NumAccesses = 0;
+    Graph->Stats.NumPipelineBarriers = 0;
+    Graph->Stats.NumImageBarriers = 0;
+
+    for (u32 ResourceId = 0; ResourceId < Graph->NumResources; ++ResourceId)
+    {
+        Graph->Resources[ResourceId].FirstPass = RENDER_GRAPH_UNUSED;
+        Graph->Resources[ResourceId].LastPass = RENDER_GRAPH_UNUSED;
+    }
+}
+
+inline u32 RenderGraphPassAdd(render_graph* Graph, const char* Name, render_graph_pass_callback* Callback, void* Data)
+{
+    Assert(Graph->NumPasses < RENDER_GRAPH_MAX_PASSES);
+    u32 Result = Graph->NumPasses++;
+    render_graph_pass* Pass = Graph->Passes + Result;
+    *Pass = {};
+    Pass->Name = Name;
+    Pass->Callback = Callback;
+    Pass->Data = Data;
+    Pass->FirstAccess = Graph->NumAccesses;
+
+    return Result;
+}
+
+inline render_graph_access* RenderGraphPassAccessGet(render_graph* Graph, render_graph_pass* Pass, u32 ResourceId)
+{
+    render_graph_access* Result = 0;
+    for (u32 AccessId = Pass->FirstAccess; AccessId < Pass->FirstAccess + Pass->NumAccesses; ++AccessId)
+    {
+        if (Graph->Accesses[AccessId].ResourceId == ResourceId)
+        {
+            Result = Graph->Accesses + AccessId;
+            break;
+        }
+    }
+
+    return Result;
+}
+
+inline render_graph_access* RenderGraphAccessAdd(render_graph* Graph, u32 ResourceId, VkPipelineStageFlags Stages, VkAccessFlags Access,
+                                                 VkImageLayout Layout, b32 Write)
+{
+    // NOTE: Accesses go to the last added pass. A resource is listed once per pass, reads and writes of the same pass get merged
+    Assert(Graph->NumPasses > 0 && ResourceId < Graph->NumResources);
+    u32 PassId = Graph->NumPasses - 1;
+    render_graph_pass* Pass = Graph->Passes + PassId;
+
+    render_graph_access* Result = RenderGraphPassAccessGet(Graph, Pass, ResourceId);
+    if (!Result)
+    {
+        Assert(Graph->NumAccesses < RENDER_GRAPH_MAX_ACCESSES);
+        Result = Graph->Accesses + Graph->NumAccesses++;
+        Pass->NumAccesses += 1;
+        *Result = {};
+        Result->ResourceId = ResourceId;
+        Result->Layout = Layout;
+    }
+    Assert(Result->Layout == Layout);
+    Result->Stages |= Stages;
+    Result->Access |= Access;
+    Result->Write = Result->Write || Write;
+
+    render_graph_resource* Resource = Graph->Resources + ResourceId;
+    if (Resource->FirstPass == RENDER_GRAPH_UNUSED)
+    {
+        Resource->FirstPass = PassId;
+    }
+    Resource->LastPass = PassId;
+
+    return Result;
+}
+
+inline void RenderGraphBufferRead(render_graph* Graph, u32 ResourceId, VkPipelineStageFlags Stages, VkAccessFlags Access)
+{
+    RenderGraphAccessAdd(Graph, ResourceId, Stages, Access, VK_IMAGE_LAYOUT_UNDEFINED, false);
+}
+
+inline void RenderGraphBufferWrite(render_graph* Graph, u32 ResourceId, VkPipelineStageFlags Stages, VkAccessFlags Access)
+{
+    RenderGraphAccessAdd(Graph, ResourceId, Stages, Access, VK_IMAGE_LAYOUT_UNDEFINED, true);
+}
+
+inline void RenderGraphTransferWrite(render_graph* Graph, u32 ResourceId)
+{
+    RenderGraphBufferWrite(Graph, ResourceId, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+}
+
+inline void RenderGraphImageRead(render_graph* Graph, u32 ResourceId, VkPipelineStageFlags Stages, VkAccessFlags Access, VkImageLayout Layout)
+{
+    RenderGraphAccessAdd(Graph, ResourceId, Stages, Access, Layout, false);
+}
+
+inline void RenderGraphImageWrite(render_graph* Graph, u32 ResourceId, VkPipelineStageFlags Stages, VkAccessFlags Access, VkImageLayout Layout,
+                                  b32 Discard = false)
+{
+    render_graph_access* Result = RenderGraphAccessAdd(Graph, ResourceId, Stages, Access, Layout, true);
+    Result->Discard = Discard;
+}
+
+inline void RenderGraphPassSecondaryContents(render_graph* Graph)
+{
+    render_graph_pass* Pass = Graph->Passes + Graph->NumPasses - 1;
+    Pass->SecondaryContents = true;
+}
+
+inline void RenderGraphAttachmentAdd(render_graph* Graph, u32 ResourceId, b32 Depth, b32 Clear, VkClearValue ClearValue)
+{
+    render_graph_pass* Pass = Graph->Passes + Graph->NumPasses - 1;
+    Assert(Pass->NumAttachments < RENDER_GRAPH_MAX_ATTACHMENTS + 1 && !Pass->HasDepthAttachment);
+
+    // NOTE: The depth attachment has to come last
+    if (Depth)
+    {
+        Pass->HasDepthAttachment = true;
+        RenderGraphAccessAdd(Graph, ResourceId, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                             VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true);
+    }
+    else
+    {
+        Assert(Pass->NumColorAttachments < RENDER_GRAPH_MAX_ATTACHMENTS);
+        Pass->NumColorAttachments += 1;
+        RenderGraphAccessAdd(Graph, ResourceId, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true);
+    }
+
+    render_graph_attachment* Attachment = Pass->Attachments + Pass->NumAttachments++;
+    *Attachment = {};
+    Attachment->ResourceId = ResourceId;
+    Attachment->Clear = Clear;
+    Attachment->ClearValue = ClearValue;
+}
+
+inline void RenderGraphColorAttachment(render_graph* Graph, u32 ResourceId, VkClearValue ClearValue)
+{
+    RenderGraphAttachmentAdd(Graph, ResourceId, false, true, ClearValue);
+}
+
+inline void RenderGraphColorAttachment(render_graph* Graph, u32 ResourceId)
+{
+    RenderGraphAttachmentAdd(Graph, ResourceId, false, false, {});
+}
+
+inline void RenderGraphDepthAttachment(render_graph* Graph, u32 ResourceId, VkClearValue ClearValue)
+{
+    RenderGraphAttachmentAdd(Graph, ResourceId, true, true, ClearValue);
+}
+
+inline void RenderGraphDepthAttachment(render_graph* Graph, u32 ResourceId)
+{
+    RenderGraphAttachmentAdd(Graph, ResourceId, true, false, {});
+}
+
+//
+// NOTE: Transient Placement
+//
+
+inline b32 RenderGraphLifetimesOverlap(render_graph_resource* A, render_graph_resource* B)
+{
+    b32 Result = (A->FirstPass != RENDER_GRAPH_UNUSED && B->FirstPass != RENDER_GRAPH_UNUSED &&
+                  A->FirstPass <= B->LastPass && B->FirstPass <= A->LastPass);
+    return Result;
+}
+
+inline b32 RenderGraphMemoryOverlap(render_graph_resource* A, render_graph_resource* B)
+{
+    b32 Result = A->Offset < B->Offset + B->Size && B->Offset < A->Offset + A->Size;
+    return Result;
+}
+
+inline b32 RenderGraphPlacementValid(render_graph* Graph)
+{
+    if (!Graph->TransientsPlaced)
+    {
+        return false;
+    }
+
+    for (u32 ResourceIdA = 0; ResourceIdA < Graph->NumResources; ++ResourceIdA)
+    {
+        render_graph_resource* A = Graph->Resources + ResourceIdA;
+        for (u32 ResourceIdB = ResourceIdA + 1; A->Transient && ResourceIdB < Graph->NumResources; ++ResourceIdB)
+        {
+            render_graph_resource* B = Graph->Resources + ResourceIdB;
+            if (B->Transient && RenderGraphLifetimesOverlap(A, B) && RenderGraphMemoryOverlap(A, B))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+inline void RenderGraphCachedPassesClear(render_graph* Graph)
+{
+    for (u32 CachedId = 0; CachedId < Graph->NumCachedPasses; ++CachedId)
+    {
+        render_graph_cached_pass* Cached = Graph->CachedPasses + CachedId;
+        RenderGraphRetire(Graph, VK_NULL_HANDLE, VK_NULL_HANDLE, Cached->RenderPass, Cached->FrameBuffer);
+    }
+    Graph->NumCachedPasses = 0;
+}
+
+inline void RenderGraphTransientsPlace(render_graph* Graph)
+{
+    // NOTE: Happens on the first frame, resizes and when a mode switch changes the lifetimes. Frames in flight can still use the old
+    // images and framebuffers so they get retired instead of waiting for the device
+    RenderGraphCachedPassesClear(Graph);
+
+    VkMemoryRequirements Requirements[RENDER_GRAPH_MAX_RESOURCES];
+    for (u32 ResourceId = 0; ResourceId < Graph->NumResources; ++ResourceId)
+    {
+        render_graph_resource* Resource = Graph->Resources + ResourceId;
+        if (!Resource->Transient)
+        {
+            continue;
+        }
+
+        if (Resource->Image != VK_NULL_HANDLE)
+        {
+            RenderGraphRetire(Graph, Resource->Image, Resource->View, VK_NULL_HANDLE, VK_NULL_HANDLE);
+        }
+
+        VkImageCreateInfo ImageCreateInfo = {};
+        ImageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        ImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        ImageCreateInfo.format = Resource->Format;
+        ImageCreateInfo.extent.width = Resource->Width;
+        ImageCreateInfo.extent.height = Resource->Height;
+        ImageCreateInfo.extent.depth = 1;
+        ImageCreateInfo.mipLevels = 1;
+        ImageCreateInfo.arrayLayers = 1;
+        ImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        ImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        ImageCreateInfo.usage = Resource->Usage;
+        ImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkCheckResult(vkCreateImage(RenderState->Device, &ImageCreateInfo, 0, &Resource->Image));
+
+        vkGetImageMemoryRequirements(RenderState->Device, Resource->Image, Requirements + ResourceId);
+        Assert(Requirements[ResourceId].memoryTypeBits & (1 << RenderState->LocalMemoryId));
+        Resource->Size = Requirements[ResourceId].size;
+        Resource->Offset = 0;
+    }
+
+    // NOTE: Greedy placement, biggest images first. Every image goes to the lowest offset (start of memory or the end of a conflicting
+    // image) where it doesn't overlap an already placed image whose lifetime overlaps its own. Images that aren't used this frame stay
+    // at offset 0, they still get memory so their descriptors stay valid
+    b32 Placed[RENDER_GRAPH_MAX_RESOURCES] = {};
+    Graph->Stats.TransientBytes = 0;
+    Graph->Stats.TransientBytesUnaliased = 0;
+    while (true)
+    {
+        u32 NextId = RENDER_GRAPH_UNUSED;
+        for (u32 ResourceId = 0; ResourceId < Graph->NumResources; ++ResourceId)
+        {
+            render_graph_resource* Resource = Graph->Resources + ResourceId;
+            if (Resource->Transient && Resource->FirstPass != RENDER_GRAPH_UNUSED && !Placed[ResourceId] &&
+                (NextId == RENDER_GRAPH_UNUSED || Resource->Size > Graph->Resources[NextId].Size))
+            {
+                NextId = ResourceId;
+            }
+        }
+
+        if (NextId == RENDER_GRAPH_UNUSED)
+        {
+            break;
+        }
+
+        render_graph_resource* Next = Graph->Resources + NextId;
+        VkDeviceSize Alignment = Requirements[NextId].alignment;
+        VkDeviceSize BestOffset = ~VkDeviceSize(0);
+        for (u32 CandidateId = 0; CandidateId <= Graph->NumResources; ++CandidateId)
+        {
+            VkDeviceSize Offset = 0;
+            if (CandidateId < Graph->NumResources)
+            {
+                render_graph_resource* Candidate = Graph->Resources + CandidateId;
+                if (!Placed[CandidateId] || !RenderGraphLifetimesOverlap(Candidate, Next))
+                {
+                    continue;
+                }
+                Offset = ((Candidate->Offset + Candidate->Size + Alignment - 1) / Alignment) * Alignment;
+            }
+
+            Next->Offset = Offset;
+            b32 Fits = Offset < BestOffset;
+            for (u32 OtherId = 0; Fits && OtherId < Graph->NumResources; ++OtherId)
+            {
+                render_graph_resource* Other = Graph->Resources + OtherId;
+                Fits = !(Placed[OtherId] && RenderGraphLifetimesOverlap(Other, Next) && RenderGraphMemoryOverlap(Other, Next));
+            }
+
+            if (Fits)
+            {
+                BestOffset = Offset;
+            }
+        }
+
+        Next->Offset = BestOffset;
+        Placed[NextId] = true;
+        if (Next->Offset + Next->Size > Graph->Stats.TransientBytes)
+        {
+            Graph->Stats.TransientBytes = Next->Offset + Next->Size;
+        }
+        Graph->Stats.TransientBytesUnaliased += Next->Size;
+    }
+    Assert(Graph->Stats.TransientBytes <= Graph->TransientMemorySize);
+
+    for (u32 ResourceId = 0; ResourceId < Graph->NumResources; ++ResourceId)
+    {
+        render_graph_resource* Resource = Graph->Resources + ResourceId;
+        if (!Resource->Transient)
+        {
+            continue;
+        }
+
+        Assert(Resource->Offset + Resource->Size <= Graph->TransientMemorySize);
+        VkCheckResult(vkBindImageMemory(RenderState->Device, Resource->Image, Graph->TransientMemory, Resource->Offset));
+
+        VkImageViewCreateInfo ViewCreateInfo = {};
+        ViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        ViewCreateInfo.image = Resource->Image;
+        ViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        ViewCreateInfo.format = Resource->Format;
+        ViewCreateInfo.subresourceRange.aspectMask = Resource->Aspect;
+        ViewCreateInfo.subresourceRange.levelCount = 1;
+        ViewCreateInfo.subresourceRange.layerCount = 1;
+        VkCheckResult(vkCreateImageView(RenderState->Device, &ViewCreateInfo, 0, &Resource->View));
+
+        // NOTE: The memory can still be in use by the old images in frames in flight, so the first barrier waits on everything before it
+        RenderGraphResourceStateReset(Resource, VK_IMAGE_LAYOUT_UNDEFINED);
+        Resource->WriteStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        Resource->WriteAccess = VK_ACCESS_MEMORY_WRITE_BIT;
+    }
+
+    Graph->TransientsPlaced = true;
+    Graph->TransientVersion += 1;
+    Graph->Stats.NumPlacements += 1;
+}
+
+//
+// NOTE: Compile + Execute
+//
+
+inline u32 RenderGraphCachedPassGet(render_graph* Graph, render_graph_cached_pass* Key)
+{
+    for (u32 CachedId = 0; CachedId < Graph->NumCachedPasses; ++CachedId)
+    {
+        render_graph_cached_pass* Cached = Graph->CachedPasses + CachedId;
+        b32 Equal = Cached->NumAttachments == Key->NumAttachments && Cached->NumColorAttachments == Key->NumColorAttachments;
+        for (u32 AttachmentId = 0; Equal && AttachmentId < Key->NumAttachments; ++AttachmentId)
+        {
+            Equal = (Cached->Views[AttachmentId] == Key->Views[AttachmentId] && Cached->LoadOps[AttachmentId] == Key->LoadOps[AttachmentId] &&
+                     Cached->StoreOps[AttachmentId] == Key->StoreOps[AttachmentId]);
+        }
+
+        if (Equal)
+        {
+            return CachedId;
+        }
+    }
+
+    return RENDER_GRAPH_UNUSED;
+}
+
+inline u32 RenderGraphCachedPassCreate(render_graph* Graph, render_graph_pass* Pass, render_graph_cached_pass* Key)
+{
+    // NOTE: One subpass, the graph already moved every attachment into its attachment layout so the render pass never transitions
+    VkAttachmentDescription Descriptions[RENDER_GRAPH_MAX_ATTACHMENTS + 1] = {};
+    VkAttachmentReference References[RENDER_GRAPH_MAX_ATTACHMENTS + 1] = {};
+    for (u32 AttachmentId = 0; AttachmentId < Key->NumAttachments; ++AttachmentId)
+    {
+        render_graph_resource* Resource = Graph->Resources + Pass->Attachments[AttachmentId].ResourceId;
+        VkImageLayout Layout = (AttachmentId < Key->NumColorAttachments ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL :
+                                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+        VkAttachmentDescription* Description = Descriptions + AttachmentId;
+        Description->format = Resource->Format;
+        Description->samples = VK_SAMPLE_COUNT_1_BIT;
+        Description->loadOp = Key->LoadOps[AttachmentId];
+        Description->storeOp = Key->StoreOps[AttachmentId];
+        Description->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        Description->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        Description->initialLayout = Layout;
+        Description->finalLayout = Layout;
+
+        References[AttachmentId].attachment = AttachmentId;
+        References[AttachmentId].layout = Layout;
+    }
+
+    VkSubpassDescription SubPass = {};
+    SubPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    SubPass.colorAttachmentCount = Key->NumColorAttachments;
+    SubPass.pColorAttachments = References;
+    SubPass.pDepthStencilAttachment = Key->NumAttachments > Key->NumColorAttachments ? References + Key->NumColorAttachments : 0;
+
+    VkRenderPassCreateInfo RenderPassCreateInfo = {};
+    RenderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    RenderPassCreateInfo.attachmentCount = Key->NumAttachments;
+    RenderPassCreateInfo.pAttachments = Descriptions;
+    RenderPassCreateInfo.subpassCount = 1;
+    RenderPassCreateInfo.pSubpasses = &SubPass;
+    VkCheckResult(vkCreateRenderPass(RenderState->Device, &RenderPassCreateInfo, 0, &Key->RenderPass));
+
+    render_graph_resource* FirstResource = Graph->Resources + Pass->Attachments[0].ResourceId;
+    VkFramebufferCreateInfo FrameBufferCreateInfo = {};
+    FrameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    FrameBufferCreateInfo.renderPass = Key->RenderPass;
+    FrameBufferCreateInfo.attachmentCount = Key->NumAttachments;
+    FrameBufferCreateInfo.pAttachments = Key->Views;
+    FrameBufferCreateInfo.width = FirstResource->Width;
+    FrameBufferCreateInfo.height = FirstResource->Height;
+    FrameBufferCreateInfo.layers = 1;
+    VkCheckResult(vkCreateFramebuffer(RenderState->Device, &FrameBufferCreateInfo, 0, &Key->FrameBuffer));
+
+    Assert(Graph->NumCachedPasses < RENDER_GRAPH_MAX_CACHED_PASSES);
+    u32 Result = Graph->NumCachedPasses++;
+    Graph->CachedPasses[Result] = *Key;
+
+    return Result;
+}
+
+inline void RenderGraphCompile(render_graph* Graph)
+{
+    if (!RenderGraphPlacementValid(Graph))
+    {
+        RenderGraphTransientsPlace(Graph);
+    }
+
+    // NOTE: Load ops only keep contents an earlier pass (or an earlier frame, for imported images) produced, store ops only keep what
+    // a later pass (or the next frame) reads
+    for (u32 PassId = 0; PassId < Graph->NumPasses; ++PassId)
+    {
+        render_graph_pass* Pass = Graph->Passes + PassId;
+        if (Pass->NumAttachments == 0)
+        {
+            continue;
+        }
+
+        render_graph_cached_pass Key = {};
+        Key.NumAttachments = Pass->NumAttachments;
+        Key.NumColorAttachments = Pass->NumColorAttachments;
+        for (u32 AttachmentId = 0; AttachmentId < Pass->NumAttachments; ++AttachmentId)
+        {
+            render_graph_attachment* Attachment = Pass->Attachments + AttachmentId;
+            render_graph_resource* Resource = Graph->Resources + Attachment->ResourceId;
+
+            if (Attachment->Clear)
+            {
+                Attachment->LoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            }
+            else if (!Resource->Transient || Resource->FirstPass < PassId)
+            {
+                Attachment->LoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            }
+            else
+            {
+                Attachment->LoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            }
+            Attachment->StoreOp = (!Resource->Transient || Resource->LastPass > PassId) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+            render_graph_access* Access = RenderGraphPassAccessGet(Graph, Pass, Attachment->ResourceId);
+            Access->Discard = Attachment->LoadOp != VK_ATTACHMENT_LOAD_OP_LOAD;
+
+            Key.Views[AttachmentId] = Resource->View;
+            Key.LoadOps[AttachmentId] = Attachment->LoadOp;
+            Key.StoreOps[AttachmentId] = Attachment->StoreOp;
+        }
+
+        Pass->CachedPassId = RenderGraphCachedPassGet(Graph, &Key);
+        if (Pass->CachedPassId == RENDER_GRAPH_UNUSED)
+        {
+            Pass->CachedPassId = RenderGraphCachedPassCreate(Graph, Pass, &Key);
+        }
+    }
+}
+
+inline void RenderGraphPassBarriers(render_graph* Graph, vk_commands Commands, u32 PassId)
+{
+    render_graph_pass* Pass = Graph->Passes + PassId;
+
+    VkPipelineStageFlags SrcStages = 0;
+    VkPipelineStageFlags DstStages = 0;
+    VkMemoryBarrier MemoryBarrier = {};
+    MemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    u32 NumImageBarriers = 0;
+    VkImageMemoryBarrier ImageBarriers[RENDER_GRAPH_MAX_RESOURCES];
+
+    for (u32 AccessId = Pass->FirstAccess; AccessId < Pass->FirstAccess + Pass->NumAccesses; ++AccessId)
+    {
+        render_graph_access* Access = Graph->Accesses + AccessId;
+        render_graph_resource* Resource = Graph->Resources + Access->ResourceId;
+        b32 FirstUse = Resource->Transient && Resource->FirstPass == PassId;
+        b32 Discard = FirstUse || Access->Discard;
+        b32 LayoutChange = Resource->Type == RenderGraphResource_Image && (Resource->Layout != Access->Layout || Discard);
+
+        if (Access->Write || LayoutChange)
+        {
+            VkPipelineStageFlags WaitStages = Resource->WriteStages | Resource->ReadStages;
+            VkAccessFlags WaitAccess = Resource->WriteAccess;
+            if (FirstUse)
+            {
+                // NOTE: Whatever used this memory last (this frame or the last one) has to be done with it
+                for (u32 OtherId = 0; OtherId < Graph->NumResources; ++OtherId)
+                {
+                    render_graph_resource* Other = Graph->Resources + OtherId;
+                    if (Other != Resource && Other->Transient && RenderGraphMemoryOverlap(Other, Resource))
+                    {
+                        WaitStages |= Other->WriteStages | Other->ReadStages;
+                        WaitAccess |= Other->WriteAccess;
+                    }
+                }
+            }
+
+            if (LayoutChange)
+            {
+                VkImageMemoryBarrier* Barrier = ImageBarriers + NumImageBarriers++;
+                *Barrier = {};
+                Barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                Barrier->srcAccessMask = WaitAccess;
+                Barrier->dstAccessMask = Access->Access;
+                Barrier->oldLayout = Discard ? VK_IMAGE_LAYOUT_UNDEFINED : Resource->Layout;
+                Barrier->newLayout = Access->Layout;
+                Barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                Barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                Barrier->image = Resource->Image;
+                Barrier->subresourceRange.aspectMask = Resource->Aspect;
+                Barrier->subresourceRange.levelCount = 1;
+                Barrier->subresourceRange.layerCount = 1;
+            }
+            else
+            {
+                MemoryBarrier.srcAccessMask |= WaitAccess;
+                MemoryBarrier.dstAccessMask |= Access->Access;
+            }
+
+            if (LayoutChange || WaitStages)
+            {
+                SrcStages |= WaitStages;
+                DstStages |= Access->Stages;
+            }
+
+            // NOTE: A layout change on its own acts like a write that is only visible to this access
+            Resource->Layout = Access->Layout;
+            Resource->WriteStages = Access->Stages;
+            Resource->WriteAccess = Access->Write ? Access->Access & RENDER_GRAPH_WRITE_ACCESS_MASK : 0;
+            Resource->ReadStages = Access->Write ? 0 : Access->Stages;
+            Resource->VisibleStages = Access->Write ? 0 : Access->Stages;
+            Resource->VisibleAccess = Access->Write ? 0 : Access->Access;
+        }
+        else
+        {
+            if (Resource->WriteStages && ((Access->Stages & ~Resource->VisibleStages) || (Access->Access & ~Resource->VisibleAccess)))
+            {
+                SrcStages |= Resource->WriteStages;
+                DstStages |= Access->Stages;
+                MemoryBarrier.srcAccessMask |= Resource->WriteAccess;
+                MemoryBarrier.dstAccessMask |= Access->Access;
+                Resource->VisibleStages |= Access->Stages;
+                Resource->VisibleAccess |= Access->Access;
+            }
+            Resource->ReadStages |= Access->Stages;
+        }
+    }
+
+    if (DstStages)
+    {
+        u32 NumMemoryBarriers = MemoryBarrier.srcAccessMask ? 1 : 0;
+        vkCmdPipelineBarrier(Commands.Buffer, SrcStages ? SrcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, DstStages, 0,
+                             NumMemoryBarriers, &MemoryBarrier, 0, 0, NumImageBarriers, ImageBarriers);
+        Graph->Stats.NumPipelineBarriers += 1;
+        Graph->Stats.NumImageBarriers += NumImageBarriers;
+    }
+}
+
+inline void RenderGraphViewPortSet(VkCommandBuffer CmdBuffer, u32 Width, u32 Height)
+{
+    VkViewport ViewPort = {};
+    ViewPort.width = f32(Width);
+    ViewPort.height = f32(Height);
+    ViewPort.maxDepth = 1.0f;
+    vkCmdSetViewport(CmdBuffer, 0, 1, &ViewPort);
+
+    VkRect2D Scissor = {};
+    Scissor.extent.width = Width;
+    Scissor.extent.height = Height;
+    vkCmdSetScissor(CmdBuffer, 0, 1, &Scissor);
+}
+
+/*
+
+  NOTE: Begins a secondary command buffer that continues the render pass of the pass that is executing right now. Safe to call from
+        other threads while that pass' callback waits for them.
+
+ */
+inline void RenderGraphSecondaryBegin(render_graph* Graph, VkCommandBuffer CmdBuffer)
+{
+    render_graph_pass* Pass = Graph->Passes + Graph->ExecutingPassId;
+    Assert(Pass->SecondaryContents && Pass->NumAttachments > 0);
+    render_graph_cached_pass* Cached = Graph->CachedPasses + Pass->CachedPassId;
+    render_graph_resource* FirstResource = Graph->Resources + Pass->Attachments[0].ResourceId;
+
+    VkCommandBufferInheritanceInfo InheritanceInfo = {};
+    InheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    InheritanceInfo.renderPass = Cached->RenderPass;
+    InheritanceInfo.subpass = 0;
+    InheritanceInfo.framebuffer = Cached->FrameBuffer;
+    
+    VkCommandBufferBeginInfo BeginInfo = {};
+    BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    BeginInfo.pInheritanceInfo = &InheritanceInfo;
+    VkCheckResult(vkBeginCommandBuffer(CmdBuffer, &BeginInfo));
+
+    RenderGraphViewPortSet(CmdBuffer, FirstResource->Width, FirstResource->Height);
+}
+
+inline void RenderGraphExecute(render_graph* Graph, vk_commands Commands, gpu_profiler* Profiler)
+{
+    for (u32 PassId = 0; PassId < Graph->NumPasses; ++PassId)
+    {
+        render_graph_pass* Pass = Graph->Passes + PassId;
+
+        u32 Timer = GpuProfilerPassBegin(Profiler, Commands.Buffer, Pass->Name);
+        RenderGraphPassBarriers(Graph, Commands, PassId);
+
+        if (Pass->NumAttachments > 0)
+        {
+            render_graph_cached_pass* Cached = Graph->CachedPasses + Pass->CachedPassId;
+            render_graph_resource* FirstResource = Graph->Resources + Pass->Attachments[0].ResourceId;
+
+            VkClearValue ClearValues[RENDER_GRAPH_MAX_ATTACHMENTS + 1];
+            for (u32 AttachmentId = 0; AttachmentId < Pass->NumAttachments; ++AttachmentId)
+            {
+                ClearValues[AttachmentId] = Pass->Attachments[AttachmentId].ClearValue;
+            }
+
+            VkRenderPassBeginInfo BeginInfo = {};
+            BeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            BeginInfo.renderPass = Cached->RenderPass;
+            BeginInfo.framebuffer = Cached->FrameBuffer;
+            BeginInfo.renderArea.extent.width = FirstResource->Width;
+            BeginInfo.renderArea.extent.height = FirstResource->Height;
+            BeginInfo.clearValueCount = Pass->NumAttachments;
+            BeginInfo.pClearValues = ClearValues;
+            if (Pass->SecondaryContents)
+            {
+                // NOTE: Dynamic state doesn't get inherited, RenderGraphSecondaryBegin sets it in every secondary
+                vkCmdBeginRenderPass(Commands.Buffer, &BeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            }
+            else
+            {
+                vkCmdBeginRenderPass(Commands.Buffer, &BeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+                RenderGraphViewPortSet(Commands.Buffer, FirstResource->Width, FirstResource->Height);
+            }
+        }
+
+        if (Pass->Callback)
+        {
+            Graph->ExecutingPassId = PassId;
+            Pass->Callback(Commands, Pass->Data);
+        }
+
+        if (Pass->NumAttachments > 0)
+        {
+            vkCmdEndRenderPass(Commands.Buffer);
+        }
+        GpuProfilerPassEnd(Profiler, Commands.Buffer, Timer);
+    }
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+/*
+
+  NOTE: Render graph for one frame. Passes declare the buffers and images they read and write, the graph tracks the last access of
+        every resource (across frames too) and only emits the barriers and layout transitions those accesses need, batched into one
+        vkCmdPipelineBarrier per pass. Raster passes get their render pass and framebuffer built from the declared attachments, with
+        load/store ops derived from whether the contents are needed before and after the pass.
+
+        Transient images are owned by the graph. Their contents don't survive the frame and images whose lifetimes don't overlap
+        share memory. Placement is only redone when the current lifetimes break it (first frame, resize, switching modes), which
+        bumps TransientVersion so owners know to rewrite their descriptors. It doesn't wait for the device, the old images and cached
+        passes get retired until the frames that used them are done and the first barrier of every new image waits on all earlier
+        work on the queue since the memory is shared with the old ones.
+
+        Usage per frame: RenderGraphBegin, add passes and their accesses, RenderGraphCompile, RenderGraphExecute.
+
+        Raster passes can record their draws into secondary command buffers (RenderGraphPassSecondaryContents), those get begun with
+        RenderGraphSecondaryBegin from inside the pass callback which fills in the render pass they continue.
+
+ */
+
+#define RENDER_GRAPH_MAX_RESOURCES 64
+#define RENDER_GRAPH_MAX_PASSES 32
+#define RENDER_GRAPH_MAX_ACCESSES 512
+#define RENDER_GRAPH_MAX_ATTACHMENTS 8
+#define RENDER_GRAPH_MAX_CACHED_PASSES 32
+#define RENDER_GRAPH_MAX_RETIRED 256
+#define RENDER_GRAPH_RETIRE_FRAMES 4 // NOTE: Has to cover the frames in flight
+#define RENDER_GRAPH_UNUSED 0xFFFFFFFF
+
+#define RENDER_GRAPH_PASS_CALLBACK(name) void name(vk_commands Commands, void* Data)
+typedef RENDER_GRAPH_PASS_CALLBACK(render_graph_pass_callback);
+
+enum render_graph_resource_type
+{
+    RenderGraphResource_Buffer,
+    RenderGraphResource_Image,
+};
+
+struct render_graph_resource
+{
+    const char* Name;
+    render_graph_resource_type Type;
+    b32 Transient;
+
+    VkBuffer Buffer;
+    VkImage Image;
+    VkImageView View;
+    VkFormat Format;
+    VkImageUsageFlags Usage;
+    VkImageAspectFlags Aspect;
+    u32 Width;
+    u32 Height;
+
+    // NOTE: Transient placement, lifetimes are pass ids of the current frame
+    VkDeviceSize Offset;
+    VkDeviceSize Size;
+    u32 FirstPass;
+    u32 LastPass;
+
+    // NOTE: Last access state, carried over between frames
+    VkImageLayout Layout;
+    VkPipelineStageFlags WriteStages;
+    VkAccessFlags WriteAccess;
+    VkPipelineStageFlags ReadStages; // NOTE: Readers since the last write
+    VkPipelineStageFlags VisibleStages; // NOTE: Stages/access the last write was already made visible to
+    VkAccessFlags VisibleAccess;
+};
+
+struct render_graph_access
+{
+    u32 ResourceId;
+    VkPipelineStageFlags Stages;
+    VkAccessFlags Access;
+    VkImageLayout Layout;
+    b32 Write;
+    b32 Discard; // NOTE: The pass doesn't need the previous contents
+};
+
+struct render_graph_attachment
+{
+    u32 ResourceId;
+    b32 Clear;
+    VkClearValue ClearValue;
+    VkAttachmentLoadOp LoadOp;
+    VkAttachmentStoreOp StoreOp;
+};
+
+struct render_graph_pass
+{
+    const char* Name;
+    render_graph_pass_callback* Callback;
+    void* Data;
+
+    u32 FirstAccess;
+    u32 NumAccesses;
+
+    // NOTE: Raster passes, color attachments followed by the optional depth attachment
+    u32 NumAttachments;
+    u32 NumColorAttachments;
+    b32 HasDepthAttachment;
+    render_graph_attachment Attachments[RENDER_GRAPH_MAX_ATTACHMENTS + 1];
+    u32 CachedPassId;
+    b32 SecondaryContents; // NOTE: The callback only executes secondary command buffers inside the render pass
+};
+
+struct render_graph_cached_pass
+{
+    u32 NumAttachments;
+    u32 NumColorAttachments;
+    VkImageView Views[RENDER_GRAPH_MAX_ATTACHMENTS + 1];
+    VkAttachmentLoadOp LoadOps[RENDER_GRAPH_MAX_ATTACHMENTS + 1];
+    VkAttachmentStoreOp StoreOps[RENDER_GRAPH_MAX_ATTACHMENTS + 1];
+
+    VkRenderPass RenderPass;
+    VkFramebuffer FrameBuffer;
+};
+
+struct render_graph_retired
+{
+    u32 FrameId;
+    VkImage Image;
+    VkImageView View;
+    VkRenderPass RenderPass;
+    VkFramebuffer FrameBuffer;
+    VkSwapchainKHR SwapChain; // NOTE: Owns its images, so those never show up in Image
+};
+
+struct render_graph_stats
+{
+    // NOTE: Per frame
+    u32 NumPipelineBarriers;
+    u32 NumImageBarriers;
+
+    u32 NumPlacements;
+    VkDeviceSize TransientBytes; // NOTE: Memory the transients actually use after aliasing
+    VkDeviceSize TransientBytesUnaliased;
+};
+
+struct render_graph
+{
+    u32 NumResources;
+    render_graph_resource Resources[RENDER_GRAPH_MAX_RESOURCES];
+
+    u32 NumPasses;
+    render_graph_pass Passes[RENDER_GRAPH_MAX_PASSES];
+    u32 NumAccesses;
+    render_graph_access Accesses[RENDER_GRAPH_MAX_ACCESSES];
+    u32 ExecutingPassId;
+
+    // NOTE: Transient memory
+    VkDeviceMemory TransientMemory;
+    VkDeviceSize TransientMemorySize;
+    b32 TransientsPlaced;
+    u32 TransientVersion;
+
+    u32 NumCachedPasses;
+    render_graph_cached_pass CachedPasses[RENDER_GRAPH_MAX_CACHED_PASSES];
+
+    // NOTE: Vulkan objects replaced by a placement, destroyed once the frames that used them are done
+    u32 FrameId;
+    u32 NumRetired;
+    render_graph_retired Retired[RENDER_GRAPH_MAX_RETIRED];
+
+    render_graph_stats Stats;
+};
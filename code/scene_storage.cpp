@@ -0,0 +1,122 @@
+
+//
+// NOTE: Platform
+//
+
+#ifdef _WIN32
+
+inline void* SceneMemoryReserve(u64 Size)
+{
+    void* Result = VirtualAlloc(0, Size, MEM_RESERVE, PAGE_NOACCESS);
+    Assert(Result);
+    return Result;
+}
+
+inline void SceneMemoryCommit(void* Base, u64 Size)
+{
+    void* Result = VirtualAlloc(Base, Size, MEM_COMMIT, PAGE_READWRITE);
+    Assert(Result);
+}
+
+#else
+
+inline void* SceneMemoryReserve(u64 Size)
+{
+    void* Result = mmap(0, Size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    Assert(Result != MAP_FAILED);
+    return Result;
+}
+
+inline void SceneMemoryCommit(void* Base, u64 Size)
+{
+    // NOTE: The pages only get backed once they are touched
+    int Error = mprotect(Base, Size, PROT_READ | PROT_WRITE);
+    Assert(Error == 0);
+}
+
+#endif
+
+//
+// NOTE: CPU Pools
+//
+
+inline scene_pool ScenePoolCreate(u32 InitialCapacity, u32 MaxCapacity)
+{
+    scene_pool Result = {};
+    Result.Capacity = Min(InitialCapacity, MaxCapacity);
+    Result.MaxCapacity = MaxCapacity;
+
+    return Result;
+}
+
+inline void* ScenePoolArrayAdd(scene_pool* Pool, u32 ElementSize)
+{
+    Assert(Pool->NumArrays < SCENE_POOL_MAX_ARRAYS);
+    u32 ArrayId = Pool->NumArrays++;
+    Pool->ElementSizes[ArrayId] = ElementSize;
+    Pool->Arrays[ArrayId] = (u8*)SceneMemoryReserve(u64(ElementSize) * u64(Pool->MaxCapacity));
+    SceneMemoryCommit(Pool->Arrays[ArrayId], u64(ElementSize) * u64(Pool->Capacity));
+
+    void* Result = Pool->Arrays[ArrayId];
+    return Result;
+}
+
+#define ScenePoolArrayPush(Pool, type) (type*)ScenePoolArrayAdd(Pool, sizeof(type))
+
+/*
+
+  NOTE: Makes sure the pool can hold Required elements, returns true if it had to grow.
+
+ */
+inline b32 ScenePoolFit(scene_pool* Pool, u32 Required)
+{
+    Assert(Required <= Pool->MaxCapacity);
+    b32 Result = Required > Pool->Capacity;
+    if (Result)
+    {
+        u32 NewCapacity = Max(Pool->Capacity, 1u);
+        while (NewCapacity < Required)
+        {
+            NewCapacity = 2 * NewCapacity;
+        }
+        Pool->Capacity = Min(NewCapacity, Pool->MaxCapacity);
+
+        for (u32 ArrayId = 0; ArrayId < Pool->NumArrays; ++ArrayId)
+        {
+            SceneMemoryCommit(Pool->Arrays[ArrayId], u64(Pool->ElementSizes[ArrayId]) * u64(Pool->Capacity));
+        }
+    }
+
+    return Result;
+}
+
+//
+// NOTE: GPU Buffers
+//
+
+inline void SceneGpuBufferAlloc(scene_gpu_buffer* Buffer, u32 Capacity)
+{
+    Buffer->Capacity = Capacity;
+
+    VkBufferCreateInfo BufferCreateInfo = {};
+    BufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    BufferCreateInfo.size = VkDeviceSize(Buffer->ElementSize) * VkDeviceSize(Capacity);
+    BufferCreateInfo.usage = Buffer->Usage;
+    BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkCheckResult(vkCreateBuffer(RenderState->Device, &BufferCreateInfo, 0, &Buffer->Buffer));
+
+    VkMemoryRequirements MemoryRequirements;
+    vkGetBufferMemoryRequirements(RenderState->Device, Buffer->Buffer, &MemoryRequirements);
+    Buffer->Memory = VkMemoryAllocate(RenderState->Device, RenderState->LocalMemoryId, MemoryRequirements.size);
+    VkCheckResult(vkBindBufferMemory(RenderState->Device, Buffer->Buffer, Buffer->Memory, 0));
+}
+
+inline scene_gpu_buffer SceneGpuBufferCreate(u32 ElementSize, VkBufferUsageFlags Usage, u32 Capacity)
+{
+    scene_gpu_buffer Result = {};
+    Result.ElementSize = ElementSize;
+    Result.Usage = Usage;
+    SceneGpuBufferAlloc(&Result, Capacity);
+
+    return Result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+
+  NOTE: Growable storage for the retained scene. The CPU arrays of a pool reserve address space for the pools max capacity up front
+        and only commit it as the pool grows (doubling), so elements never move and pointers into the pools stay valid. Committed
+        memory comes back zeroed.
+
+        The GPU copies follow the capacity of their pool. Growing allocates a new buffer, the whole array gets re-uploaded through
+        the dirty ranges and the old buffer is retired until no frame in flight can reference it anymore. Every frame in flight has
+        its own scene descriptor set which gets rewritten the next time that frame comes around, so growing never waits on the GPU.
+
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define SCENE_MAX_RENDER_MESHES (64*1024)
+#define SCENE_MAX_OPAQUE_INSTANCES (1024*1024)
+#define SCENE_MAX_POINT_LIGHTS (64*1024)
+#define SCENE_INITIAL_CAPACITY 1024
+#define SCENE_GEOMETRY_MAX_VERTICES (64*1024)
+#define SCENE_GEOMETRY_MAX_INDICES (256*1024)
+
+#define SCENE_POOL_MAX_ARRAYS 8
+#define SCENE_MAX_RETIRED_BUFFERS 16
+// NOTE: Has to cover the frames in flight, a retired buffer is freed once this many newer frames started
+#define SCENE_MAX_FRAME_DESCRIPTORS 3
+
+struct scene_pool
+{
+    u32 Capacity;
+    u32 MaxCapacity;
+
+    u32 NumArrays;
+    u8* Arrays[SCENE_POOL_MAX_ARRAYS];
+    u32 ElementSizes[SCENE_POOL_MAX_ARRAYS];
+};
+
+struct scene_gpu_buffer
+{
+    u32 Capacity; // NOTE: In elements
+    u32 ElementSize;
+    VkBufferUsageFlags Usage;
+    VkDeviceMemory Memory;
+    VkBuffer Buffer;
+};
+
+struct scene_retired_buffer
+{
+    u32 FrameId;
+    VkDeviceMemory Memory;
+    VkBuffer Buffer;
+};
@@ -2,6 +2,22 @@
 
 #extension GL_ARB_separate_shader_objects : enable
 
+#if VERTEX_SHADER
+
+layout(location = 0) out vec2 OutUv;
+
+void main()
+{
+    // NOTE: One triangle that covers the screen, so the pass needs no vertex buffer
+    vec2 Uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(2.0*Uv - 1.0, 0, 1);
+    OutUv = Uv;
+}
+
+#endif
+
+#if FRAGMENT_SHADER
+
 layout(location = 0) in vec2 InUv;
 
 layout(location = 0) out vec4 OutColor;
@@ -12,3 +28,5 @@ void main()
 {
     OutColor = texture(ColorTexture, InUv);
 }
+
+#endif
@@ -8,150 +8,820 @@
   
 */
 
-inline void TiledDeferredSwapChainChange(tiled_deferred_state* State, u32 Width, u32 Height, VkFormat ColorFormat,
-                                         render_scene* Scene, VkDescriptorSet* OutputRtSet)
+inline void TiledDeferredGlobalsFill(tiled_deferred_state* State, render_scene* Scene, tiled_deferred_globals* Data)
 {
-    b32 ReCreate = State->RenderTargetArena.Used != 0;
-    VkArenaClear(&State->RenderTargetArena);
+    *Data = {};
+    Data->InverseProjection = Inverse(CameraGetP(&Scene->Camera));
+    Data->ViewProjection = CameraGetVP(&Scene->Camera);
+    Data->InverseViewProjection = Inverse(Data->ViewProjection);
+    Data->ViewTransform = CameraGetV(&Scene->Camera);
+    Data->ScreenSize = V2(RenderState->WindowWidth, RenderState->WindowHeight);
+    Data->GridSizeX = CeilU32(f32(RenderState->WindowWidth) / f32(State->TileSize));
+    Data->GridSizeY = CeilU32(f32(RenderState->WindowHeight) / f32(State->TileSize));
+    Data->NumOpaqueInstances = Scene->NumOpaqueInstances;
+    Data->LightCullMode = State->LightCullMode;
+    Data->ClusterGridSizeX = CeilU32(f32(RenderState->WindowWidth) / f32(CLUSTER_TILE_SIZE_IN_PIXELS));
+    Data->ClusterGridSizeY = CeilU32(f32(RenderState->WindowHeight) / f32(CLUSTER_TILE_SIZE_IN_PIXELS));
+    Data->NumLightMaskWords = State->NumLightMaskWords;
+    Data->LightIndexCapacity_O = State->LightIndexList_O.Capacity;
+    Data->LightIndexCapacity_T = State->LightIndexList_T.Capacity;
+    Data->CounterParity = State->LightCounterParity;
+    Data->TileSize = State->TileSize;
+    Data->NumRenderMeshes = Scene->NumRenderMeshes;
+}
+
+inline b32 TiledDeferredSubgroupOpsSupported()
+{
+    // NOTE: The subgroup culling shader needs ballot + arithmetic ops in compute. Those are only queryable through
+    // vkGetPhysicalDeviceProperties2 and the shader is SPIR-V 1.3, so the instance and device we actually created have to be on 1.1, not
+    // just the physical device. The version we get is the lowest of what we ask for, what the loader supports and what the device supports
+    if (DEMO_VULKAN_API_VERSION < VK_API_VERSION_1_1)
+    {
+        return false;
+    }
+
+    PFN_vkEnumerateInstanceVersion EnumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(0, "vkEnumerateInstanceVersion");
+    u32 LoaderVersion = VK_API_VERSION_1_0;
+    if (EnumerateInstanceVersion)
+    {
+        VkCheckResult(EnumerateInstanceVersion(&LoaderVersion));
+    }
     
-    // NOTE: Render Target Data
-    {
-        RenderTargetEntryReCreate(&State->RenderTargetArena, Width, Height, VK_FORMAT_R32G32B32A32_SFLOAT,
-                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                                  VK_IMAGE_ASPECT_COLOR_BIT, &State->GBufferPositionImage, &State->GBufferPositionEntry);
-        RenderTargetEntryReCreate(&State->RenderTargetArena, Width, Height, VK_FORMAT_R32G32B32A32_SFLOAT,
-                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                                  VK_IMAGE_ASPECT_COLOR_BIT, &State->GBufferNormalImage, &State->GBufferNormalEntry);
-        RenderTargetEntryReCreate(&State->RenderTargetArena, Width, Height, VK_FORMAT_R32G32_UINT,
-                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                                  VK_IMAGE_ASPECT_COLOR_BIT, &State->GBufferMaterialImage, &State->GBufferMaterialEntry);
-        RenderTargetEntryReCreate(&State->RenderTargetArena, Width, Height, VK_FORMAT_D32_SFLOAT,
-                                  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                                  VK_IMAGE_ASPECT_DEPTH_BIT, &State->DepthImage, &State->DepthEntry);
-        RenderTargetEntryReCreate(&State->RenderTargetArena, Width, Height, ColorFormat,
-                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                                  VK_IMAGE_ASPECT_COLOR_BIT, &State->OutColorImage, &State->OutColorEntry);
+    VkPhysicalDeviceProperties Properties;
+    vkGetPhysicalDeviceProperties(RenderState->PhysicalDevice, &Properties);
+    if (LoaderVersion < VK_API_VERSION_1_1 || Properties.apiVersion < VK_API_VERSION_1_1)
+    {
+        return false;
+    }
 
-        if (ReCreate)
+    PFN_vkGetPhysicalDeviceProperties2 GetProperties2 = (PFN_vkGetPhysicalDeviceProperties2)vkGetInstanceProcAddr(RenderState->Instance, "vkGetPhysicalDeviceProperties2");
+    if (!GetProperties2)
+    {
+        return false;
+    }
+    
+    VkPhysicalDeviceSubgroupProperties SubgroupProperties = {};
+    SubgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 Properties2 = {};
+    Properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    Properties2.pNext = &SubgroupProperties;
+    GetProperties2(RenderState->PhysicalDevice, &Properties2);
+
+    VkSubgroupFeatureFlags RequiredOps = (VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT |
+                                          VK_SUBGROUP_FEATURE_BALLOT_BIT);
+    b32 Result = ((SubgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+                  (SubgroupProperties.supportedOperations & RequiredOps) == RequiredOps);
+    return Result;
+}
+
+inline void TiledDeferredSpecConstantsFill(u32 TileSize, u32 Features, u32* SpecConstants)
+{
+    SpecConstants[TiledDeferredSpec_TileDim] = TileSize;
+    SpecConstants[TiledDeferredSpec_GroupSizeX] = TileSize;
+    SpecConstants[TiledDeferredSpec_GroupSizeY] = TileSize;
+    SpecConstants[TiledDeferredSpec_PointLights] = (Features & LightingFeature_PointLights) != 0;
+    SpecConstants[TiledDeferredSpec_Specular] = (Features & LightingFeature_Specular) != 0;
+    SpecConstants[TiledDeferredSpec_Rim] = (Features & LightingFeature_Rim) != 0;
+    SpecConstants[TiledDeferredSpec_Caustics] = (Features & LightingFeature_Caustics) != 0;
+}
+
+inline u32 TiledDeferredLightingFeaturesGet(tiled_deferred_state* State, render_scene* Scene)
+{
+    u32 Result = 0;
+    Result |= Scene->NumPointLights > 0 ? LightingFeature_PointLights : 0;
+    Result |= State->SpecularEnabled ? LightingFeature_Specular : 0;
+    Result |= State->RimEnabled ? LightingFeature_Rim : 0;
+    Result |= State->CausticsEnabled ? LightingFeature_Caustics : 0;
+    return Result;
+}
+
+inline lighting_permutation* TiledDeferredLightingPermutationAdd(tiled_deferred_state* State, u32 Features, u32 TileSize)
+{
+    // NOTE: Only adds the pipelines to the cache, they get compiled by the next build
+    Assert(State->NumLightingPermutations < LIGHTING_MAX_PERMUTATIONS);
+    lighting_permutation* Result = State->LightingPermutations + State->NumLightingPermutations++;
+    Result->Features = Features;
+    Result->TileSize = TileSize;
+
+    u32 SpecConstants[TiledDeferredSpec_Count];
+    TiledDeferredSpecConstantsFill(TileSize, Features, SpecConstants);
+
+    // NOTE: Directional tiles have no point lights by definition, so that kernel never gets the point light loop
+    u32 DirectionalSpecConstants[TiledDeferredSpec_Count];
+    TiledDeferredSpecConstantsFill(TileSize, Features & ~LightingFeature_PointLights, DirectionalSpecConstants);
+
+    // NOTE: The classified variant uses a specialized kernel per bucket, the fragment pipelines only differ in how they read the gbuffer
+    const char* FragShaderNames[GBufferLayout_Count] =
+        {
+            "shader_tiled_deferred_lighting_frag.spv",
+            "shader_tiled_deferred_lighting_compact_frag.spv",
+        };
+    const char* ComputeShaderNames[GBufferLayout_Count] =
+        {
+            "shader_tiled_deferred_lighting_comp.spv",
+            "shader_tiled_deferred_lighting_compact_comp.spv",
+        };
+    const char* BucketShaderNames[GBufferLayout_Count][TileBucket_Count] =
+        {
+            { "shader_tiled_deferred_lighting_directional_comp.spv", "shader_tiled_deferred_lighting_point_comp.spv" },
+            { "shader_tiled_deferred_lighting_directional_compact_comp.spv", "shader_tiled_deferred_lighting_point_compact_comp.spv" },
+        };
+    // NOTE: Only reads the position out of the scene vertices
+    pipeline_graphics_desc FragmentDesc = PipelineGraphicsDescBegin("shader_tiled_deferred_lighting_vert.spv", State->LightingRenderPass);
+    PipelineGraphicsVertexAttributeAdd(&FragmentDesc, VK_FORMAT_R32G32B32_SFLOAT, 2*sizeof(v3) + sizeof(v2));
+    FragmentDesc.NumColorAttachments = 1;
+    
+    pipeline_cache* Cache = &DemoState->PipelineCache;
+    for (u32 LayoutId = 0; LayoutId < GBufferLayout_Count; ++LayoutId)
+    {
+        Result->Fragment[LayoutId] = PipelineGraphicsAddSpecialized(Cache, FragmentDesc, FragShaderNames[LayoutId], State->ComputeDescLayouts,
+                                                                    ArrayCount(State->ComputeDescLayouts), SpecConstants, ArrayCount(SpecConstants));
+        Result->Compute[LayoutId] = PipelineComputeAddSpecialized(Cache, ComputeShaderNames[LayoutId], "main", State->ComputeDescLayouts,
+                                                                  ArrayCount(State->ComputeDescLayouts), SpecConstants, ArrayCount(SpecConstants));
+        for (u32 BucketId = 0; BucketId < TileBucket_Count; ++BucketId)
         {
-            RenderTargetUpdateEntries(&DemoState->TempArena, &State->GBufferPass);
-            RenderTargetUpdateEntries(&DemoState->TempArena, &State->LightingPass);
+            u32* BucketSpecConstants = BucketId == TileBucket_Directional ? DirectionalSpecConstants : SpecConstants;
+            Result->Bucket[LayoutId][BucketId] = PipelineComputeAddSpecialized(Cache, BucketShaderNames[LayoutId][BucketId], "main",
+                                                                               State->ComputeDescLayouts, ArrayCount(State->ComputeDescLayouts),
+                                                                               BucketSpecConstants, TiledDeferredSpec_Count);
         }
-        
-        VkDescriptorImageWrite(&RenderState->DescriptorManager, *OutputRtSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                               State->OutColorEntry.View, DemoState->LinearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        
-        // NOTE: GBuffer
-        VkDescriptorImageWrite(&RenderState->DescriptorManager, State->TiledDeferredDescriptor, 8, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                               State->GBufferPositionEntry.View, DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        VkDescriptorImageWrite(&RenderState->DescriptorManager, State->TiledDeferredDescriptor, 9, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                               State->GBufferNormalEntry.View, DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        VkDescriptorImageWrite(&RenderState->DescriptorManager, State->TiledDeferredDescriptor, 10, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                               State->GBufferMaterialEntry.View, DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        VkDescriptorImageWrite(&RenderState->DescriptorManager, State->TiledDeferredDescriptor, 11, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                               State->DepthEntry.View, DemoState->PointSampler, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
     }
+    Result->NumCacheEntries = Cache->NumPipelines;
+
+    return Result;
+}
+
+/*
+
+  NOTE: Returns the lighting pipelines for a feature set. The first time a set gets used this only starts compiling it on the job
+        workers, nothing can use it before TiledDeferredPipelinesBuilt says so. Only the render thread calls this, outside of recording.
+
+ */
+inline lighting_permutation* TiledDeferredLightingPermutationGet(tiled_deferred_state* State, u32 Features, u32 TileSize)
+{
+    for (u32 PermutationId = 0; PermutationId < State->NumLightingPermutations; ++PermutationId)
+    {
+        lighting_permutation* Permutation = State->LightingPermutations + PermutationId;
+        if (Permutation->Features == Features && Permutation->TileSize == TileSize)
+        {
+            return Permutation;
+        }
+    }
+
+    lighting_permutation* Result = TiledDeferredLightingPermutationAdd(State, Features, TileSize);
+    PipelineCacheBuildStart(&DemoState->PipelineCache, &DemoState->Jobs);
+
+    return Result;
+}
+
+inline tile_pipelines* TiledDeferredTilePipelinesAdd(tiled_deferred_state* State, u32 TileSize)
+{
+    // NOTE: Only adds the pipelines to the cache, they get compiled by the next build
+    Assert(State->NumTilePipelines < TILE_SIZE_NUM_CANDIDATES);
+    tile_pipelines* Result = State->TilePipelineSets + State->NumTilePipelines++;
+    Result->TileSize = TileSize;
+
+    u32 SpecConstants[TiledDeferredSpec_Count];
+    TiledDeferredSpecConstantsFill(TileSize, 0, SpecConstants);
+
+    pipeline_cache* Cache = &DemoState->PipelineCache;
+    Result->GridFrustum = PipelineComputeAddSpecialized(Cache, "shader_tiled_deferred_grid_frustum.spv", "main", State->ComputeDescLayouts, 1,
+                                                        SpecConstants, ArrayCount(SpecConstants));
+    Result->LightCull = PipelineComputeAddSpecialized(Cache, "shader_tiled_deferred_light_culling.spv", "main", State->ComputeDescLayouts, 2,
+                                                      SpecConstants, ArrayCount(SpecConstants));
+    if (TiledDeferredSubgroupOpsSupported())
+    {
+        Result->LightCullSubgroup = PipelineComputeAddSpecialized(Cache, "shader_tiled_deferred_light_culling_subgroup.spv", "main",
+                                                                  State->ComputeDescLayouts, 2, SpecConstants, ArrayCount(SpecConstants));
+    }
+    Result->LightCullBitmask = PipelineComputeAddSpecialized(Cache, "shader_tiled_deferred_light_culling_bitmask.spv", "main", State->ComputeDescLayouts,
+                                                             2, SpecConstants, ArrayCount(SpecConstants));
+    Result->NumCacheEntries = Cache->NumPipelines;
+
+    return Result;
+}
+
+inline tile_pipelines* TiledDeferredTilePipelinesGet(tiled_deferred_state* State, u32 TileSize)
+{
+    // NOTE: Same as the lighting permutations, a new set only starts compiling
+    for (u32 SetId = 0; SetId < State->NumTilePipelines; ++SetId)
+    {
+        if (State->TilePipelineSets[SetId].TileSize == TileSize)
+        {
+            return State->TilePipelineSets + SetId;
+        }
+    }
+
+    tile_pipelines* Result = TiledDeferredTilePipelinesAdd(State, TileSize);
+    PipelineCacheBuildStart(&DemoState->PipelineCache, &DemoState->Jobs);
+
+    return Result;
+}
+
+inline b32 TiledDeferredPipelinesBuilt(u32 NumCacheEntries)
+{
+    b32 Result = PipelineCacheBuilt(&DemoState->PipelineCache, NumCacheEntries);
+    return Result;
+}
+
+inline void TiledDeferredUpload(tiled_deferred_state* State, render_scene* Scene, render_graph* Graph, frame_staging* Staging, upload_ring* Ring)
+{
+    // NOTE: The shaders read the globals straight out of the upload ring
+    tiled_deferred_globals* Globals = UploadRingPushStruct(Ring, tiled_deferred_globals, &State->GlobalsOffset);
+    TiledDeferredGlobalsFill(State, Scene, Globals);
+
+    // NOTE: Features the scene doesn't use get compiled out of the lighting shaders. A new feature set keeps rendering with the current
+    // permutation until it got built
+    lighting_permutation* Permutation = TiledDeferredLightingPermutationGet(State, TiledDeferredLightingFeaturesGet(State, Scene), State->TileSize);
+    if (TiledDeferredPipelinesBuilt(Permutation->NumCacheEntries))
+    {
+        State->LightingPermutation = Permutation;
+    }
+
+    // NOTE: One draw command per mesh, the culling pass fills in the instance counts and the compaction pass packs the visible ones of
+    // every draw group behind the per mesh commands. These go through the frame's staging memory into device local buffers, the copies
+    // and barriers come from the graph's upload pass
+    if (Scene->NumRenderMeshes > 0)
+    {
+        RenderGraphTransferWrite(Graph, State->GraphResources.DrawCommands);
+        gpu_draw_command* DrawCommands = FrameStagingPushArray(Staging, State->DrawCommands, gpu_draw_command, Scene->NumRenderMeshes);
+        for (u32 MeshId = 0; MeshId < Scene->NumRenderMeshes; ++MeshId)
+        {
+            render_mesh* CurrMesh = Scene->RenderMeshes + MeshId;
+            DrawCommands[MeshId] = {};
+            DrawCommands[MeshId].IndexCount = CurrMesh->NumIndices;
+            DrawCommands[MeshId].FirstIndex = CurrMesh->FirstIndex;
+            DrawCommands[MeshId].VertexOffset = CurrMesh->VertexOffset;
+            DrawCommands[MeshId].BoundingRadius = CurrMesh->BoundingRadius;
+        }
+
+        for (u32 GroupId = 0; GroupId < Scene->NumDrawGroups; ++GroupId)
+        {
+            draw_group* CurrGroup = Scene->DrawGroups + GroupId;
+            for (u32 BatchId = CurrGroup->FirstBatch; BatchId < CurrGroup->FirstBatch + CurrGroup->NumBatches; ++BatchId)
+            {
+                instance_batch* CurrBatch = Scene->OpaqueBatches + BatchId;
+                DrawCommands[CurrBatch->MeshId].FirstInstance = State->MultiDrawIndirect ? CurrBatch->FirstInstance : 0;
+                DrawCommands[CurrBatch->MeshId].InstanceBase = CurrBatch->FirstInstance;
+                DrawCommands[CurrBatch->MeshId].DrawGroup = GroupId;
+                DrawCommands[CurrBatch->MeshId].CompactedFirst = SCENE_MAX_RENDER_MESHES + CurrGroup->FirstBatch;
+            }
+        }
+    }
+
+    if (Scene->NumDrawGroups > 0)
+    {
+        RenderGraphTransferWrite(Graph, State->GraphResources.DrawCounts);
+        u32* DrawCounts = FrameStagingPushArray(Staging, State->DrawCounts, u32, Scene->NumDrawGroups);
+        for (u32 GroupId = 0; GroupId < Scene->NumDrawGroups; ++GroupId)
+        {
+            DrawCounts[GroupId] = 0;
+        }
+    }
+}
+
+inline void TiledDeferredBufferAlloc(VkDeviceSize Size, VkBufferUsageFlags Usage, VkBuffer* OutBuffer, VkDeviceMemory* OutMemory)
+{
+    VkBufferCreateInfo BufferCreateInfo = {};
+    BufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    BufferCreateInfo.size = Size;
+    BufferCreateInfo.usage = Usage;
+    BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkCheckResult(vkCreateBuffer(RenderState->Device, &BufferCreateInfo, 0, OutBuffer));
+
+    VkMemoryRequirements MemoryRequirements;
+    vkGetBufferMemoryRequirements(RenderState->Device, *OutBuffer, &MemoryRequirements);
+    *OutMemory = VkMemoryAllocate(RenderState->Device, RenderState->LocalMemoryId, MemoryRequirements.size);
+    VkCheckResult(vkBindBufferMemory(RenderState->Device, *OutBuffer, *OutMemory, 0));
+}
+
+inline tiled_deferred_buffer TiledDeferredBufferCreate(VkDeviceSize Size, VkBufferUsageFlags Usage)
+{
+    tiled_deferred_buffer Result = {};
+    TiledDeferredBufferAlloc(Size, Usage, &Result.Buffer, &Result.Memory);
+    return Result;
+}
+
+inline tiled_deferred_image TiledDeferredImageCreate(u32 Width, u32 Height, VkFormat Format, VkImageUsageFlags Usage)
+{
+    tiled_deferred_image Result = {};
+
+    VkImageCreateInfo ImageCreateInfo = {};
+    ImageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    ImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    ImageCreateInfo.format = Format;
+    ImageCreateInfo.extent.width = Width;
+    ImageCreateInfo.extent.height = Height;
+    ImageCreateInfo.extent.depth = 1;
+    ImageCreateInfo.mipLevels = 1;
+    ImageCreateInfo.arrayLayers = 1;
+    ImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    ImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    ImageCreateInfo.usage = Usage;
+    ImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    ImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkCheckResult(vkCreateImage(RenderState->Device, &ImageCreateInfo, 0, &Result.Image));
+
+    VkMemoryRequirements MemoryRequirements;
+    vkGetImageMemoryRequirements(RenderState->Device, Result.Image, &MemoryRequirements);
+    Result.Memory = VkMemoryAllocate(RenderState->Device, RenderState->LocalMemoryId, MemoryRequirements.size);
+    VkCheckResult(vkBindImageMemory(RenderState->Device, Result.Image, Result.Memory, 0));
+
+    VkImageViewCreateInfo ViewCreateInfo = {};
+    ViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    ViewCreateInfo.image = Result.Image;
+    ViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    ViewCreateInfo.format = Format;
+    ViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    ViewCreateInfo.subresourceRange.levelCount = 1;
+    ViewCreateInfo.subresourceRange.layerCount = 1;
+    VkCheckResult(vkCreateImageView(RenderState->Device, &ViewCreateInfo, 0, &Result.View));
+
+    return Result;
+}
+
+inline void TiledDeferredRetire(tiled_deferred_state* State, VkDeviceMemory Memory, VkBuffer Buffer, VkImage Image, VkImageView View)
+{
+    // NOTE: Frames that are still in flight can reference the old resource, so it gets freed once they finished
+    Assert(State->NumRetired < TILED_DEFERRED_MAX_RETIRED);
+    tiled_deferred_retired* Retired = State->Retired + State->NumRetired++;
+    Retired->FrameId = State->LightListFrameId;
+    Retired->Memory = Memory;
+    Retired->Buffer = Buffer;
+    Retired->Image = Image;
+    Retired->View = View;
+}
+
+inline void TiledDeferredRetiredFree(tiled_deferred_state* State)
+{
+    for (u32 RetiredId = 0; RetiredId < State->NumRetired;)
+    {
+        tiled_deferred_retired* Retired = State->Retired + RetiredId;
+        if (State->LightListFrameId - Retired->FrameId >= TILED_DEFERRED_RETIRE_FRAMES)
+        {
+            if (Retired->View != VK_NULL_HANDLE)
+            {
+                vkDestroyImageView(RenderState->Device, Retired->View, 0);
+            }
+            if (Retired->Image != VK_NULL_HANDLE)
+            {
+                vkDestroyImage(RenderState->Device, Retired->Image, 0);
+            }
+            if (Retired->Buffer != VK_NULL_HANDLE)
+            {
+                vkDestroyBuffer(RenderState->Device, Retired->Buffer, 0);
+            }
+            vkFreeMemory(RenderState->Device, Retired->Memory, 0);
+            *Retired = State->Retired[--State->NumRetired];
+        }
+        else
+        {
+            RetiredId += 1;
+        }
+    }
+}
+
+inline void TiledDeferredBufferRetire(tiled_deferred_state* State, tiled_deferred_buffer* Buffer)
+{
+    TiledDeferredRetire(State, Buffer->Memory, Buffer->Buffer, VK_NULL_HANDLE, VK_NULL_HANDLE);
+}
+
+inline void TiledDeferredImageRetire(tiled_deferred_state* State, tiled_deferred_image* Image)
+{
+    TiledDeferredRetire(State, Image->Memory, VK_NULL_HANDLE, Image->Image, Image->View);
+}
+
+inline void TiledDeferredLightIndexListAlloc(tiled_deferred_state* State, light_index_list* List, u32 Capacity, u32 Binding)
+{
+    List->Capacity = Capacity;
+    List->NumShrinkFrames = 0;
+    TiledDeferredBufferAlloc(sizeof(u32) * Capacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &List->Buffer,
+                             &List->Memory);
+
+    VkDescriptorBufferWrite(&RenderState->DescriptorManager, State->SourceDescriptor, Binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, List->Buffer);
+    State->DescriptorVersion += 1;
+}
+
+inline void TiledDeferredLightIndexListRetire(tiled_deferred_state* State, light_index_list* List)
+{
+    TiledDeferredRetire(State, List->Memory, List->Buffer, VK_NULL_HANDLE, VK_NULL_HANDLE);
+}
+
+inline b32 TiledDeferredLightIndexListFit(tiled_deferred_state* State, light_index_list* List, u32 Required, u32 Binding)
+{
+    u32 NewCapacity = List->Capacity;
+    if (Required > List->Capacity - List->Capacity / 8)
+    {
+        // NOTE: Grow before we start truncating, with 50% headroom
+        NewCapacity = Required + Required / 2;
+        List->NumShrinkFrames = 0;
+    }
+    else if (Required < List->Capacity / 4)
+    {
+        List->NumShrinkFrames += 1;
+        if (List->NumShrinkFrames >= LIGHT_LIST_SHRINK_FRAMES)
+        {
+            NewCapacity = 2 * Required;
+        }
+    }
+    else
+    {
+        List->NumShrinkFrames = 0;
+    }
+    NewCapacity = Min(Max(NewCapacity, (u32)LIGHT_LIST_MIN_CAPACITY), State->MaxLightIndexCapacity);
+
+    b32 Result = NewCapacity != List->Capacity;
+    if (Result)
+    {
+        TiledDeferredLightIndexListRetire(State, List);
+        TiledDeferredLightIndexListAlloc(State, List, NewCapacity, Binding);
+    }
+
+    return Result;
+}
+
+inline u32 TiledDeferredLightMaskWordsGet(tiled_deferred_state* State, render_scene* Scene)
+{
+    // NOTE: Only the bitmask culler reads the masks, the other modes keep a minimum sized buffer so the descriptors stay valid. The masks
+    // get sized for the scenes light capacity rather than the live lights (128B per tile at 1k lights), the capacity only changes when
+    // the light pool grows. Past LIGHT_MASK_MAX_BYTES the culler drops the lights that don't fit and counts them as truncations
+    u32 Result = 0;
+    if (State->LightCullMode == LightCullMode_TiledBitmask)
+    {
+        u32 MaxWords = Max(LIGHT_MASK_MAX_BYTES / u32(sizeof(u32) * State->NumLightMaskTiles), 1u);
+        Result = Min(CeilU32(f32(Scene->PointLightPool.Capacity) / 32.0f), MaxWords);
+    }
+
+    return Result;
+}
+
+inline void TiledDeferredLightMasksAlloc(tiled_deferred_state* State)
+{
+    u32 Capacity = Max(State->NumLightMaskWords * State->NumLightMaskTiles, (u32)LIGHT_LIST_MIN_CAPACITY);
+    TiledDeferredLightIndexListAlloc(State, &State->LightMask_O, Capacity, 18);
+    TiledDeferredLightIndexListAlloc(State, &State->LightMask_T, Capacity, 19);
+}
+
+inline b32 TiledDeferredLightMasksFit(tiled_deferred_state* State)
+{
+    u32 NumWords = TiledDeferredLightMaskWordsGet(State, State->Scene);
+    b32 Result = NumWords != State->NumLightMaskWords;
+    if (Result)
+    {
+        State->NumLightMaskWords = NumWords;
+        TiledDeferredLightIndexListRetire(State, &State->LightMask_O);
+        TiledDeferredLightIndexListRetire(State, &State->LightMask_T);
+        TiledDeferredLightMasksAlloc(State);
+    }
+
+    return Result;
+}
+
+inline void TiledDeferredLightListsUpdate(tiled_deferred_state* State)
+{
+    // NOTE: Free retired lists (and resize leftovers) once no frame in flight can reference them
+    TiledDeferredRetiredFree(State);
+
+    // NOTE: This slot was written LIGHT_LIST_READBACK_LATENCY frames ago, the frame we record next overwrites it
+    State->LightListSlot = State->LightListFrameId % LIGHT_LIST_READBACK_LATENCY;
+    b32 Resized = TiledDeferredLightMasksFit(State);
+    if (State->LightListFrameId - State->LightListFirstFrameId >= LIGHT_LIST_READBACK_LATENCY)
+    {
+        light_list_readback Readback = State->LightListReadbackData[State->LightListSlot];
+        light_list_stats* Stats = &State->LightListStats;
+        Stats->Required_O = Readback.Counter_O;
+        Stats->Required_T = Readback.Counter_T;
+        Stats->NumTileOverflows += Readback.NumTileOverflows;
+        Stats->NumListTruncations += Readback.NumListTruncations;
+
+        Resized = TiledDeferredLightIndexListFit(State, &State->LightIndexList_O, Readback.Counter_O, 3) || Resized;
+        Resized = TiledDeferredLightIndexListFit(State, &State->LightIndexList_T, Readback.Counter_T, 6) || Resized;
+    }
+
+    if (Resized)
+    {
+        // NOTE: Only the source set changed, the frames in flight keep using their own set with the old lists
+        State->LightListStats.NumResizes += 1;
+        VkDescriptorManagerFlush(RenderState->Device, &RenderState->DescriptorManager);
+    }
+
+    State->LightListFrameId += 1;
+}
+
+inline void TiledDeferredSwapChainChange(tiled_deferred_state* State, u32 Width, u32 Height, render_scene* Scene)
+{
+    // NOTE: Doesn't wait for the GPU. The frames in flight keep their resources (retired until they are done) and their descriptor
+    // sets, the new ones only get used by the frames we record from here on
+    b32 ReCreate = State->GridFrustums.Buffer != VK_NULL_HANDLE;
+    
+    // NOTE: Render Target Data, the graph recreates (and re-places) them before the next frame
+    RenderGraphTransientsResize(&DemoState->RenderGraph, Width, Height);
     
     // NOTE: Tiled Data
     {
-        u32 NumTilesX = CeilU32(f32(Width) / f32(TILE_SIZE_IN_PIXELS));
-        u32 NumTilesY = CeilU32(f32(Height) / f32(TILE_SIZE_IN_PIXELS));
+        u32 NumTilesX = CeilU32(f32(Width) / f32(State->TileSize));
+        u32 NumTilesY = CeilU32(f32(Height) / f32(State->TileSize));
 
-        // NOTE: Destroy old data
+        // NOTE: Retire old data
         if (ReCreate)
         {
-            vkDestroyBuffer(RenderState->Device, State->GridFrustums, 0);
-            vkDestroyBuffer(RenderState->Device, State->LightIndexList_O, 0);
-            vkDestroyBuffer(RenderState->Device, State->LightIndexList_T, 0);
-            vkDestroyImageView(RenderState->Device, State->LightGrid_O.View, 0);
-            vkDestroyImage(RenderState->Device, State->LightGrid_O.Image, 0);
-            vkDestroyImageView(RenderState->Device, State->LightGrid_T.View, 0);
-            vkDestroyImage(RenderState->Device, State->LightGrid_T.Image, 0);
+            TiledDeferredBufferRetire(State, &State->GridFrustums);
+            TiledDeferredLightIndexListRetire(State, &State->LightIndexList_O);
+            TiledDeferredLightIndexListRetire(State, &State->LightIndexList_T);
+            TiledDeferredImageRetire(State, &State->LightGrid_O);
+            TiledDeferredImageRetire(State, &State->LightGrid_T);
+            TiledDeferredBufferRetire(State, &State->ClusterLightGrid);
+            TiledDeferredBufferRetire(State, &State->ClusterLightIndexList);
+            TiledDeferredLightIndexListRetire(State, &State->LightMask_O);
+            TiledDeferredLightIndexListRetire(State, &State->LightMask_T);
+            TiledDeferredBufferRetire(State, &State->TileBucketLists);
         }
         
-        State->GridFrustums = VkBufferCreate(RenderState->Device, &State->RenderTargetArena, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                             sizeof(frustum) * NumTilesX * NumTilesY);
-        State->LightGrid_O = VkImageCreate(RenderState->Device, &State->RenderTargetArena, NumTilesX, NumTilesY, VK_FORMAT_R32G32_UINT,
-                                           VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
-        State->LightIndexList_O = VkBufferCreate(RenderState->Device, &State->RenderTargetArena, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                                 sizeof(u32) * MAX_LIGHTS_PER_TILE * NumTilesX * NumTilesY);
-        State->LightGrid_T = VkImageCreate(RenderState->Device, &State->RenderTargetArena, NumTilesX, NumTilesY, VK_FORMAT_R32G32_UINT,
-                                           VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
-        State->LightIndexList_T = VkBufferCreate(RenderState->Device, &State->RenderTargetArena, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                                 sizeof(u32) * MAX_LIGHTS_PER_TILE * NumTilesX * NumTilesY);
-
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, State->TiledDeferredDescriptor, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, State->GridFrustums);
-        VkDescriptorImageWrite(&RenderState->DescriptorManager, State->TiledDeferredDescriptor, 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        State->GridFrustums = TiledDeferredBufferCreate(sizeof(frustum) * NumTilesX * NumTilesY,
+                                                        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        State->GridFrustumsDirty = true;
+        State->LightGrid_O = TiledDeferredImageCreate(NumTilesX, NumTilesY, VK_FORMAT_R32G32_UINT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        State->LightGrid_T = TiledDeferredImageCreate(NumTilesX, NumTilesY, VK_FORMAT_R32G32_UINT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, State->GridFrustums.Buffer);
+        VkDescriptorImageWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
                                State->LightGrid_O.View, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL);
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, State->TiledDeferredDescriptor, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, State->LightIndexList_O);
-        VkDescriptorImageWrite(&RenderState->DescriptorManager, State->TiledDeferredDescriptor, 5, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        VkDescriptorImageWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 5, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
                                State->LightGrid_T.View, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL);
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, State->TiledDeferredDescriptor, 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, State->LightIndexList_T);
+
+        // NOTE: Start the index lists at a guess of 32 lights per tile, the counter readback resizes them from there. The readbacks
+        // still in flight were sized for the old grid
+        State->MaxLightIndexCapacity = MAX_LIGHTS_PER_TILE * NumTilesX * NumTilesY;
+        u32 InitialCapacity = Min(Max(32 * NumTilesX * NumTilesY, (u32)LIGHT_LIST_MIN_CAPACITY), State->MaxLightIndexCapacity);
+        TiledDeferredLightIndexListAlloc(State, &State->LightIndexList_O, InitialCapacity, 3);
+        TiledDeferredLightIndexListAlloc(State, &State->LightIndexList_T, InitialCapacity, 6);
+        State->LightListFirstFrameId = State->LightListFrameId;
+
+        // NOTE: Clusters
+        u32 NumClusters = (CeilU32(f32(Width) / f32(CLUSTER_TILE_SIZE_IN_PIXELS)) * CeilU32(f32(Height) / f32(CLUSTER_TILE_SIZE_IN_PIXELS)) *
+                           CLUSTER_NUM_SLICES);
+        State->ClusterLightGrid = TiledDeferredBufferCreate(2 * sizeof(u32) * NumClusters, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        State->ClusterLightIndexList = TiledDeferredBufferCreate(sizeof(u32) * MAX_LIGHTS_PER_CLUSTER * NumClusters, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 15, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, State->ClusterLightGrid.Buffer);
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 16, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, State->ClusterLightIndexList.Buffer);
+
+        // NOTE: Light masks scale with the scenes light capacity instead of MAX_LIGHTS_PER_TILE indices
+        State->NumLightMaskTiles = NumTilesX * NumTilesY;
+        State->NumLightMaskWords = TiledDeferredLightMaskWordsGet(State, Scene);
+        TiledDeferredLightMasksAlloc(State);
+
+        // NOTE: Tile classification, every bucket can hold all tiles
+        State->TileBucketLists = TiledDeferredBufferCreate(sizeof(u32) * TileBucket_Count * NumTilesX * NumTilesY, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 24, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, State->TileBucketLists.Buffer);
     }
 
+    // NOTE: The grid frustums get computed by the next frame (TiledDeferredGridFrustumPass), the frame slots pick up the new descriptors
+    // in TiledDeferredDescriptorsSync
     VkDescriptorManagerFlush(RenderState->Device, &RenderState->DescriptorManager);
-    
-    // NOTE: Init Grid Frustums
-    vk_commands Commands = RenderState->Commands;
-    VkCommandsBegin(RenderState->Device, Commands);
-    {
-        // NOTE: Init our images
-        VkBarrierImageAdd(&RenderState->BarrierManager, VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                          VK_IMAGE_LAYOUT_UNDEFINED, VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_IMAGE_LAYOUT_GENERAL,
-                          VK_IMAGE_ASPECT_COLOR_BIT, State->LightGrid_O.Image);
-        VkBarrierImageAdd(&RenderState->BarrierManager, VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                          VK_IMAGE_LAYOUT_UNDEFINED, VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_IMAGE_LAYOUT_GENERAL,
-                          VK_IMAGE_ASPECT_COLOR_BIT, State->LightGrid_T.Image);
-        VkBarrierManagerFlush(&RenderState->BarrierManager, Commands.Buffer);
-
-        // NOTE: Update our tiled deferred globals
-        {
-            tiled_deferred_globals* Data = VkTransferPushWriteStruct(&RenderState->TransferManager, State->TiledDeferredGlobals, tiled_deferred_globals,
-                                                                     BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
-                                                                     BarrierMask(VK_ACCESS_UNIFORM_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT));
-            *Data = {};
-            Data->InverseProjection = Inverse(CameraGetP(&Scene->Camera));
-            Data->ScreenSize = V2(RenderState->WindowWidth, RenderState->WindowHeight);
-            Data->GridSizeX = CeilU32(f32(RenderState->WindowWidth) / f32(TILE_SIZE_IN_PIXELS));
-            Data->GridSizeY = CeilU32(f32(RenderState->WindowHeight) / f32(TILE_SIZE_IN_PIXELS));
+    State->DescriptorVersion += 1;
+}
+
+inline b32 TiledDeferredTileSizeSupported(u32 TileSize)
+{
+    // NOTE: The per tile kernels run one invocation per pixel of the tile
+    VkPhysicalDeviceProperties Properties;
+    vkGetPhysicalDeviceProperties(RenderState->PhysicalDevice, &Properties);
+    VkPhysicalDeviceLimits* Limits = &Properties.limits;
+    b32 Result = (Limits->maxComputeWorkGroupInvocations >= TileSize * TileSize &&
+                  Limits->maxComputeWorkGroupSize[0] >= TileSize &&
+                  Limits->maxComputeWorkGroupSize[1] >= TileSize);
+    return Result;
+}
+
+/*
+
+  NOTE: Switches to the pending tile size once its tile kernels and a lighting permutation for it are built, the old size keeps
+        rendering until then. Runs between frames, the tile grid resources get recreated like on a resize and the frames in flight
+        finish with the old ones.
+
+ */
+inline void TiledDeferredTileSizeUpdate(tiled_deferred_state* State, render_scene* Scene)
+{
+    u32 TileSize = State->PendingTileSize;
+    if (TileSize == 0)
+    {
+        return;
+    }
+
+    tile_pipelines* TilePipelines = TiledDeferredTilePipelinesGet(State, TileSize);
+    lighting_permutation* Permutation = TiledDeferredLightingPermutationGet(State, TiledDeferredLightingFeaturesGet(State, Scene), TileSize);
+    if (!TiledDeferredPipelinesBuilt(TilePipelines->NumCacheEntries) || !TiledDeferredPipelinesBuilt(Permutation->NumCacheEntries))
+    {
+        return;
+    }
+
+    State->PendingTileSize = 0;
+    State->TileSize = TileSize;
+    State->TilePipelines = TilePipelines;
+    State->LightingPermutation = Permutation;
+    TiledDeferredSwapChainChange(State, RenderState->WindowWidth, RenderState->WindowHeight, Scene);
+}
+
+inline void TiledDeferredTileSizeSet(tiled_deferred_state* State, u32 TileSize, render_scene* Scene)
+{
+    // NOTE: Sizes we already built switch right away, new ones once TiledDeferredTileSizeUpdate finds their pipelines built
+    Assert(TiledDeferredTileSizeSupported(TileSize));
+    State->PendingTileSize = State->TileSize == TileSize ? 0 : TileSize;
+    TiledDeferredTileSizeUpdate(State, Scene);
+}
+
+inline u32 TiledDeferredTileSizeCandidateGet(u32 CandidateId)
+{
+    u32 Result = TILE_SIZE_IN_PIXELS << CandidateId;
+    return Result;
+}
+
+inline b32 TiledDeferredTileTuneNext(tiled_deferred_state* State, render_scene* Scene, u32 FirstCandidateId)
+{
+    // NOTE: Switches to the next candidate the device can run, returns false once we tried all of them
+    tile_size_tuner* Tuner = &State->TileTuner;
+    for (u32 CandidateId = FirstCandidateId; CandidateId < TILE_SIZE_NUM_CANDIDATES; ++CandidateId)
+    {
+        u32 TileSize = TiledDeferredTileSizeCandidateGet(CandidateId);
+        if (TiledDeferredTileSizeSupported(TileSize))
+        {
+            Tuner->CandidateId = CandidateId;
+            Tuner->NumFrames = 0;
+            Tuner->NumSamples = 0;
+            Tuner->SumMs = 0.0f;
+            TiledDeferredTileSizeSet(State, TileSize, Scene);
+            return true;
         }
-        VkTransferManagerFlush(&RenderState->TransferManager, RenderState->Device, RenderState->Commands.Buffer, &RenderState->BarrierManager);
+    }
 
-        vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, State->GridFrustumPipeline->Handle);
-        VkDescriptorSet DescriptorSets[] =
-            {
-                State->TiledDeferredDescriptor,
-            };
-        vkCmdBindDescriptorSets(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, State->GridFrustumPipeline->Layout, 0,
-                                ArrayCount(DescriptorSets), DescriptorSets, 0, 0);
-        u32 DispatchX = CeilU32(f32(RenderState->WindowWidth) / f32(8 * TILE_SIZE_IN_PIXELS));
-        u32 DispatchY = CeilU32(f32(RenderState->WindowHeight) / f32(8 * TILE_SIZE_IN_PIXELS));
-        vkCmdDispatch(Commands.Buffer, DispatchX, DispatchY, 1);
+    return false;
+}
+
+/*
+
+  NOTE: Benchmarks every tile size candidate on the scene as it is (light count, culling and lighting mode), keeping the fastest.
+        The scene should stay put while the tuner runs, TiledDeferredTileTuneUpdate drives it once per frame.
+
+ */
+inline void TiledDeferredTileTuneBegin(tiled_deferred_state* State, render_scene* Scene)
+{
+    tile_size_tuner* Tuner = &State->TileTuner;
+    *Tuner = {};
+    Tuner->Active = TiledDeferredTileTuneNext(State, Scene, 0);
+}
+
+inline void TiledDeferredTileTuneUpdate(tiled_deferred_state* State, gpu_profiler* Profiler, render_scene* Scene)
+{
+    // NOTE: Has to run outside of a frame, switching the tile size rebuilds the tile grid
+    tile_size_tuner* Tuner = &State->TileTuner;
+    if (!Tuner->Active || State->PendingTileSize != 0)
+    {
+        // NOTE: Frames that still run the previous size while the candidate compiles don't count
+        return;
+    }
+
+    // NOTE: The light list sizes settle within the warmup too, the lists start over after a switch
+    Tuner->NumFrames += 1;
+    f32 CullMs = 0.0f;
+    f32 LightingMs = 0.0f;
+    b32 NewCull = GpuProfilerLatestSampleGet(Profiler, "LightCulling", &Tuner->LastCullSample, &CullMs);
+    b32 NewLighting = GpuProfilerLatestSampleGet(Profiler, "Lighting", &Tuner->LastLightingSample, &LightingMs);
+    if (Tuner->NumFrames > TILE_TUNE_WARMUP_FRAMES && NewCull && NewLighting)
+    {
+        Tuner->SumMs += CullMs + LightingMs;
+        Tuner->NumSamples += 1;
+    }
+
+    if (Tuner->NumSamples < TILE_TUNE_MEASURE_FRAMES)
+    {
+        return;
+    }
+
+    Tuner->CandidateMs[Tuner->CandidateId] = Tuner->SumMs / f32(Tuner->NumSamples);
+    if (TiledDeferredTileTuneNext(State, Scene, Tuner->CandidateId + 1))
+    {
+        return;
+    }
+
+    u32 BestCandidateId = Tuner->CandidateId;
+    for (u32 CandidateId = 0; CandidateId < TILE_SIZE_NUM_CANDIDATES; ++CandidateId)
+    {
+        if (Tuner->CandidateMs[CandidateId] > 0.0f && Tuner->CandidateMs[CandidateId] < Tuner->CandidateMs[BestCandidateId])
+        {
+            BestCandidateId = CandidateId;
+        }
     }
-    VkCommandsSubmit(RenderState->GraphicsQueue, Commands);
+
+    TiledDeferredTileSizeSet(State, TiledDeferredTileSizeCandidateGet(BestCandidateId), Scene);
+    Tuner->Active = false;
 }
 
-inline void TiledDeferredCreate(renderer_create_info CreateInfo, VkDescriptorSet* OutputRtSet, tiled_deferred_state* Result)
+inline void TiledDeferredCreate(renderer_create_info CreateInfo, VkDescriptorSet* OutputRtSets, tiled_deferred_state* Result)
 {
     *Result = {};
-
-    u64 HeapSize = GigaBytes(1);
-    Result->RenderTargetArena = VkLinearArenaCreate(VkMemoryAllocate(RenderState->Device, RenderState->LocalMemoryId, HeapSize), HeapSize);
+    Result->Scene = CreateInfo.Scene;
+    Copy(OutputRtSets, Result->OutputRtSets, sizeof(Result->OutputRtSets));
+    Result->TileSize = TILE_SIZE_IN_PIXELS;
+    Result->RimEnabled = true;
+    Result->CausticsEnabled = true;
     
     // NOTE: Create globals
     {        
-        Result->TiledDeferredGlobals = VkBufferCreate(RenderState->Device, &RenderState->GpuArena, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                      sizeof(tiled_deferred_globals));
-        Result->LightIndexCounter_O = VkBufferCreate(RenderState->Device, &RenderState->GpuArena, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                                     sizeof(u32));
-        Result->LightIndexCounter_T = VkBufferCreate(RenderState->Device, &RenderState->GpuArena, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                                     sizeof(u32));
+        // NOTE: All the light counters come in pairs, see LightCounterParity
+        Result->LightIndexCounter_O = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
+                                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                     2 * sizeof(u32));
+        Result->LightIndexCounter_T = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
+                                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                     2 * sizeof(u32));
+        Result->LightListOverflow = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
+                                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                   2 * 2 * sizeof(u32));
+        Result->ClusterLightIndexCounter = VkBufferCreate(RenderState->Device, &RenderState->GpuArena, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                          2 * sizeof(u32));
+        Result->DrawCommands = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
+                                              VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                              2 * sizeof(gpu_draw_command) * SCENE_MAX_RENDER_MESHES);
+        Result->DrawCounts = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
+                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                            sizeof(u32) * SCENE_MAX_RENDER_MESHES);
+        Result->TileBuckets = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
+                                             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                             2 * sizeof(gpu_tile_bucket) * TileBucket_Count);
+        Result->VisibleInstanceIds = VkBufferCreate(RenderState->Device, &RenderState->GpuArena, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                    sizeof(u32) * SCENE_MAX_OPAQUE_INSTANCES);
+
+        // NOTE: Light list readback, host visible so the counters can be read directly once the frame's fence passed
+        {
+            VkBufferCreateInfo BufferCreateInfo = {};
+            BufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            BufferCreateInfo.size = sizeof(light_list_readback) * LIGHT_LIST_READBACK_LATENCY;
+            BufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            VkCheckResult(vkCreateBuffer(RenderState->Device, &BufferCreateInfo, 0, &Result->LightListReadbackBuffer));
+
+            VkMemoryRequirements MemoryRequirements;
+            vkGetBufferMemoryRequirements(RenderState->Device, Result->LightListReadbackBuffer, &MemoryRequirements);
+            u32 MemoryTypeId = HostCoherentMemoryTypeGet(MemoryRequirements.memoryTypeBits);
+
+            Result->LightListReadbackMemory = VkMemoryAllocate(RenderState->Device, MemoryTypeId, MemoryRequirements.size);
+            VkCheckResult(vkBindBufferMemory(RenderState->Device, Result->LightListReadbackBuffer, Result->LightListReadbackMemory, 0));
+            VkCheckResult(vkMapMemory(RenderState->Device, Result->LightListReadbackMemory, 0, VK_WHOLE_SIZE, 0,
+                                      (void**)&Result->LightListReadbackData));
+        }
+
+        // NOTE: Both halves of the light counters start out reset, after that the culler keeps them that way (gets flushed with
+        // the rest of the init uploads)
+        {
+            VkBuffer ZeroedCounters[] =
+                {
+                    Result->LightIndexCounter_O,
+                    Result->LightIndexCounter_T,
+                    Result->ClusterLightIndexCounter,
+                };
+            for (u32 CounterId = 0; CounterId < ArrayCount(ZeroedCounters); ++CounterId)
+            {
+                u32* GpuData = VkTransferPushWriteArray(&RenderState->TransferManager, ZeroedCounters[CounterId], u32, 2,
+                                                        BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
+                                                        BarrierMask(VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT));
+                GpuData[0] = 0;
+                GpuData[1] = 0;
+            }
+
+            u32* Overflow = VkTransferPushWriteArray(&RenderState->TransferManager, Result->LightListOverflow, u32, 4,
+                                                     BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
+                                                     BarrierMask(VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT));
+            for (u32 CounterId = 0; CounterId < 4; ++CounterId)
+            {
+                Overflow[CounterId] = 0;
+            }
+            
+            gpu_tile_bucket* Buckets = VkTransferPushWriteArray(&RenderState->TransferManager, Result->TileBuckets, gpu_tile_bucket, 2 * TileBucket_Count,
+                                                                BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
+                                                                BarrierMask(VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT));
+            for (u32 BucketId = 0; BucketId < 2 * TileBucket_Count; ++BucketId)
+            {
+                Buckets[BucketId] = {};
+                Buckets[BucketId].DispatchY = 1;
+                Buckets[BucketId].DispatchZ = 1;
+            }
+        }
+        
+        // NOTE: Every draw group draws all of its meshes with one call when the device got everything that needs enabled
+        if (DemoState->DrawIndirectCountEnabled && DemoState->DeviceFeatures.multiDrawIndirect &&
+            DemoState->DeviceFeatures.drawIndirectFirstInstance)
+        {
+            Result->DrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(RenderState->Device,
+                                                                                                         "vkCmdDrawIndexedIndirectCountKHR");
+            Result->MultiDrawIndirect = Result->DrawIndexedIndirectCount != 0;
+        }
         
         {
             vk_descriptor_layout_builder Builder = VkDescriptorLayoutBegin(&Result->TiledDeferredDescLayout);
 
             // NOTE: Tiled Descriptors
-            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
             VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
             VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
             VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
@@ -165,74 +835,158 @@ inline void TiledDeferredCreate(renderer_create_info CreateInfo, VkDescriptorSet
             VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
             VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
             VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+
+            // NOTE: Instance Culling Descriptors
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+
+            // NOTE: Cluster Descriptors
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+
+            // NOTE: Light Mask Descriptors
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+
+            // NOTE: Light List Overflow Descriptors
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+
+            // NOTE: Compact GBuffer Descriptors
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+
+            // NOTE: Compute Lighting Descriptors
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
             
             VkDescriptorLayoutEnd(RenderState->Device, &Builder);
         }
 
-        Result->TiledDeferredDescriptor = VkDescriptorSetAllocate(RenderState->Device, RenderState->DescriptorPool, Result->TiledDeferredDescLayout);
+        // NOTE: The frame sets get copied from the source set the first time a frame uses them
+        Result->SourceDescriptor = VkDescriptorSetAllocate(RenderState->Device, RenderState->DescriptorPool, Result->TiledDeferredDescLayout);
+        for (u32 FrameSlot = 0; FrameSlot < TILED_DEFERRED_MAX_FRAME_DESCRIPTORS; ++FrameSlot)
+        {
+            Result->FrameDescriptors[FrameSlot] = VkDescriptorSetAllocate(RenderState->Device, RenderState->DescriptorPool, Result->TiledDeferredDescLayout);
+        }
+        Result->TiledDeferredDescriptor = Result->FrameDescriptors[0];
+        Result->DescriptorVersion = 1;
 
         // NOTE: Tiled Data
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->TiledDeferredDescriptor, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, Result->TiledDeferredGlobals);
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->TiledDeferredDescriptor, 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Result->LightIndexCounter_O);
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->TiledDeferredDescriptor, 7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Result->LightIndexCounter_T);
+        UploadRingDescriptorWrite(&DemoState->UploadRing, Result->SourceDescriptor, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                                  sizeof(tiled_deferred_globals));
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->SourceDescriptor, 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Result->LightIndexCounter_O);
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->SourceDescriptor, 7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Result->LightIndexCounter_T);
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->SourceDescriptor, 20, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Result->LightListOverflow);
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->SourceDescriptor, 23, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Result->TileBuckets);
+
+        // NOTE: Instance Culling Data
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->SourceDescriptor, 12, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Result->DrawCommands);
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->SourceDescriptor, 13, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Result->DrawCounts);
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->SourceDescriptor, 14, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Result->VisibleInstanceIds);
+
+        // NOTE: Cluster Data
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->SourceDescriptor, 17, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Result->ClusterLightIndexCounter);
     }
 
-    // NOTE: Grid Frustum
+    // NOTE: Instance Culling
     {
         VkDescriptorSetLayout Layouts[] =
             {
                 Result->TiledDeferredDescLayout,
+                CreateInfo.SceneDescLayout,
             };
             
-        Result->GridFrustumPipeline = VkPipelineComputeCreate(RenderState->Device, &RenderState->PipelineManager, &DemoState->TempArena,
-                                                              "shader_tiled_deferred_grid_frustum.spv", "main", Layouts, ArrayCount(Layouts));
+        Result->InstanceCullPipeline = PipelineComputeAdd(&DemoState->PipelineCache, "shader_tiled_deferred_instance_culling.spv", "main", Layouts,
+                                                          ArrayCount(Layouts));
+        Result->DrawCompactionPipeline = PipelineComputeAdd(&DemoState->PipelineCache, "shader_tiled_deferred_draw_compaction.spv", "main", Layouts,
+                                                            ArrayCount(Layouts));
     }
 
     // NOTE: Caustics data
     {
         vk_descriptor_layout_builder Builder = VkDescriptorLayoutBegin(&Result->CausticsDescLayout);
         VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
-        VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+        VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
         VkDescriptorLayoutEnd(RenderState->Device, &Builder);
 
         Result->CausticsDescriptor = VkDescriptorSetAllocate(RenderState->Device, RenderState->DescriptorPool, Result->CausticsDescLayout);
-        Result->CausticsInputBuffer = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
-                                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                                     sizeof(gpu_caustics_input_buffer));
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Result->CausticsDescriptor, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, Result->CausticsInputBuffer);
+        UploadRingDescriptorWrite(&DemoState->UploadRing, Result->CausticsDescriptor, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                                  sizeof(gpu_caustics_input_buffer));
 
         Result->CausticsSampler = VkSamplerCreate(RenderState->Device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, 16.0f);
     }
 
-    TiledDeferredSwapChainChange(Result, CreateInfo.Width, CreateInfo.Height, CreateInfo.ColorFormat, CreateInfo.Scene, OutputRtSet);
+    // NOTE: Render graph resources, buffers that get recreated on resize are set again every frame
+    {
+        render_graph* Graph = &DemoState->RenderGraph;
+        tiled_deferred_graph_resources* Resources = &Result->GraphResources;
+
+        Resources->GBufferPosition = RenderGraphTransientImageAdd(Graph, "GBufferPosition", VK_FORMAT_R32G32B32A32_SFLOAT,
+                                                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                                  VK_IMAGE_ASPECT_COLOR_BIT);
+        Resources->GBufferNormal = RenderGraphTransientImageAdd(Graph, "GBufferNormal", VK_FORMAT_R32G32B32A32_SFLOAT,
+                                                                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                                VK_IMAGE_ASPECT_COLOR_BIT);
+        Resources->GBufferMaterial = RenderGraphTransientImageAdd(Graph, "GBufferMaterial", VK_FORMAT_R32G32_UINT,
+                                                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                                  VK_IMAGE_ASPECT_COLOR_BIT);
+        Resources->GBufferNormalCompact = RenderGraphTransientImageAdd(Graph, "GBufferNormalCompact", VK_FORMAT_R16G16_SFLOAT,
+                                                                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                                       VK_IMAGE_ASPECT_COLOR_BIT);
+        Resources->Depth = RenderGraphTransientImageAdd(Graph, "Depth", VK_FORMAT_D32_SFLOAT,
+                                                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                        VK_IMAGE_ASPECT_DEPTH_BIT);
+        Resources->OutColor = RenderGraphTransientImageAdd(Graph, "OutColor", CreateInfo.ColorFormat,
+                                                           VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT |
+                                                           VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
 
+        Resources->DrawCommands = RenderGraphBufferImport(Graph, "DrawCommands", Result->DrawCommands);
+        Resources->DrawCounts = RenderGraphBufferImport(Graph, "DrawCounts", Result->DrawCounts);
+        Resources->VisibleInstanceIds = RenderGraphBufferImport(Graph, "VisibleInstanceIds", Result->VisibleInstanceIds);
+        Resources->GridFrustums = RenderGraphBufferImport(Graph, "GridFrustums", VK_NULL_HANDLE);
+        Resources->LightGrid_O = RenderGraphImageImport(Graph, "LightGrid_O", VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+        Resources->LightGrid_T = RenderGraphImageImport(Graph, "LightGrid_T", VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+        Resources->LightIndexList_O = RenderGraphBufferImport(Graph, "LightIndexList_O", VK_NULL_HANDLE);
+        Resources->LightIndexList_T = RenderGraphBufferImport(Graph, "LightIndexList_T", VK_NULL_HANDLE);
+        Resources->LightIndexCounter_O = RenderGraphBufferImport(Graph, "LightIndexCounter_O", Result->LightIndexCounter_O);
+        Resources->LightIndexCounter_T = RenderGraphBufferImport(Graph, "LightIndexCounter_T", Result->LightIndexCounter_T);
+        Resources->LightListOverflow = RenderGraphBufferImport(Graph, "LightListOverflow", Result->LightListOverflow);
+        Resources->LightListReadback = RenderGraphBufferImport(Graph, "LightListReadback", Result->LightListReadbackBuffer);
+        Resources->ClusterLightGrid = RenderGraphBufferImport(Graph, "ClusterLightGrid", VK_NULL_HANDLE);
+        Resources->ClusterLightIndexList = RenderGraphBufferImport(Graph, "ClusterLightIndexList", VK_NULL_HANDLE);
+        Resources->ClusterLightIndexCounter = RenderGraphBufferImport(Graph, "ClusterLightIndexCounter", Result->ClusterLightIndexCounter);
+        Resources->LightMask_O = RenderGraphBufferImport(Graph, "LightMask_O", VK_NULL_HANDLE);
+        Resources->LightMask_T = RenderGraphBufferImport(Graph, "LightMask_T", VK_NULL_HANDLE);
+        Resources->TileBuckets = RenderGraphBufferImport(Graph, "TileBuckets", Result->TileBuckets);
+        Resources->TileBucketLists = RenderGraphBufferImport(Graph, "TileBucketLists", VK_NULL_HANDLE);
+    }
+    
     // NOTE: Create PSOs
     // IMPORTANT: We don't do this in a single render pass since we cannot do compute between graphics
     {
+        render_graph* Graph = &DemoState->RenderGraph;
+        tiled_deferred_graph_resources* Resources = &Result->GraphResources;
+        
         // NOTE: GBuffer Pass
         {
-            // NOTE: RT
+            // NOTE: Compatible render pass, the graph derives the real load/store ops and layouts per frame
             {
-                render_target_builder Builder = RenderTargetBuilderBegin(&DemoState->Arena, &DemoState->TempArena, CreateInfo.Width, CreateInfo.Height);
-                RenderTargetAddTarget(&Builder, &Result->GBufferPositionEntry, VkClearColorCreate(0, 0, 0, 1));
-                RenderTargetAddTarget(&Builder, &Result->GBufferNormalEntry, VkClearColorCreate(0, 0, 0, 1));
-                RenderTargetAddTarget(&Builder, &Result->GBufferMaterialEntry, VkClearColorCreate(0xFFFFFFFF, 0, 0, 0));
-                RenderTargetAddTarget(&Builder, &Result->DepthEntry, VkClearDepthStencilCreate(0, 0));
-                            
                 vk_render_pass_builder RpBuilder = VkRenderPassBuilderBegin(&DemoState->TempArena);
 
-                u32 GBufferPositionId = VkRenderPassAttachmentAdd(&RpBuilder, Result->GBufferPositionEntry.Format, VK_ATTACHMENT_LOAD_OP_CLEAR,
-                                                                  VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_UNDEFINED,
-                                                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-                u32 GBufferNormalId = VkRenderPassAttachmentAdd(&RpBuilder, Result->GBufferNormalEntry.Format, VK_ATTACHMENT_LOAD_OP_CLEAR,
-                                                                VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_UNDEFINED,
-                                                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-                u32 GBufferColorId = VkRenderPassAttachmentAdd(&RpBuilder, Result->GBufferMaterialEntry.Format, VK_ATTACHMENT_LOAD_OP_CLEAR,
-                                                               VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_UNDEFINED,
-                                                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-                u32 DepthId = VkRenderPassAttachmentAdd(&RpBuilder, Result->DepthEntry.Format, VK_ATTACHMENT_LOAD_OP_CLEAR,
-                                                        VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_UNDEFINED,
-                                                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+                u32 GBufferPositionId = VkRenderPassAttachmentAdd(&RpBuilder, RenderGraphFormatGet(Graph, Resources->GBufferPosition),
+                                                                  VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE,
+                                                                  VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+                u32 GBufferNormalId = VkRenderPassAttachmentAdd(&RpBuilder, RenderGraphFormatGet(Graph, Resources->GBufferNormal),
+                                                                VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE,
+                                                                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+                u32 GBufferColorId = VkRenderPassAttachmentAdd(&RpBuilder, RenderGraphFormatGet(Graph, Resources->GBufferMaterial),
+                                                               VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE,
+                                                               VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+                u32 DepthId = VkRenderPassAttachmentAdd(&RpBuilder, RenderGraphFormatGet(Graph, Resources->Depth), VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                                        VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 
                 VkRenderPassSubPassBegin(&RpBuilder, VK_PIPELINE_BIND_POINT_GRAPHICS);
                 VkRenderPassColorRefAdd(&RpBuilder, GBufferPositionId, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
@@ -241,36 +995,17 @@ inline void TiledDeferredCreate(renderer_create_info CreateInfo, VkDescriptorSet
                 VkRenderPassDepthRefAdd(&RpBuilder, DepthId, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
                 VkRenderPassSubPassEnd(&RpBuilder);
 
-                VkRenderPassDependency(&RpBuilder, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-                                       VK_ACCESS_SHADER_READ_BIT, VK_DEPENDENCY_BY_REGION_BIT);
-
-                Result->GBufferPass = RenderTargetBuilderEnd(&Builder, VkRenderPassBuilderEnd(&RpBuilder, RenderState->Device));
+                Result->GBufferRenderPass = VkRenderPassBuilderEnd(&RpBuilder, RenderState->Device);
             }
 
             {
-                vk_pipeline_builder Builder = VkPipelineBuilderBegin(&DemoState->TempArena);
-
-                // NOTE: Shaders
-                VkPipelineShaderAdd(&Builder, "shader_tiled_deferred_gbuffer_vert.spv", "main", VK_SHADER_STAGE_VERTEX_BIT);
-                VkPipelineShaderAdd(&Builder, "shader_tiled_deferred_gbuffer_frag.spv", "main", VK_SHADER_STAGE_FRAGMENT_BIT);
-                
-                // NOTE: Specify input vertex data format
-                VkPipelineVertexBindingBegin(&Builder);
-                VkPipelineVertexAttributeAdd(&Builder, VK_FORMAT_R32G32B32_SFLOAT, sizeof(v3));
-                VkPipelineVertexAttributeAdd(&Builder, VK_FORMAT_R32G32B32_SFLOAT, sizeof(v3));
-                VkPipelineVertexAttributeAdd(&Builder, VK_FORMAT_R32G32_SFLOAT, sizeof(v2));
-                VkPipelineVertexBindingEnd(&Builder);
-
-                VkPipelineInputAssemblyAdd(&Builder, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_FALSE);
-                VkPipelineDepthStateAdd(&Builder, VK_TRUE, VK_TRUE, VK_COMPARE_OP_GREATER);
-
-                VkPipelineColorAttachmentAdd(&Builder, VK_FALSE, VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO,
-                                             VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO);
-                VkPipelineColorAttachmentAdd(&Builder, VK_FALSE, VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO,
-                                             VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO);
-                VkPipelineColorAttachmentAdd(&Builder, VK_FALSE, VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO,
-                                             VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO);
+                pipeline_graphics_desc Desc = PipelineGraphicsDescBegin("shader_tiled_deferred_gbuffer_vert.spv", Result->GBufferRenderPass);
+                PipelineGraphicsVertexAttributeAdd(&Desc, VK_FORMAT_R32G32B32_SFLOAT, sizeof(v3));
+                PipelineGraphicsVertexAttributeAdd(&Desc, VK_FORMAT_R32G32B32_SFLOAT, sizeof(v3));
+                PipelineGraphicsVertexAttributeAdd(&Desc, VK_FORMAT_R32G32_SFLOAT, sizeof(v2));
+                PipelineGraphicsDepthAdd(&Desc, VK_COMPARE_OP_GREATER);
+                PipelineGraphicsPushConstantsAdd(&Desc, VK_SHADER_STAGE_VERTEX_BIT, sizeof(u32));
+                Desc.NumColorAttachments = 3;
 
                 VkDescriptorSetLayout DescriptorLayouts[] =
                     {
@@ -279,9 +1014,54 @@ inline void TiledDeferredCreate(renderer_create_info CreateInfo, VkDescriptorSet
                         CreateInfo.MaterialDescLayout,
                     };
             
-                Result->GBufferPipeline = VkPipelineBuilderEnd(&Builder, RenderState->Device, &RenderState->PipelineManager,
-                                                               Result->GBufferPass.RenderPass, 0, DescriptorLayouts, ArrayCount(DescriptorLayouts));
+                Result->GBufferPipeline = PipelineGraphicsAdd(&DemoState->PipelineCache, Desc, "shader_tiled_deferred_gbuffer_frag.spv",
+                                                              DescriptorLayouts, ArrayCount(DescriptorLayouts));
+            }
+        }
+
+        // NOTE: Compact GBuffer Pass (position comes from depth, normals are octahedral RG16)
+        {
+            // NOTE: Compatible render pass
+            {
+                vk_render_pass_builder RpBuilder = VkRenderPassBuilderBegin(&DemoState->TempArena);
+
+                u32 GBufferNormalId = VkRenderPassAttachmentAdd(&RpBuilder, RenderGraphFormatGet(Graph, Resources->GBufferNormalCompact),
+                                                                VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE,
+                                                                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+                u32 GBufferColorId = VkRenderPassAttachmentAdd(&RpBuilder, RenderGraphFormatGet(Graph, Resources->GBufferMaterial),
+                                                               VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE,
+                                                               VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+                u32 DepthId = VkRenderPassAttachmentAdd(&RpBuilder, RenderGraphFormatGet(Graph, Resources->Depth), VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                                        VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+                VkRenderPassSubPassBegin(&RpBuilder, VK_PIPELINE_BIND_POINT_GRAPHICS);
+                VkRenderPassColorRefAdd(&RpBuilder, GBufferNormalId, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+                VkRenderPassColorRefAdd(&RpBuilder, GBufferColorId, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+                VkRenderPassDepthRefAdd(&RpBuilder, DepthId, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+                VkRenderPassSubPassEnd(&RpBuilder);
+
+                Result->GBufferCompactRenderPass = VkRenderPassBuilderEnd(&RpBuilder, RenderState->Device);
+            }
 
+            {
+                pipeline_graphics_desc Desc = PipelineGraphicsDescBegin("shader_tiled_deferred_gbuffer_vert.spv", Result->GBufferCompactRenderPass);
+                PipelineGraphicsVertexAttributeAdd(&Desc, VK_FORMAT_R32G32B32_SFLOAT, sizeof(v3));
+                PipelineGraphicsVertexAttributeAdd(&Desc, VK_FORMAT_R32G32B32_SFLOAT, sizeof(v3));
+                PipelineGraphicsVertexAttributeAdd(&Desc, VK_FORMAT_R32G32_SFLOAT, sizeof(v2));
+                PipelineGraphicsDepthAdd(&Desc, VK_COMPARE_OP_GREATER);
+                PipelineGraphicsPushConstantsAdd(&Desc, VK_SHADER_STAGE_VERTEX_BIT, sizeof(u32));
+                Desc.NumColorAttachments = 2;
+
+                VkDescriptorSetLayout DescriptorLayouts[] =
+                    {
+                        Result->TiledDeferredDescLayout,
+                        CreateInfo.SceneDescLayout,
+                        CreateInfo.MaterialDescLayout,
+                    };
+            
+                Result->GBufferCompactPipeline = PipelineGraphicsAdd(&DemoState->PipelineCache, Desc, "shader_tiled_deferred_gbuffer_compact_frag.spv",
+                                                                     DescriptorLayouts, ArrayCount(DescriptorLayouts));
             }
         }
         
@@ -293,162 +1073,631 @@ inline void TiledDeferredCreate(renderer_create_info CreateInfo, VkDescriptorSet
                     CreateInfo.SceneDescLayout,
                 };
             
-            Result->LightCullPipeline = VkPipelineComputeCreate(RenderState->Device, &RenderState->PipelineManager, &DemoState->TempArena,
-                                                                "shader_tiled_deferred_light_culling.spv", "main", Layouts, ArrayCount(Layouts));
+            // NOTE: The tiled cullers depend on the tile size, see TiledDeferredTilePipelinesAdd
+            Result->ClusterLightCullPipeline = PipelineComputeAdd(&DemoState->PipelineCache, "shader_tiled_deferred_cluster_light_culling.spv", "main",
+                                                                  Layouts, ArrayCount(Layouts));
         }
 
         // NOTE: Lighting Pass 
         {
-            // NOTE: RT
+            // NOTE: Compatible render pass
             {
-                render_target_builder Builder = RenderTargetBuilderBegin(&DemoState->Arena, &DemoState->TempArena, CreateInfo.Width, CreateInfo.Height);
-                RenderTargetAddTarget(&Builder, &Result->OutColorEntry, VkClearColorCreate(0, 0, 0, 1));
-                RenderTargetAddTarget(&Builder, &Result->DepthEntry, VkClearColorCreate(0, 0, 0, 1));
-                            
                 vk_render_pass_builder RpBuilder = VkRenderPassBuilderBegin(&DemoState->TempArena);
 
-                u32 OutColorId = VkRenderPassAttachmentAdd(&RpBuilder, Result->OutColorEntry.Format, VK_ATTACHMENT_LOAD_OP_CLEAR,
-                                                           VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_UNDEFINED,
-                                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-                u32 DepthId = VkRenderPassAttachmentAdd(&RpBuilder, Result->DepthEntry.Format, VK_ATTACHMENT_LOAD_OP_LOAD,
-                                                        VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
-                                                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
-
-                VkRenderPassDependency(&RpBuilder, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                       VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_DEPENDENCY_BY_REGION_BIT);
+                u32 OutColorId = VkRenderPassAttachmentAdd(&RpBuilder, RenderGraphFormatGet(Graph, Resources->OutColor), VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                                           VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
                 VkRenderPassSubPassBegin(&RpBuilder, VK_PIPELINE_BIND_POINT_GRAPHICS);
                 VkRenderPassColorRefAdd(&RpBuilder, OutColorId, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
                 VkRenderPassSubPassEnd(&RpBuilder);
 
-                Result->LightingPass = RenderTargetBuilderEnd(&Builder, VkRenderPassBuilderEnd(&RpBuilder, RenderState->Device));
+                Result->LightingRenderPass = VkRenderPassBuilderEnd(&RpBuilder, RenderState->Device);
             }
 
+            // NOTE: The default features with and without point lights get built up front
             {
-                vk_pipeline_builder Builder = VkPipelineBuilderBegin(&DemoState->TempArena);
-
-                // NOTE: Shaders
-                VkPipelineShaderAdd(&Builder, "shader_tiled_deferred_lighting_vert.spv", "main", VK_SHADER_STAGE_VERTEX_BIT);
-                VkPipelineShaderAdd(&Builder, "shader_tiled_deferred_lighting_frag.spv", "main", VK_SHADER_STAGE_FRAGMENT_BIT);
-                
-                // NOTE: Specify input vertex data format
-                VkPipelineVertexBindingBegin(&Builder);
-                VkPipelineVertexAttributeAdd(&Builder, VK_FORMAT_R32G32B32_SFLOAT, 2*sizeof(v3) + sizeof(v2));
-                VkPipelineVertexBindingEnd(&Builder);
-
-                VkPipelineInputAssemblyAdd(&Builder, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_FALSE);
-                VkPipelineColorAttachmentAdd(&Builder, VK_FALSE, VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO,
-                                             VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO);
+                Result->ComputeDescLayouts[0] = Result->TiledDeferredDescLayout;
+                Result->ComputeDescLayouts[1] = CreateInfo.SceneDescLayout;
+                Result->ComputeDescLayouts[2] = CreateInfo.MaterialDescLayout;
+                Result->ComputeDescLayouts[3] = Result->CausticsDescLayout;
 
-                VkDescriptorSetLayout DescriptorLayouts[] =
-                    {
-                        Result->TiledDeferredDescLayout,
-                        CreateInfo.SceneDescLayout,
-                        CreateInfo.MaterialDescLayout,
-                        Result->CausticsDescLayout,
-                    };
-            
-                Result->LightingPipeline = VkPipelineBuilderEnd(&Builder, RenderState->Device, &RenderState->PipelineManager,
-                                                                Result->LightingPass.RenderPass, 0, DescriptorLayouts, ArrayCount(DescriptorLayouts));
+                u32 Features = TiledDeferredLightingFeaturesGet(Result, CreateInfo.Scene) & ~LightingFeature_PointLights;
+                TiledDeferredLightingPermutationAdd(Result, Features | LightingFeature_PointLights, Result->TileSize);
+                Result->LightingPermutation = TiledDeferredLightingPermutationAdd(Result, Features, Result->TileSize);
             }
         }
     }
+
+    // NOTE: Grid frustum and tile culling kernels for the starting tile size, the other sizes get added when the tile size changes
+    Result->TilePipelines = TiledDeferredTilePipelinesAdd(Result, Result->TileSize);
+
+    // NOTE: The pipelines compile in parallel (the copy to swap one got added before us), the first frame computes the grid frustums
+    PipelineCacheBuild(&DemoState->PipelineCache, &DemoState->Jobs);
+    TiledDeferredSwapChainChange(Result, CreateInfo.Width, CreateInfo.Height, CreateInfo.Scene);
 }
 
 inline void TiledDeferredAddMeshes(tiled_deferred_state* State, render_mesh* QuadMesh)
 {
     State->QuadMesh = QuadMesh;
-    State->CausticsImage = TextureLoad("frames\\caust_001.png", VK_FORMAT_R8G8B8A8_UNORM, false, sizeof(u8), 4);
+    State->CausticsImage = TextureLoad("frames/caust_001.png", VK_FORMAT_R8G8B8A8_UNORM, false, sizeof(u8), 4);
     VkDescriptorImageWrite(&RenderState->DescriptorManager, State->CausticsDescriptor, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                            State->CausticsImage.View, State->CausticsSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
 
-inline void TiledDeferredRender(vk_commands Commands, tiled_deferred_state* State, render_scene* Scene)
+inline void TiledDeferredTransientsBind(tiled_deferred_state* State, render_graph* Graph)
 {
-    // NOTE: Clear images
+    // NOTE: Only after the graph (re)placed its transients. The frames in flight still read the old images through their own sets
+    if (State->TransientVersion == Graph->TransientVersion)
     {
-        // NOTE: Clear buffers and upload data
-        VkClearValue ClearColor = VkClearColorCreate(0, 0, 0, 0);
-        VkImageSubresourceRange Range = {};
-        Range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        Range.baseMipLevel = 0;
-        Range.levelCount = 1;
-        Range.baseArrayLayer = 0;
-        Range.layerCount = 1;
+        return;
+    }
+    State->TransientVersion = Graph->TransientVersion;
+
+    // NOTE: The output sets get written per frame slot in TiledDeferredDescriptorsSync
+    tiled_deferred_graph_resources* Resources = &State->GraphResources;
+    State->OutColorView = RenderGraphViewGet(Graph, Resources->OutColor);
         
-        vkCmdClearColorImage(Commands.Buffer, State->LightGrid_O.Image, VK_IMAGE_LAYOUT_GENERAL, &ClearColor.color, 1, &Range);
-        vkCmdClearColorImage(Commands.Buffer, State->LightGrid_T.Image, VK_IMAGE_LAYOUT_GENERAL, &ClearColor.color, 1, &Range);
-        vkCmdFillBuffer(Commands.Buffer, State->LightIndexCounter_O, 0, sizeof(u32), 0);
-        vkCmdFillBuffer(Commands.Buffer, State->LightIndexCounter_T, 0, sizeof(u32), 0);
+    // NOTE: GBuffer
+    VkDescriptorImageWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 8, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                           RenderGraphViewGet(Graph, Resources->GBufferPosition), DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    VkDescriptorImageWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 9, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                           RenderGraphViewGet(Graph, Resources->GBufferNormal), DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    VkDescriptorImageWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 10, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                           RenderGraphViewGet(Graph, Resources->GBufferMaterial), DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    VkDescriptorImageWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 11, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                           RenderGraphViewGet(Graph, Resources->Depth), DemoState->PointSampler, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    VkDescriptorImageWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 21, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                           RenderGraphViewGet(Graph, Resources->GBufferNormalCompact), DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // NOTE: Compute lighting output
+    VkDescriptorImageWrite(&RenderState->DescriptorManager, State->SourceDescriptor, 22, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                           RenderGraphViewGet(Graph, Resources->OutColor), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL);
+
+    VkDescriptorManagerFlush(RenderState->Device, &RenderState->DescriptorManager);
+    State->DescriptorVersion += 1;
+}
+
+/*
+
+  NOTE: Points the frame slot's sets at the current resources. The slot's fence passed, so no frame in flight uses them anymore. Has to
+        run after everything that writes the source set this frame (light list sizing, transient binding) and before the passes record.
+
+ */
+inline void TiledDeferredDescriptorsSync(tiled_deferred_state* State, u32 FrameSlot)
+{
+    Assert(FrameSlot < TILED_DEFERRED_MAX_FRAME_DESCRIPTORS);
+    if (State->FrameDescriptorVersions[FrameSlot] != State->DescriptorVersion)
+    {
+        VkDescriptorSet Descriptor = State->FrameDescriptors[FrameSlot];
+        VkDescriptorImageWrite(&RenderState->DescriptorManager, State->OutputRtSets[FrameSlot], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                               State->OutColorView, DemoState->LinearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        VkDescriptorManagerFlush(RenderState->Device, &RenderState->DescriptorManager);
+
+        VkCopyDescriptorSet Copies[TILED_DEFERRED_NUM_BINDINGS] = {};
+        for (u32 Binding = 0; Binding < TILED_DEFERRED_NUM_BINDINGS; ++Binding)
+        {
+            Copies[Binding].sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+            Copies[Binding].srcSet = State->SourceDescriptor;
+            Copies[Binding].srcBinding = Binding;
+            Copies[Binding].dstSet = Descriptor;
+            Copies[Binding].dstBinding = Binding;
+            Copies[Binding].descriptorCount = 1;
+        }
+        vkUpdateDescriptorSets(RenderState->Device, 0, 0, ArrayCount(Copies), Copies);
+        State->FrameDescriptorVersions[FrameSlot] = State->DescriptorVersion;
     }
+    State->TiledDeferredDescriptor = State->FrameDescriptors[FrameSlot];
+}
+
+//
+// NOTE: Frame Passes
+//
+
+inline b32 TiledDeferredClassifiedLighting(tiled_deferred_state* State)
+{
+    // NOTE: Classification is written by the tiled cullers, clustered culling falls back to lighting every tile
+    b32 Result = (State->LightingMode == LightingMode_ComputeClassified && State->LightCullMode != LightCullMode_Clustered);
+    return Result;
+}
+
+inline void TiledDeferredDescriptorsBind(VkCommandBuffer CmdBuffer, VkPipelineBindPoint BindPoint, VkPipelineLayout Layout,
+                                         tiled_deferred_state* State, render_scene* Scene)
+{
+    // NOTE: Binds sets 0 and 1, the dynamic offsets point both at this frame's data in the upload ring
+    VkDescriptorSet DescriptorSets[] =
+        {
+            State->TiledDeferredDescriptor,
+            Scene->SceneDescriptor,
+        };
+
+    u32 DynamicOffsets[1 + SceneDynamic_Count];
+    DynamicOffsets[0] = State->GlobalsOffset;
+    for (u32 BindingId = 0; BindingId < SceneDynamic_Count; ++BindingId)
+    {
+        DynamicOffsets[1 + BindingId] = Scene->DynamicOffsets[BindingId];
+    }
+    
+    vkCmdBindDescriptorSets(CmdBuffer, BindPoint, Layout, 0, ArrayCount(DescriptorSets), DescriptorSets, ArrayCount(DynamicOffsets), DynamicOffsets);
+}
+
+inline void TiledDeferredCausticsBind(VkCommandBuffer CmdBuffer, VkPipelineBindPoint BindPoint, VkPipelineLayout Layout, tiled_deferred_state* State)
+{
+    vkCmdBindDescriptorSets(CmdBuffer, BindPoint, Layout, 3, 1, &State->CausticsDescriptor, 1, &State->CausticsInputOffset);
+}
+
+RENDER_GRAPH_PASS_CALLBACK(TiledDeferredInstanceCullingPass)
+{
+    tiled_deferred_state* State = (tiled_deferred_state*)Data;
+    render_scene* Scene = State->Scene;
+    
+    if (Scene->NumOpaqueInstances > 0)
+    {
+        vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, State->InstanceCullPipeline->Handle);
+        TiledDeferredDescriptorsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, State->InstanceCullPipeline->Layout, State, Scene);
+        u32 DispatchX = CeilU32(f32(Scene->NumOpaqueInstances) / 64.0f);
+        vkCmdDispatch(Commands.Buffer, DispatchX, 1, 1);
+    }
+}
+
+RENDER_GRAPH_PASS_CALLBACK(TiledDeferredDrawCompactionPass)
+{
+    tiled_deferred_state* State = (tiled_deferred_state*)Data;
+    render_scene* Scene = State->Scene;
     
-    // NOTE: GBuffer Pass
-    RenderTargetPassBegin(&State->GBufferPass, Commands, RenderTargetRenderPass_SetViewPort | RenderTargetRenderPass_SetScissor);
+    if (Scene->NumDrawGroups > 0)
     {
-        for (u32 InstanceId = 0; InstanceId < Scene->NumOpaqueInstances; ++InstanceId)
+        vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, State->DrawCompactionPipeline->Handle);
+        TiledDeferredDescriptorsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, State->DrawCompactionPipeline->Layout, State, Scene);
+        u32 DispatchX = CeilU32(f32(Scene->NumRenderMeshes) / 64.0f);
+        vkCmdDispatch(Commands.Buffer, DispatchX, 1, 1);
+    }
+}
+
+inline void TiledDeferredGBufferRecord(VkCommandBuffer CmdBuffer, tiled_deferred_state* State, render_scene* Scene, u32 FirstGroup,
+                                       u32 OnePastLastGroup)
+{
+    vk_pipeline* Pipeline = State->GBufferLayout == GBufferLayout_Compact ? State->GBufferCompactPipeline : State->GBufferPipeline;
+    vkCmdBindPipeline(CmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Handle);
+    TiledDeferredDescriptorsBind(CmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Layout, State, Scene);
+    if (State->MultiDrawIndirect)
+    {
+        u32 InstanceBase = 0;
+        vkCmdPushConstants(CmdBuffer, Pipeline->Layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(u32), &InstanceBase);
+    }
+
+    // NOTE: One indirect count draw per draw group, we only rebind the per group state when it actually changes. The compaction pass
+    // packed the commands of the visible meshes to the front of the groups range and wrote how many there are. Without indirect count
+    // draws every batch draws its uncompacted command, a mesh without visible instances is an empty draw
+    VkDescriptorSet BoundMaterial = VK_NULL_HANDLE;
+    VkBuffer BoundVertexBuffer = VK_NULL_HANDLE;
+    VkBuffer BoundIndexBuffer = VK_NULL_HANDLE;
+    for (u32 GroupId = FirstGroup; GroupId < OnePastLastGroup; ++GroupId)
+    {
+        draw_group* CurrGroup = Scene->DrawGroups + GroupId;
+        render_mesh* CurrMesh = Scene->RenderMeshes + Scene->OpaqueBatches[CurrGroup->FirstBatch].MeshId;
+
+        if (CurrMesh->MaterialDescriptor != BoundMaterial)
         {
-            instance_entry* CurrInstance = Scene->OpaqueInstances + InstanceId;
-            render_mesh* CurrMesh = Scene->RenderMeshes + CurrInstance->MeshId;
+            vkCmdBindDescriptorSets(CmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Layout, 2,
+                                    1, &CurrMesh->MaterialDescriptor, 0, 0);
+            BoundMaterial = CurrMesh->MaterialDescriptor;
+        }
 
-            vk_pipeline* Pipeline = State->GBufferPipeline;
-            
-            vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Handle);
-            VkDescriptorSet DescriptorSets[] =
-                {
-                    State->TiledDeferredDescriptor,
-                    Scene->SceneDescriptor,
-                    CurrMesh->MaterialDescriptor,
-                };
-            vkCmdBindDescriptorSets(Commands.Buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Layout, 0,
-                                    ArrayCount(DescriptorSets), DescriptorSets, 0, 0);
-            
+        if (CurrMesh->VertexBuffer != BoundVertexBuffer)
+        {
             VkDeviceSize Offset = 0;
-            vkCmdBindVertexBuffers(Commands.Buffer, 0, 1, &CurrMesh->VertexBuffer, &Offset);
-            vkCmdBindIndexBuffer(Commands.Buffer, CurrMesh->IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-            vkCmdDrawIndexed(Commands.Buffer, CurrMesh->NumIndices, 1, 0, 0, InstanceId);
+            vkCmdBindVertexBuffers(CmdBuffer, 0, 1, &CurrMesh->VertexBuffer, &Offset);
+            BoundVertexBuffer = CurrMesh->VertexBuffer;
+        }
+
+        if (CurrMesh->IndexBuffer != BoundIndexBuffer)
+        {
+            vkCmdBindIndexBuffer(CmdBuffer, CurrMesh->IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            BoundIndexBuffer = CurrMesh->IndexBuffer;
+        }
+            
+        if (State->MultiDrawIndirect)
+        {
+            VkDeviceSize CommandOffset = sizeof(gpu_draw_command) * (SCENE_MAX_RENDER_MESHES + CurrGroup->FirstBatch);
+            State->DrawIndexedIndirectCount(CmdBuffer, State->DrawCommands, CommandOffset, State->DrawCounts, sizeof(u32) * GroupId,
+                                            CurrGroup->NumBatches, sizeof(gpu_draw_command));
+        }
+        else
+        {
+            for (u32 BatchId = CurrGroup->FirstBatch; BatchId < CurrGroup->FirstBatch + CurrGroup->NumBatches; ++BatchId)
+            {
+                instance_batch* CurrBatch = Scene->OpaqueBatches + BatchId;
+                vkCmdPushConstants(CmdBuffer, Pipeline->Layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(u32), &CurrBatch->FirstInstance);
+                vkCmdDrawIndexedIndirect(CmdBuffer, State->DrawCommands, sizeof(gpu_draw_command) * CurrBatch->MeshId, 1,
+                                         sizeof(gpu_draw_command));
+            }
         }
     }
-    RenderTargetPassEnd(Commands);
+}
+
+JOB_CALLBACK(TiledDeferredGBufferJob)
+{
+    tiled_deferred_gbuffer_job* Job = (tiled_deferred_gbuffer_job*)Data;
+    tiled_deferred_state* State = Job->State;
     
-    // NOTE: Light Culling Pass
+    RenderGraphSecondaryBegin(State->Graph, Job->CmdBuffer);
+    TiledDeferredGBufferRecord(Job->CmdBuffer, State, State->Scene, Job->FirstGroup, Job->OnePastLastGroup);
+    VkCheckResult(vkEndCommandBuffer(Job->CmdBuffer));
+}
+
+RENDER_GRAPH_PASS_CALLBACK(TiledDeferredGBufferPass)
+{
+    tiled_deferred_state* State = (tiled_deferred_state*)Data;
+    render_scene* Scene = State->Scene;
+
+    if (State->NumGBufferJobs > 0)
     {
-        vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, State->LightCullPipeline->Handle);
-        VkDescriptorSet DescriptorSets[] =
-            {
-                State->TiledDeferredDescriptor,
-                Scene->SceneDescriptor,
-            };
-        vkCmdBindDescriptorSets(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, State->LightCullPipeline->Layout, 0,
-                                ArrayCount(DescriptorSets), DescriptorSets, 0, 0);
-        u32 DispatchX = CeilU32(f32(RenderState->WindowWidth) / f32(TILE_SIZE_IN_PIXELS));
-        u32 DispatchY = CeilU32(f32(RenderState->WindowHeight) / f32(TILE_SIZE_IN_PIXELS));
-        vkCmdDispatch(Commands.Buffer, DispatchX, DispatchY, 1);
+        // NOTE: Every job records a contiguous range of draw groups into the secondary of its own pool, the primary only executes them
+        u32 NumJobs = State->NumGBufferJobs;
+        u32 GroupsPerJob = CeilU32(f32(Scene->NumDrawGroups) / f32(NumJobs));
+        job_counter Counter = {};
+        for (u32 JobId = 0; JobId < NumJobs; ++JobId)
+        {
+            tiled_deferred_gbuffer_job* Job = State->GBufferJobs + JobId;
+            Job->State = State;
+            Job->CmdBuffer = State->WorkerCommands->Buffers[JobId];
+            Job->FirstGroup = Min(JobId * GroupsPerJob, Scene->NumDrawGroups);
+            Job->OnePastLastGroup = Min(Job->FirstGroup + GroupsPerJob, Scene->NumDrawGroups);
+            JobSystemPush(State->Jobs, 0, TiledDeferredGBufferJob, Job, &Counter);
+        }
+        JobSystemWait(State->Jobs, 0, &Counter);
+
+        vkCmdExecuteCommands(Commands.Buffer, NumJobs, State->WorkerCommands->Buffers);
+    }
+    else
+    {
+        TiledDeferredGBufferRecord(Commands.Buffer, State, Scene, 0, Scene->NumDrawGroups);
+    }
+}
+
+RENDER_GRAPH_PASS_CALLBACK(TiledDeferredGridFrustumPass)
+{
+    // NOTE: Only runs on the first frame after the tile grid got recreated
+    tiled_deferred_state* State = (tiled_deferred_state*)Data;
+    vk_pipeline* Pipeline = State->TilePipelines->GridFrustum;
+    vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Handle);
+    vkCmdBindDescriptorSets(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Layout, 0, 1, &State->TiledDeferredDescriptor, 1,
+                            &State->GlobalsOffset);
+    u32 DispatchX = CeilU32(f32(RenderState->WindowWidth) / f32(8 * State->TileSize));
+    u32 DispatchY = CeilU32(f32(RenderState->WindowHeight) / f32(8 * State->TileSize));
+    vkCmdDispatch(Commands.Buffer, DispatchX, DispatchY, 1);
+}
+
+RENDER_GRAPH_PASS_CALLBACK(TiledDeferredLightCullingPass)
+{
+    tiled_deferred_state* State = (tiled_deferred_state*)Data;
+    render_scene* Scene = State->Scene;
+        
+    switch (State->LightCullMode)
+    {
+        case LightCullMode_Tiled:
+        {
+            tile_pipelines* TilePipelines = State->TilePipelines;
+            vk_pipeline* Pipeline = TilePipelines->LightCullSubgroup ? TilePipelines->LightCullSubgroup : TilePipelines->LightCull;
+            vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Handle);
+            TiledDeferredDescriptorsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Layout, State, Scene);
+            u32 DispatchX = CeilU32(f32(RenderState->WindowWidth) / f32(State->TileSize));
+            u32 DispatchY = CeilU32(f32(RenderState->WindowHeight) / f32(State->TileSize));
+            vkCmdDispatch(Commands.Buffer, DispatchX, DispatchY, 1);
+        } break;
+
+        case LightCullMode_TiledBitmask:
+        {
+            vk_pipeline* Pipeline = State->TilePipelines->LightCullBitmask;
+            vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Handle);
+            TiledDeferredDescriptorsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Layout, State, Scene);
+            u32 DispatchX = CeilU32(f32(RenderState->WindowWidth) / f32(State->TileSize));
+            u32 DispatchY = CeilU32(f32(RenderState->WindowHeight) / f32(State->TileSize));
+            vkCmdDispatch(Commands.Buffer, DispatchX, DispatchY, 1);
+        } break;
+
+        case LightCullMode_Clustered:
+        {
+            // NOTE: One work group per cluster
+            vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, State->ClusterLightCullPipeline->Handle);
+            TiledDeferredDescriptorsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, State->ClusterLightCullPipeline->Layout, State, Scene);
+            u32 DispatchX = CeilU32(f32(RenderState->WindowWidth) / f32(CLUSTER_TILE_SIZE_IN_PIXELS));
+            u32 DispatchY = CeilU32(f32(RenderState->WindowHeight) / f32(CLUSTER_TILE_SIZE_IN_PIXELS));
+            vkCmdDispatch(Commands.Buffer, DispatchX, DispatchY, CLUSTER_NUM_SLICES);
+        } break;
+
+        default:
+        {
+            InvalidCodePath;
+        } break;
     }
+}
+
+RENDER_GRAPH_PASS_CALLBACK(TiledDeferredLightListReadbackPass)
+{
+    tiled_deferred_state* State = (tiled_deferred_state*)Data;
+
+    // NOTE: Copy the counters into this frame's readback slot for the list sizing
+    VkDeviceSize SlotOffset = sizeof(light_list_readback) * State->LightListSlot;
+    VkBufferCopy Region = {};
+    Region.srcOffset = sizeof(u32) * State->LightCounterParity;
+    Region.size = sizeof(u32);
+    Region.dstOffset = SlotOffset + offsetof(light_list_readback, Counter_O);
+    vkCmdCopyBuffer(Commands.Buffer, State->LightIndexCounter_O, State->LightListReadbackBuffer, 1, &Region);
+    Region.dstOffset = SlotOffset + offsetof(light_list_readback, Counter_T);
+    vkCmdCopyBuffer(Commands.Buffer, State->LightIndexCounter_T, State->LightListReadbackBuffer, 1, &Region);
+    Region.srcOffset = 2 * sizeof(u32) * State->LightCounterParity;
+    Region.size = 2 * sizeof(u32);
+    Region.dstOffset = SlotOffset + offsetof(light_list_readback, NumTileOverflows);
+    vkCmdCopyBuffer(Commands.Buffer, State->LightListOverflow, State->LightListReadbackBuffer, 1, &Region);
+
+    // NOTE: The graph only orders GPU work, the host read after the fence still needs its own barrier
+    VkMemoryBarrier Barrier = {};
+    Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(Commands.Buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &Barrier, 0, 0, 0, 0);
+}
+
+RENDER_GRAPH_PASS_CALLBACK(TiledDeferredLightingClearPass)
+{
+    tiled_deferred_state* State = (tiled_deferred_state*)Data;
+
+    // NOTE: Sky tiles are in no bucket, they only pay for the clear
+    VkClearColorValue ClearColor = {};
+    ClearColor.float32[3] = 1.0f;
+    VkImageSubresourceRange Range = {};
+    Range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    Range.levelCount = 1;
+    Range.layerCount = 1;
+    vkCmdClearColorImage(Commands.Buffer, RenderGraphImageGet(&DemoState->RenderGraph, State->GraphResources.OutColor), VK_IMAGE_LAYOUT_GENERAL,
+                         &ClearColor, 1, &Range);
+}
 
-    vkCmdPipelineBarrier(Commands.Buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                         VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 0, 0);
+RENDER_GRAPH_PASS_CALLBACK(TiledDeferredLightingPass)
+{
+    tiled_deferred_state* State = (tiled_deferred_state*)Data;
+    render_scene* Scene = State->Scene;
     
-    // NOTE: Lighting Pass
-    RenderTargetPassBegin(&State->LightingPass, Commands, RenderTargetRenderPass_SetViewPort | RenderTargetRenderPass_SetScissor);
+    if (TiledDeferredClassifiedLighting(State))
     {
-        vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, State->LightingPipeline->Handle);
+        for (u32 BucketId = 0; BucketId < TileBucket_Count; ++BucketId)
         {
-            VkDescriptorSet DescriptorSets[] =
-                {
-                    State->TiledDeferredDescriptor,
-                    Scene->SceneDescriptor,
-                };
-            vkCmdBindDescriptorSets(Commands.Buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, State->LightingPipeline->Layout, 0,
-                                    ArrayCount(DescriptorSets), DescriptorSets, 0, 0);
-            vkCmdBindDescriptorSets(Commands.Buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, State->LightingPipeline->Layout, 3,
-                                    1, &State->CausticsDescriptor, 0, 0);
+            vk_pipeline* Pipeline = State->LightingPermutation->Bucket[State->GBufferLayout][BucketId];
+            vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Handle);
+            TiledDeferredDescriptorsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Layout, State, Scene);
+            TiledDeferredCausticsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Layout, State);
+            VkDeviceSize BucketOffset = sizeof(gpu_tile_bucket) * (TileBucket_Count * State->LightCounterParity + BucketId);
+            vkCmdDispatchIndirect(Commands.Buffer, State->TileBuckets, BucketOffset);
         }
+    }
+    else if (State->LightingMode == LightingMode_Compute || State->LightingMode == LightingMode_ComputeClassified)
+    {
+        vk_pipeline* Pipeline = State->LightingPermutation->Compute[State->GBufferLayout];
+        vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Handle);
+        TiledDeferredDescriptorsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Layout, State, Scene);
+        TiledDeferredCausticsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline->Layout, State);
+
+        u32 DispatchX = CeilU32(f32(RenderState->WindowWidth) / f32(State->TileSize));
+        u32 DispatchY = CeilU32(f32(RenderState->WindowHeight) / f32(State->TileSize));
+        vkCmdDispatch(Commands.Buffer, DispatchX, DispatchY, 1);
+    }
+    else
+    {
+        vk_pipeline* Pipeline = State->LightingPermutation->Fragment[State->GBufferLayout];
+        vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Handle);
+        TiledDeferredDescriptorsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Layout, State, Scene);
+        TiledDeferredCausticsBind(Commands.Buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Layout, State);
 
         VkDeviceSize Offset = 0;
         vkCmdBindVertexBuffers(Commands.Buffer, 0, 1, &State->QuadMesh->VertexBuffer, &Offset);
         vkCmdBindIndexBuffer(Commands.Buffer, State->QuadMesh->IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
         vkCmdDrawIndexed(Commands.Buffer, State->QuadMesh->NumIndices, 1, 0, 0, 0);
     }
+}
+
+/*
 
-    RenderTargetPassEnd(Commands);
+  NOTE: Adds the tiled deferred passes to the frame graph, after the upload pass. Every pass lists what it touches so the graph can
+        place the barriers, nothing in the callbacks syncs by hand (other than the host readback). Data the host writes into the
+        upload ring isn't declared, the submit makes it visible
+  
+ */
+inline void TiledDeferredGraphBuild(render_graph* Graph, tiled_deferred_state* State, render_scene* Scene)
+{
+    tiled_deferred_graph_resources* Resources = &State->GraphResources;
+    scene_graph_resources* SceneResources = &Scene->GraphResources;
+    VkAccessFlags ReadWrite = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    b32 CompactGBuffer = State->GBufferLayout == GBufferLayout_Compact;
+    b32 ComputeLighting = State->LightingMode == LightingMode_Compute || State->LightingMode == LightingMode_ComputeClassified;
+    b32 ClassifiedLighting = TiledDeferredClassifiedLighting(State);
+    VkPipelineStageFlags LightingStage = ComputeLighting ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    
+    // NOTE: These get reallocated on resize and by the light list sizing, new light grids start out undefined
+    RenderGraphBufferSet(Graph, Resources->GridFrustums, State->GridFrustums.Buffer);
+    RenderGraphImageSet(Graph, Resources->LightGrid_O, State->LightGrid_O.Image, VK_IMAGE_LAYOUT_UNDEFINED);
+    RenderGraphImageSet(Graph, Resources->LightGrid_T, State->LightGrid_T.Image, VK_IMAGE_LAYOUT_UNDEFINED);
+    RenderGraphBufferSet(Graph, Resources->LightIndexList_O, State->LightIndexList_O.Buffer);
+    RenderGraphBufferSet(Graph, Resources->LightIndexList_T, State->LightIndexList_T.Buffer);
+    RenderGraphBufferSet(Graph, Resources->ClusterLightGrid, State->ClusterLightGrid.Buffer);
+    RenderGraphBufferSet(Graph, Resources->ClusterLightIndexList, State->ClusterLightIndexList.Buffer);
+    RenderGraphBufferSet(Graph, Resources->LightMask_O, State->LightMask_O.Buffer);
+    RenderGraphBufferSet(Graph, Resources->LightMask_T, State->LightMask_T.Buffer);
+    RenderGraphBufferSet(Graph, Resources->TileBucketLists, State->TileBucketLists.Buffer);
+
+    // NOTE: Light culling outputs for the active mode, the lighting pass reads the same set
+    u32 NumCullBuffers = 0;
+    u32 CullBuffers[8];
+    b32 CullWritesGrids = State->LightCullMode != LightCullMode_Clustered;
+    switch (State->LightCullMode)
+    {
+        case LightCullMode_Tiled:
+        {
+            CullBuffers[NumCullBuffers++] = Resources->LightIndexList_O;
+            CullBuffers[NumCullBuffers++] = Resources->LightIndexList_T;
+            CullBuffers[NumCullBuffers++] = Resources->TileBucketLists;
+        } break;
+
+        case LightCullMode_TiledBitmask:
+        {
+            CullBuffers[NumCullBuffers++] = Resources->LightMask_O;
+            CullBuffers[NumCullBuffers++] = Resources->LightMask_T;
+            CullBuffers[NumCullBuffers++] = Resources->TileBucketLists;
+        } break;
+
+        case LightCullMode_Clustered:
+        {
+            CullBuffers[NumCullBuffers++] = Resources->ClusterLightGrid;
+            CullBuffers[NumCullBuffers++] = Resources->ClusterLightIndexList;
+        } break;
+
+        default:
+        {
+            InvalidCodePath;
+        } break;
+    }
+    
+    // NOTE: Instance Culling Pass (writes the WVP transforms into the instance buffer)
+    RenderGraphPassAdd(Graph, "InstanceCulling", TiledDeferredInstanceCullingPass, State);
+    RenderGraphBufferWrite(Graph, SceneResources->OpaqueInstances, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite);
+    RenderGraphBufferWrite(Graph, Resources->DrawCommands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite);
+    RenderGraphBufferWrite(Graph, Resources->VisibleInstanceIds, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+    // NOTE: Draw Compaction Pass (packs the visible meshes of every draw group and counts them), only the indirect count draws use it
+    if (State->MultiDrawIndirect)
+    {
+        RenderGraphPassAdd(Graph, "DrawCompaction", TiledDeferredDrawCompactionPass, State);
+        RenderGraphBufferWrite(Graph, Resources->DrawCommands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite);
+        RenderGraphBufferWrite(Graph, Resources->DrawCounts, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite);
+    }
+
+    // NOTE: GBuffer Pass, recorded in parallel once there are enough draw groups to go around
+    RenderGraphPassAdd(Graph, "GBuffer", TiledDeferredGBufferPass, State);
+    State->Graph = Graph;
+    State->NumGBufferJobs = 0;
+    if (State->Jobs && State->WorkerCommands)
+    {
+        u32 NumJobs = Min(State->WorkerCommands->NumPools, Scene->NumDrawGroups / GBUFFER_MIN_DRAW_GROUPS_PER_JOB);
+        if (NumJobs > 1)
+        {
+            State->NumGBufferJobs = NumJobs;
+            RenderGraphPassSecondaryContents(Graph);
+        }
+    }
+    if (CompactGBuffer)
+    {
+        RenderGraphColorAttachment(Graph, Resources->GBufferNormalCompact, VkClearColorCreate(0, 0, 0, 1));
+    }
+    else
+    {
+        RenderGraphColorAttachment(Graph, Resources->GBufferPosition, VkClearColorCreate(0, 0, 0, 1));
+        RenderGraphColorAttachment(Graph, Resources->GBufferNormal, VkClearColorCreate(0, 0, 0, 1));
+    }
+    RenderGraphColorAttachment(Graph, Resources->GBufferMaterial, VkClearColorCreate(0xFFFFFFFF, 0, 0, 0));
+    RenderGraphDepthAttachment(Graph, Resources->Depth, VkClearDepthStencilCreate(0, 0));
+    RenderGraphBufferRead(Graph, Resources->DrawCommands, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    if (State->MultiDrawIndirect)
+    {
+        RenderGraphBufferRead(Graph, Resources->DrawCounts, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    }
+    RenderGraphBufferRead(Graph, Resources->VisibleInstanceIds, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    RenderGraphBufferRead(Graph, SceneResources->OpaqueInstances, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                          VK_ACCESS_SHADER_READ_BIT);
+
+    // NOTE: Grid Frustum Pass, after a resize or tile size change
+    if (State->GridFrustumsDirty)
+    {
+        RenderGraphPassAdd(Graph, "GridFrustums", TiledDeferredGridFrustumPass, State);
+        RenderGraphBufferWrite(Graph, Resources->GridFrustums, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+        State->GridFrustumsDirty = false;
+    }
+
+    // NOTE: Light Culling Pass. Every culler resets all of the counters for the next frame (see LightCounterParity)
+    RenderGraphPassAdd(Graph, "LightCulling", TiledDeferredLightCullingPass, State);
+    RenderGraphBufferRead(Graph, SceneResources->PointLights, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    RenderGraphBufferRead(Graph, Resources->GridFrustums, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    RenderGraphImageRead(Graph, Resources->Depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    RenderGraphBufferWrite(Graph, Resources->LightIndexCounter_O, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite);
+    RenderGraphBufferWrite(Graph, Resources->LightIndexCounter_T, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite);
+    RenderGraphBufferWrite(Graph, Resources->ClusterLightIndexCounter, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite);
+    RenderGraphBufferWrite(Graph, Resources->LightListOverflow, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite);
+    RenderGraphBufferWrite(Graph, Resources->TileBuckets, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite);
+    for (u32 CullBufferId = 0; CullBufferId < NumCullBuffers; ++CullBufferId)
+    {
+        RenderGraphBufferWrite(Graph, CullBuffers[CullBufferId], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite);
+    }
+    if (CullWritesGrids)
+    {
+        RenderGraphImageWrite(Graph, Resources->LightGrid_O, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite, VK_IMAGE_LAYOUT_GENERAL);
+        RenderGraphImageWrite(Graph, Resources->LightGrid_T, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, ReadWrite, VK_IMAGE_LAYOUT_GENERAL);
+    }
+
+    // NOTE: Light List Readback Pass
+    RenderGraphPassAdd(Graph, "LightListReadback", TiledDeferredLightListReadbackPass, State);
+    RenderGraphBufferRead(Graph, Resources->LightIndexCounter_O, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    RenderGraphBufferRead(Graph, Resources->LightIndexCounter_T, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    RenderGraphBufferRead(Graph, Resources->LightListOverflow, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    RenderGraphTransferWrite(Graph, Resources->LightListReadback);
+
+    // NOTE: Lighting Pass
+    if (ClassifiedLighting)
+    {
+        RenderGraphPassAdd(Graph, "LightingClear", TiledDeferredLightingClearPass, State);
+        RenderGraphImageWrite(Graph, Resources->OutColor, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true);
+    }
+    
+    RenderGraphPassAdd(Graph, "Lighting", TiledDeferredLightingPass, State);
+    if (ComputeLighting)
+    {
+        // NOTE: The classified kernels only write the lit tiles, the rest keeps the clear
+        RenderGraphImageWrite(Graph, Resources->OutColor, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+                              !ClassifiedLighting);
+    }
+    else
+    {
+        RenderGraphColorAttachment(Graph, Resources->OutColor);
+    }
+    if (ClassifiedLighting)
+    {
+        RenderGraphBufferRead(Graph, Resources->TileBuckets, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+    }
+    
+    RenderGraphBufferRead(Graph, SceneResources->OpaqueInstances, LightingStage, VK_ACCESS_SHADER_READ_BIT);
+    RenderGraphBufferRead(Graph, SceneResources->PointLights, LightingStage, VK_ACCESS_SHADER_READ_BIT);
+    for (u32 CullBufferId = 0; CullBufferId < NumCullBuffers; ++CullBufferId)
+    {
+        RenderGraphBufferRead(Graph, CullBuffers[CullBufferId], LightingStage, VK_ACCESS_SHADER_READ_BIT);
+    }
+    if (CullWritesGrids)
+    {
+        RenderGraphImageRead(Graph, Resources->LightGrid_O, LightingStage, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+        RenderGraphImageRead(Graph, Resources->LightGrid_T, LightingStage, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+    }
+
+    u32 GBufferImages[3];
+    u32 NumGBufferImages = 0;
+    if (CompactGBuffer)
+    {
+        GBufferImages[NumGBufferImages++] = Resources->GBufferNormalCompact;
+    }
+    else
+    {
+        GBufferImages[NumGBufferImages++] = Resources->GBufferPosition;
+        GBufferImages[NumGBufferImages++] = Resources->GBufferNormal;
+    }
+    GBufferImages[NumGBufferImages++] = Resources->GBufferMaterial;
+    for (u32 ImageId = 0; ImageId < NumGBufferImages; ++ImageId)
+    {
+        RenderGraphImageRead(Graph, GBufferImages[ImageId], LightingStage, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+    RenderGraphImageRead(Graph, Resources->Depth, LightingStage, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+}
+
+inline void TiledDeferredFrameEnd(tiled_deferred_state* State)
+{
+    // NOTE: Called once the frame's passes are recorded, the callbacks read the parity when they record
+    State->LightCounterParity ^= 1;
 }
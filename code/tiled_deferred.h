@@ -1,8 +1,109 @@
 #pragma once
 
+// NOTE: Default tile size. The tile size is a runtime setting (TiledDeferredTileSizeSet), the tile kernels get it as a specialization
+// constant. Bigger tiles mean a smaller grid and cheaper culling dispatches, but more lights per tile that only touch a few pixels
 #define TILE_SIZE_IN_PIXELS 8
+#define TILE_SIZE_NUM_CANDIDATES 3 // NOTE: 8, 16 and 32
+// NOTE: The auto tuner skips the frames whose timings are still in flight in the profiler after a switch, then averages the rest
+#define TILE_TUNE_WARMUP_FRAMES (GPU_PROFILER_FRAME_LATENCY + 4)
+#define TILE_TUNE_MEASURE_FRAMES 32
 #define MAX_LIGHTS_PER_TILE 1024
 
+// NOTE: The light index lists are sized from the counters we read back a few frames late. They grow as soon as they get close to
+// full and only shrink after the usage stayed well below the capacity for a while
+#define LIGHT_LIST_READBACK_LATENCY 4
+#define LIGHT_LIST_SHRINK_FRAMES 120
+#define LIGHT_LIST_MIN_CAPACITY (64*1024)
+// NOTE: Per list cap on the light masks, 64k lights at 1080p with 8px tiles would need 265MB each
+#define LIGHT_MASK_MAX_BYTES MegaBytes(32)
+
+// NOTE: Resizes and light list sizing don't wait for the GPU. Replaced buffers and images get destroyed RETIRE_FRAMES frames later, the
+// descriptor set gets written through a source set that is copied into a frame's own set once that frame's slot is free again
+#define TILED_DEFERRED_RETIRE_FRAMES 4
+#define TILED_DEFERRED_MAX_RETIRED 128
+#define TILED_DEFERRED_MAX_FRAME_DESCRIPTORS 3
+#define TILED_DEFERRED_NUM_BINDINGS 25
+
+// NOTE: Clustered culling slices bigger screen tiles along view depth (exponentially between near and far)
+#define CLUSTER_TILE_SIZE_IN_PIXELS 64
+#define CLUSTER_NUM_SLICES 32
+#define MAX_LIGHTS_PER_CLUSTER 256
+
+// NOTE: The GBuffer draws only get split across workers when every job gets at least this many draw groups
+#define GBUFFER_MIN_DRAW_GROUPS_PER_JOB 32
+
+// NOTE: The compact layout drops the position target (reconstructed from depth) and stores octahedral normals in RG16
+enum gbuffer_layout
+{
+    GBufferLayout_Full,
+    GBufferLayout_Compact,
+
+    GBufferLayout_Count,
+};
+
+// NOTE: Compute lighting runs one work group per light tile and writes OutColor as a storage image. The classified variant only
+// dispatches the tiles the light culler put in each bucket, with a specialized kernel per bucket (sky tiles just get cleared)
+enum lighting_mode
+{
+    LightingMode_Fragment,
+    LightingMode_Compute,
+    LightingMode_ComputeClassified,
+};
+
+/*
+
+  NOTE: The tile kernels and the lighting kernels are specialized at pipeline creation (ids match the constant_ids in
+        tiled_deferred_shaders.cpp). Lighting permutations get created the first time a feature combination is used and stay around,
+        so a scene without point lights runs a kernel without the light loop and toggling a feature only compiles once.
+
+ */
+enum tiled_deferred_spec_constant
+{
+    TiledDeferredSpec_TileDim,
+    TiledDeferredSpec_GroupSizeX,
+    TiledDeferredSpec_GroupSizeY,
+    TiledDeferredSpec_PointLights,
+    TiledDeferredSpec_Specular,
+    TiledDeferredSpec_Rim,
+    TiledDeferredSpec_Caustics,
+
+    TiledDeferredSpec_Count,
+};
+
+enum lighting_feature
+{
+    LightingFeature_PointLights = 1 << 0,
+    LightingFeature_Specular = 1 << 1,
+    LightingFeature_Rim = 1 << 2,
+    LightingFeature_Caustics = 1 << 3,
+};
+
+#define LIGHTING_MAX_PERMUTATIONS 24
+
+enum tile_bucket_type
+{
+    TileBucket_Directional,
+    TileBucket_PointLit,
+
+    TileBucket_Count,
+};
+
+// NOTE: VkDispatchIndirectCommand followed by the real tile count (the dispatch is capped at 65535 groups, groups loop over the rest)
+struct gpu_tile_bucket
+{
+    u32 DispatchX;
+    u32 DispatchY;
+    u32 DispatchZ;
+    u32 NumTiles;
+};
+
+enum light_cull_mode
+{
+    LightCullMode_Tiled,
+    LightCullMode_Clustered,
+    LightCullMode_TiledBitmask,
+};
+
 struct gpu_caustics_input_buffer
 {
     f32 Time;
@@ -12,50 +113,267 @@ struct tiled_deferred_globals
 {
     // TODO: Move to camera?
     m4 InverseProjection;
+    m4 ViewProjection;
+    m4 InverseViewProjection;
+    m4 ViewTransform; // NOTE: Scene lights are in world space, the light cullers work in view space
     v2 ScreenSize;
     u32 GridSizeX;
     u32 GridSizeY;
+    u32 NumOpaqueInstances;
+    u32 LightCullMode;
+    u32 ClusterGridSizeX;
+    u32 ClusterGridSizeY;
+    u32 NumLightMaskWords;
+    u32 LightIndexCapacity_O;
+    u32 LightIndexCapacity_T;
+    u32 CounterParity;
+    u32 TileSize;
+    u32 NumRenderMeshes;
+};
+
+// NOTE: VkDrawIndexedIndirectCommand followed by the data the culling and compaction shaders need per mesh
+struct gpu_draw_command
+{
+    u32 IndexCount;
+    u32 InstanceCount;
+    u32 FirstIndex;
+    i32 VertexOffset;
+    u32 FirstInstance; // NOTE: Zero on the per mesh draw path, the GBuffer vertex shader gets the instance base as a push constant
+    f32 BoundingRadius;
+    u32 DrawGroup;
+    u32 CompactedFirst; // NOTE: Where the groups compacted commands start in the draw command buffer
+    u32 InstanceBase; // NOTE: Where the meshes visible instance ids start
+};
+
+// NOTE: Written by the GPU after light culling, one slot per frame of latency
+struct light_list_readback
+{
+    u32 Counter_O;
+    u32 Counter_T;
+    u32 NumTileOverflows; // NOTE: Tiles that found more lights than fit in the culling shaders shared list
+    u32 NumListTruncations; // NOTE: Tiles whose lights didn't fit in the index list capacity
+};
+
+struct light_list_stats
+{
+    u32 Required_O;
+    u32 Required_T;
+    u32 NumTileOverflows;
+    u32 NumListTruncations;
+    u32 NumResizes;
+};
+
+struct light_index_list
+{
+    u32 Capacity;
+    u32 NumShrinkFrames;
+    VkDeviceMemory Memory;
+    VkBuffer Buffer;
+};
+
+// NOTE: Tile grid resources, each one has its own memory so a resize can build the new ones while the old ones are still in flight
+struct tiled_deferred_buffer
+{
+    VkDeviceMemory Memory;
+    VkBuffer Buffer;
+};
+
+struct tiled_deferred_image
+{
+    VkDeviceMemory Memory;
+    VkImage Image;
+    VkImageView View;
+};
+
+struct tiled_deferred_retired
+{
+    u32 FrameId;
+    VkDeviceMemory Memory;
+    VkBuffer Buffer;
+    VkImage Image;
+    VkImageView View;
+};
+
+// NOTE: Render graph ids of everything the frame reads or writes
+struct tiled_deferred_graph_resources
+{
+    // NOTE: Transients
+    u32 GBufferPosition;
+    u32 GBufferNormal;
+    u32 GBufferMaterial;
+    u32 GBufferNormalCompact;
+    u32 Depth;
+    u32 OutColor;
+
+    // NOTE: Imported
+    u32 DrawCommands;
+    u32 DrawCounts;
+    u32 VisibleInstanceIds;
+    u32 GridFrustums;
+    u32 LightGrid_O;
+    u32 LightGrid_T;
+    u32 LightIndexList_O;
+    u32 LightIndexList_T;
+    u32 LightIndexCounter_O;
+    u32 LightIndexCounter_T;
+    u32 LightListOverflow;
+    u32 LightListReadback;
+    u32 ClusterLightGrid;
+    u32 ClusterLightIndexList;
+    u32 ClusterLightIndexCounter;
+    u32 LightMask_O;
+    u32 LightMask_T;
+    u32 TileBuckets;
+    u32 TileBucketLists;
+};
+
+// NOTE: Everything that depends on the tile size and isn't a lighting permutation
+struct tile_pipelines
+{
+    u32 TileSize;
+    vk_pipeline* GridFrustum;
+    vk_pipeline* LightCull;
+    vk_pipeline* LightCullSubgroup; // NOTE: Only created when the device supports the subgroup ops we need
+    vk_pipeline* LightCullBitmask;
+    u32 NumCacheEntries; // NOTE: Usable once the pipeline cache built this many entries
+};
+
+// NOTE: Tries every candidate tile size the device supports on the current scene, ranked by the light culling + lighting GPU time
+struct tile_size_tuner
+{
+    b32 Active;
+    u32 CandidateId;
+    u32 NumFrames;
+    u32 NumSamples;
+    f32 SumMs;
+    u32 LastCullSample;
+    u32 LastLightingSample;
+    f32 CandidateMs[TILE_SIZE_NUM_CANDIDATES]; // NOTE: 0 if the candidate didn't run
+};
+
+struct lighting_permutation
+{
+    u32 Features;
+    u32 TileSize;
+    vk_pipeline* Fragment[GBufferLayout_Count];
+    vk_pipeline* Compute[GBufferLayout_Count];
+    vk_pipeline* Bucket[GBufferLayout_Count][TileBucket_Count];
+    u32 NumCacheEntries; // NOTE: Usable once the pipeline cache built this many entries
+};
+
+struct tiled_deferred_state;
+struct tiled_deferred_gbuffer_job
+{
+    tiled_deferred_state* State;
+    VkCommandBuffer CmdBuffer;
+    u32 FirstGroup;
+    u32 OnePastLastGroup;
 };
 
 struct tiled_deferred_state
 {
-    vk_linear_arena RenderTargetArena;
+    render_scene* Scene;
     
-    // NOTE: GBuffer
-    VkImage GBufferPositionImage;
-    render_target_entry GBufferPositionEntry;
-    VkImage GBufferNormalImage;
-    render_target_entry GBufferNormalEntry;
-    VkImage GBufferMaterialImage;
-    render_target_entry GBufferMaterialEntry;
-    VkImage DepthImage;
-    render_target_entry DepthEntry;
-    VkImage OutColorImage;
-    render_target_entry OutColorEntry;
-    render_target GBufferPass;
-    render_target LightingPass;
+    // NOTE: GBuffer, the targets are transients of the frame graph. These render passes are only used to create compatible pipelines
+    gbuffer_layout GBufferLayout;
+    VkRenderPass GBufferRenderPass;
+    VkRenderPass GBufferCompactRenderPass;
+    VkRenderPass LightingRenderPass;
+    lighting_mode LightingMode;
+    u32 TileSize;
+    u32 PendingTileSize; // NOTE: Switched to once its pipelines are built, 0 if there is none
+    tile_pipelines* TilePipelines; // NOTE: The set for TileSize
+    u32 NumTilePipelines;
+    tile_pipelines TilePipelineSets[TILE_SIZE_NUM_CANDIDATES];
+    tile_size_tuner TileTuner;
+    tiled_deferred_graph_resources GraphResources;
+    u32 TransientVersion; // NOTE: Graph placement our transient descriptors were written for
+    VkImageView OutColorView;
+    VkBuffer TileBuckets;
+    tiled_deferred_buffer TileBucketLists;
+
+    // NOTE: Parallel GBuffer recording, the owner sets the worker command buffers of the current frame (no jobs records inline)
+    job_system* Jobs;
+    worker_command_buffers* WorkerCommands;
+    render_graph* Graph;
+    u32 NumGBufferJobs;
+    tiled_deferred_gbuffer_job GBufferJobs[JOB_SYSTEM_MAX_WORKERS];
 
     // NOTE: Global data
-    VkBuffer TiledDeferredGlobals;
-    VkBuffer GridFrustums;
-    VkBuffer LightIndexList_O;
+    u32 GlobalsOffset; // NOTE: Upload ring offset of this frame's tiled_deferred_globals
+    tiled_deferred_buffer GridFrustums;
+    b32 GridFrustumsDirty; // NOTE: The next frame recomputes them before light culling
+    light_index_list LightIndexList_O;
     VkBuffer LightIndexCounter_O;
-    vk_image LightGrid_O;
-    VkBuffer LightIndexList_T;
+    tiled_deferred_image LightGrid_O;
+    light_index_list LightIndexList_T;
     VkBuffer LightIndexCounter_T;
-    vk_image LightGrid_T;
+    tiled_deferred_image LightGrid_T;
+
+    // NOTE: Adaptive light index list sizing (lists have their own memory so they can be reallocated without the RT arena)
+    u32 MaxLightIndexCapacity;
+    u32 LightListFrameId; // NOTE: Counts every frame, the retired resources are freed by it too
+    u32 LightListFirstFrameId; // NOTE: Readbacks from before the last resize get skipped
+    u32 LightListSlot;
+    u32 LightCounterParity; // NOTE: The light counters are double buffered, the culler resets the other half for the next frame
+    VkBuffer LightListOverflow;
+    VkBuffer LightListReadbackBuffer;
+    VkDeviceMemory LightListReadbackMemory;
+    light_list_readback* LightListReadbackData;
+    light_list_stats LightListStats;
+    u32 NumRetired;
+    tiled_deferred_retired Retired[TILED_DEFERRED_MAX_RETIRED];
+
+    // NOTE: Clustered light culling
+    light_cull_mode LightCullMode;
+    tiled_deferred_buffer ClusterLightGrid;
+    tiled_deferred_buffer ClusterLightIndexList;
+    VkBuffer ClusterLightIndexCounter;
+
+    // NOTE: Bitmask light lists, one bit per scene light for every tile. They follow the scenes light capacity, so they have their
+    // own memory like the index lists
+    u32 NumLightMaskTiles;
+    u32 NumLightMaskWords;
+    light_index_list LightMask_O;
+    light_index_list LightMask_T;
+    
     VkDescriptorSetLayout TiledDeferredDescLayout;
-    VkDescriptorSet TiledDeferredDescriptor;
+    VkDescriptorSet TiledDeferredDescriptor; // NOTE: The set of the frame we are recording
+    VkDescriptorSet SourceDescriptor; // NOTE: Never bound, every write goes here
+    u32 DescriptorVersion;
+    VkDescriptorSet FrameDescriptors[TILED_DEFERRED_MAX_FRAME_DESCRIPTORS];
+    u32 FrameDescriptorVersions[TILED_DEFERRED_MAX_FRAME_DESCRIPTORS];
+    VkDescriptorSet OutputRtSets[TILED_DEFERRED_MAX_FRAME_DESCRIPTORS]; // NOTE: Owned by the copy to swap passes, one per frame slot too
+    // NOTE: Tiled deferred, scene, material, caustics. Lighting uses all of them, culling the first two and the grid frustum the first
+    VkDescriptorSetLayout ComputeDescLayouts[4];
 
+    // NOTE: GPU instance culling (indexed by mesh id)
+    VkBuffer DrawCommands;
+    VkBuffer DrawCounts;
+    VkBuffer VisibleInstanceIds;
+    // NOTE: Indirect count draws need VK_KHR_draw_indirect_count, multi draw indirect and non zero first instances. Without all of
+    // them every mesh gets its own indirect draw out of the uncompacted commands
+    b32 MultiDrawIndirect;
+    PFN_vkCmdDrawIndexedIndirectCountKHR DrawIndexedIndirectCount;
+    
     render_mesh* QuadMesh;
     
-    vk_pipeline* GridFrustumPipeline;
+    vk_pipeline* InstanceCullPipeline;
+    vk_pipeline* DrawCompactionPipeline;
     vk_pipeline* GBufferPipeline;
-    vk_pipeline* LightCullPipeline;
-    vk_pipeline* LightingPipeline;
+    vk_pipeline* GBufferCompactPipeline;
+    vk_pipeline* ClusterLightCullPipeline;
+
+    // NOTE: Lighting permutations, every lighting mode picks its pipelines out of the current one
+    b32 SpecularEnabled;
+    b32 RimEnabled;
+    b32 CausticsEnabled;
+    u32 NumLightingPermutations;
+    lighting_permutation LightingPermutations[LIGHTING_MAX_PERMUTATIONS];
+    lighting_permutation* LightingPermutation; // NOTE: The one this frame uses
 
     // NOTE: Caustics data
-    VkBuffer CausticsInputBuffer;
+    u32 CausticsInputOffset; // NOTE: Upload ring offset
     VkSampler CausticsSampler;
     vk_image CausticsImage;
     VkDescriptorSetLayout CausticsDescLayout;
@@ -3,6 +3,12 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_GOOGLE_include_directive : enable
 
+#if SUBGROUP_OPS
+#extension GL_KHR_shader_subgroup_basic : enable
+#extension GL_KHR_shader_subgroup_arithmetic : enable
+#extension GL_KHR_shader_subgroup_ballot : enable
+#endif
+
 #include "descriptor_layouts.cpp"
 #include "toon_blinn_phong_lighting.cpp"
 
@@ -74,17 +80,130 @@ vec4 ScreenToView(mat4 InverseProjection, vec2 ScreenSize, vec4 ScreenPos)
     return Result;
 }
 
+// NOTE: https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+vec2 OctahedralWrap(vec2 V)
+{
+    vec2 Result = (1.0f - abs(V.yx)) * vec2(V.x >= 0.0f ? 1.0f : -1.0f, V.y >= 0.0f ? 1.0f : -1.0f);
+    return Result;
+}
+
+vec2 OctahedralEncode(vec3 Normal)
+{
+    Normal /= abs(Normal.x) + abs(Normal.y) + abs(Normal.z);
+    vec2 Result = Normal.z >= 0.0f ? Normal.xy : OctahedralWrap(Normal.xy);
+    return Result;
+}
+
+vec3 OctahedralDecode(vec2 Encoded)
+{
+    vec3 Result = vec3(Encoded, 1.0f - abs(Encoded.x) - abs(Encoded.y));
+    float T = clamp(-Result.z, 0.0f, 1.0f);
+    Result.xy += vec2(Result.x >= 0.0f ? -T : T, Result.y >= 0.0f ? -T : T);
+    Result = normalize(Result);
+    return Result;
+}
+
+//
+// NOTE: Clusters
+//
+
+// NOTE: Slices are distributed exponentially between the near and far plane so that they stay roughly cube shaped
+float ClusterNearZ(mat4 InverseProjection)
+{
+    // NOTE: We use reversed z, depth 1 is the near plane
+    float Result = ClipToView(InverseProjection, vec4(0, 0, 1, 1)).z;
+    return Result;
+}
+
+float ClusterFarZ(mat4 InverseProjection)
+{
+    float Result = ClipToView(InverseProjection, vec4(0, 0, 0, 1)).z;
+    return Result;
+}
+
+float ClusterSliceDepth(float NearZ, float FarZ, uint Slice)
+{
+    float Result = NearZ * pow(FarZ / NearZ, float(Slice) / float(CLUSTER_NUM_SLICES));
+    return Result;
+}
+
+uint ClusterSliceGet(float NearZ, float FarZ, float ViewZ)
+{
+    // NOTE: Works on the ratio to the near plane so the lookup doesn't care which way the view space z axis points, ClusterSliceDepth
+    // keeps the sign of NearZ the same way
+    float Slice = log(max(ViewZ / NearZ, 1.0f)) / log(FarZ / NearZ) * float(CLUSTER_NUM_SLICES);
+    uint Result = min(uint(Slice), CLUSTER_NUM_SLICES - 1);
+    return Result;
+}
+
+uint ClusterIndexGet(uvec2 ClusterGridSize, uvec3 ClusterPos)
+{
+    uint Result = (ClusterPos.z * ClusterGridSize.y + ClusterPos.y) * ClusterGridSize.x + ClusterPos.x;
+    return Result;
+}
+
+bool SphereIntersectsAabb(vec3 SphereCenter, float SphereRadius, vec3 AabbMin, vec3 AabbMax)
+{
+    vec3 Closest = clamp(SphereCenter, AabbMin, AabbMax);
+    vec3 Delta = Closest - SphereCenter;
+    bool Result = dot(Delta, Delta) <= SphereRadius * SphereRadius;
+    return Result;
+}
+
+//
+// NOTE: Specialization Constants
+//
+
+/*
+
+  NOTE: The renderer picks the permutation at runtime (ids match tiled_deferred_spec_constant), every pipeline gets specialized.
+
+ */
+
+#define TILE_DIM_DEFAULT 8
+
+layout(constant_id = 0) const uint TileDimInPixels = TILE_DIM_DEFAULT;
+// NOTE: Ids 1 and 2 are the work group size of the per tile kernels, set to the tile dim as well
+layout(constant_id = 3) const bool LightingPointLights = true;
+layout(constant_id = 4) const bool LightingSpecular = false;
+layout(constant_id = 5) const bool LightingRim = true;
+layout(constant_id = 6) const bool LightingCaustics = true;
+
 //
 // NOTE: Descriptor Sets
 //
 
-#define TILE_DIM_IN_PIXELS 8
+#define MAX_LIGHTS_PER_TILE 1024
+#define CLUSTER_TILE_DIM_IN_PIXELS 64
+#define CLUSTER_NUM_SLICES 32
+#define MAX_LIGHTS_PER_CLUSTER 256
+
+#define LIGHT_CULL_MODE_TILED 0
+#define LIGHT_CULL_MODE_CLUSTERED 1
+#define LIGHT_CULL_MODE_TILED_BITMASK 2
+
+#define TILE_BUCKET_DIRECTIONAL 0
+#define TILE_BUCKET_POINT_LIT 1
+#define TILE_BUCKET_COUNT 2
+#define TILE_BUCKET_MAX_DISPATCH 65535
 
 layout(set = 0, binding = 0) uniform tiled_deferred_globals
 {
     mat4 InverseProjection;
+    mat4 ViewProjection;
+    mat4 InverseViewProjection;
+    mat4 ViewTransform;
     vec2 ScreenSize;
     uvec2 GridSize;
+    uint NumOpaqueInstances;
+    uint LightCullMode;
+    uvec2 ClusterGridSize;
+    uint NumLightMaskWords;
+    uint LightIndexCapacity_O;
+    uint LightIndexCapacity_T;
+    uint CounterParity;
+    uint TileSize;
+    uint NumRenderMeshes;
 };
 
 layout(set = 0, binding = 1) buffer grid_frustums
@@ -100,7 +219,7 @@ layout(set = 0, binding = 3) buffer light_index_list_opaque
 };
 layout(set = 0, binding = 4) buffer light_index_counter_opaque
 {
-    uint LightIndexCounter_O;
+    uint LightIndexCounter_O[2];
 };
 
 // NOTE: Transparent Data
@@ -111,7 +230,7 @@ layout(set = 0, binding = 6) buffer light_index_list_transparent
 };
 layout(set = 0, binding = 7) buffer light_index_counter_transparent
 {
-    uint LightIndexCounter_T;
+    uint LightIndexCounter_T[2];
 };
 
 // NOTE: GBuffer Data
@@ -119,10 +238,125 @@ layout(set = 0, binding = 8) uniform sampler2D GBufferPositionTexture;
 layout(set = 0, binding = 9) uniform sampler2D GBufferNormalTexture;
 layout(set = 0, binding = 10) uniform usampler2D GBufferMaterialTexture;
 layout(set = 0, binding = 11) uniform sampler2D GBufferDepthTexture;
+layout(set = 0, binding = 21) uniform sampler2D GBufferNormalCompactTexture;
+
+// NOTE: Instance Culling Data
+struct draw_command
+{
+    uint IndexCount;
+    uint InstanceCount;
+    uint FirstIndex;
+    int VertexOffset;
+    uint FirstInstance;
+    float BoundingRadius;
+    uint DrawGroup;
+    uint CompactedFirst;
+    uint InstanceBase;
+};
+
+layout(set = 0, binding = 12) buffer draw_commands
+{
+    draw_command DrawCommands[];
+};
+layout(set = 0, binding = 13) buffer draw_counts
+{
+    uint DrawCounts[];
+};
+layout(set = 0, binding = 14) buffer visible_instance_ids
+{
+    uint VisibleInstanceIds[];
+};
+
+// NOTE: Cluster Data (uvec2 per cluster storing the pointer + # of elements)
+layout(set = 0, binding = 15) buffer cluster_light_grid
+{
+    uvec2 ClusterLightGrid[];
+};
+layout(set = 0, binding = 16) buffer cluster_light_index_list
+{
+    uint ClusterLightIndexList[];
+};
+layout(set = 0, binding = 17) buffer cluster_light_index_counter
+{
+    uint ClusterLightIndexCounter[2];
+};
+
+// NOTE: Light Mask Data (NumLightMaskWords per tile, bit i of word j marks light 32*j + i)
+layout(set = 0, binding = 18) buffer light_mask_opaque
+{
+    uint LightMask_O[];
+};
+layout(set = 0, binding = 19) buffer light_mask_transparent
+{
+    uint LightMask_T[];
+};
+
+// NOTE: Light List Overflow Data (read back by the CPU to size the index lists)
+struct light_list_overflow_counts
+{
+    uint NumTileOverflows;
+    uint NumListTruncations;
+};
+
+layout(set = 0, binding = 20) buffer light_list_overflow
+{
+    light_list_overflow_counts LightListOverflow[2];
+};
+
+// NOTE: Tile Classification Data, the dispatch args of each bucket followed by the packed tile positions it holds
+struct tile_bucket
+{
+    uint DispatchX;
+    uint DispatchY;
+    uint DispatchZ;
+    uint NumTiles;
+};
+
+layout(set = 0, binding = 23) buffer tile_buckets
+{
+    tile_bucket TileBuckets[2 * TILE_BUCKET_COUNT];
+};
+
+layout(set = 0, binding = 24) buffer tile_bucket_lists
+{
+    uint TileBucketLists[];
+};
+
+#define TileBucketGet(BucketId) TileBuckets[TILE_BUCKET_COUNT * CounterParity + (BucketId)]
+
+#if LIGHT_CULLING || CLUSTER_LIGHT_CULLING
+
+// NOTE: The light counters are double buffered, this frame accumulates into CounterParity while the first thread of the
+// dispatch resets the other half for the next frame. Every culler resets all of them so switching cull modes stays valid
+void LightCountersReset()
+{
+    uint NextParity = 1 - CounterParity;
+    LightIndexCounter_O[NextParity] = 0;
+    LightIndexCounter_T[NextParity] = 0;
+    ClusterLightIndexCounter[NextParity] = 0;
+    LightListOverflow[NextParity].NumTileOverflows = 0;
+    LightListOverflow[NextParity].NumListTruncations = 0;
+    for (uint BucketId = 0; BucketId < TILE_BUCKET_COUNT; ++BucketId)
+    {
+        TileBuckets[TILE_BUCKET_COUNT * NextParity + BucketId] = tile_bucket(0, 1, 1, 0);
+    }
+}
+
+#endif
 
 SCENE_DESCRIPTOR_LAYOUT(1)
 MATERIAL_DESCRIPTOR_LAYOUT(2)
 
+#if LIGHT_CULLING || CLUSTER_LIGHT_CULLING
+point_light PointLightViewGet(uint LightId)
+{
+    // NOTE: Scene lights are stored in world space, culling happens in view space
+    point_light Result = PointLights[LightId];
+    Result.Pos = (ViewTransform * vec4(Result.Pos, 1)).xyz;
+    return Result;
+}
+#endif
+
 layout(set = 3, binding = 0) uniform sampler2D Caustics;
 layout(set = 3, binding = 1) uniform caustic_inputs
 {
@@ -135,7 +369,8 @@ layout(set = 3, binding = 1) uniform caustic_inputs
 
 #if GRID_FRUSTUM
 
-layout(local_size_x = TILE_DIM_IN_PIXELS, local_size_y = TILE_DIM_IN_PIXELS, local_size_z = 1) in;
+// NOTE: One invocation per tile
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
 
 void main()
 {
@@ -144,10 +379,10 @@ void main()
     {
         // NOTE: Compute four corner points of tile
         vec3 CameraPos = vec3(0);
-        vec4 BotLeft = vec4((GridPos + vec2(0, 0)) * vec2(TILE_DIM_IN_PIXELS), 0, 1);
-        vec4 BotRight = vec4((GridPos + vec2(1, 0)) * vec2(TILE_DIM_IN_PIXELS), 0, 1);
-        vec4 TopLeft = vec4((GridPos + vec2(0, 1)) * vec2(TILE_DIM_IN_PIXELS), 0, 1);
-        vec4 TopRight = vec4((GridPos + vec2(1, 1)) * vec2(TILE_DIM_IN_PIXELS), 0, 1);
+        vec4 BotLeft = vec4((GridPos + vec2(0, 0)) * vec2(TileDimInPixels), 0, 1);
+        vec4 BotRight = vec4((GridPos + vec2(1, 0)) * vec2(TileDimInPixels), 0, 1);
+        vec4 TopLeft = vec4((GridPos + vec2(0, 1)) * vec2(TileDimInPixels), 0, 1);
+        vec4 TopRight = vec4((GridPos + vec2(1, 1)) * vec2(TileDimInPixels), 0, 1);
      
         // NOTE: Transform corner points to far plane in view space (we assume a counter clock wise winding order)
         BotLeft = ScreenToView(InverseProjection, ScreenSize, BotLeft);
@@ -170,6 +405,87 @@ void main()
 
 #endif
 
+//
+// NOTE: Instance Culling Shader
+//
+
+#if INSTANCE_CULLING
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+    uint InstanceId = gl_GlobalInvocationID.x;
+    if (InstanceId >= NumOpaqueInstances)
+    {
+        return;
+    }
+
+    instance_entry Entry = InstanceBuffer[InstanceId];
+    uint MeshId = Entry.MeshId;
+    
+    // NOTE: Bounding sphere in world space (radius scaled by the largest axis scale)
+    vec3 Center = (Entry.WTransform * vec4(0, 0, 0, 1)).xyz;
+    float MaxScale = max(length(Entry.WTransform[0].xyz), max(length(Entry.WTransform[1].xyz), length(Entry.WTransform[2].xyz)));
+    float Radius = DrawCommands[MeshId].BoundingRadius * MaxScale;
+
+    // NOTE: Extract the clip planes from the view projection (Gribb/Hartmann), they point inwards. Depth is [0, w] in Vulkan
+    vec4 Row0 = vec4(ViewProjection[0][0], ViewProjection[1][0], ViewProjection[2][0], ViewProjection[3][0]);
+    vec4 Row1 = vec4(ViewProjection[0][1], ViewProjection[1][1], ViewProjection[2][1], ViewProjection[3][1]);
+    vec4 Row2 = vec4(ViewProjection[0][2], ViewProjection[1][2], ViewProjection[2][2], ViewProjection[3][2]);
+    vec4 Row3 = vec4(ViewProjection[0][3], ViewProjection[1][3], ViewProjection[2][3], ViewProjection[3][3]);
+    vec4 Planes[6] = vec4[6](Row3 + Row0, Row3 - Row0, Row3 + Row1, Row3 - Row1, Row2, Row3 - Row2);
+
+    bool Visible = true;
+    for (int PlaneId = 0; PlaneId < 6; ++PlaneId)
+    {
+        vec4 Plane = Planes[PlaneId];
+        if (dot(Plane.xyz, Center) + Plane.w < -Radius * length(Plane.xyz))
+        {
+            Visible = false;
+        }
+    }
+
+    if (Visible)
+    {
+        InstanceBuffer[InstanceId].WVPTransform = ViewProjection * Entry.WTransform;
+
+        // NOTE: Compact the visible ids into the meshes instance range
+        uint Slot = atomicAdd(DrawCommands[MeshId].InstanceCount, 1);
+        VisibleInstanceIds[DrawCommands[MeshId].InstanceBase + Slot] = InstanceId;
+    }
+}
+
+#endif
+
+//
+// NOTE: Draw Compaction Shader
+//
+
+#if DRAW_COMPACTION
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+    uint MeshId = gl_GlobalInvocationID.x;
+    if (MeshId >= NumRenderMeshes)
+    {
+        return;
+    }
+
+    // NOTE: Meshes without visible instances drop out, the rest get packed into their draw groups range. The order within a group
+    // doesn't matter since every command carries its own instance range
+    draw_command Command = DrawCommands[MeshId];
+    if (Command.InstanceCount > 0)
+    {
+        uint Slot = atomicAdd(DrawCounts[Command.DrawGroup], 1);
+        DrawCommands[Command.CompactedFirst + Slot] = Command;
+    }
+}
+
+#endif
+
 //
 // NOTE: Light Culling Shader
 //
@@ -180,6 +496,17 @@ shared frustum SharedFrustum;
 shared uint SharedMinDepth;
 shared uint SharedMaxDepth;
 
+// NOTE: 2.5D culling, each bit marks a 1/32 slice of the tiles depth range that has geometry in it. Sky pixels don't set bits or
+// pull the range out to the far plane
+shared uint SharedGeometryMinDepth;
+shared uint SharedDepthMask;
+
+#if LIGHT_BITMASK
+shared uint SharedTileHasOpaqueLights;
+#endif
+
+#if !LIGHT_BITMASK
+
 // NOTE: Opaque
 shared uint SharedGlobalLightId_O;
 shared uint SharedCurrLightId_O;
@@ -190,35 +517,122 @@ shared uint SharedGlobalLightId_T;
 shared uint SharedCurrLightId_T;
 shared uint SharedLightIds_T[1024];
 
-void LightAppendOpaque(uint LightId)
+#if SUBGROUP_OPS
+
+// NOTE: One shared atomic per subgroup, every accepted lane gets its slot from the exclusive prefix count of the ballot
+void LightAppendOpaque(bool Accept, uint LightId)
 {
-    uint WriteArrayId = atomicAdd(SharedCurrLightId_O, 1);
-    if (WriteArrayId < 1024)
+    uvec4 Ballot = subgroupBallot(Accept);
+    uint BaseArrayId = 0;
+    if (subgroupElect())
+    {
+        BaseArrayId = atomicAdd(SharedCurrLightId_O, subgroupBallotBitCount(Ballot));
+    }
+    BaseArrayId = subgroupBroadcastFirst(BaseArrayId);
+
+    uint WriteArrayId = BaseArrayId + subgroupBallotExclusiveBitCount(Ballot);
+    if (Accept && WriteArrayId < 1024)
     {
         SharedLightIds_O[WriteArrayId] = LightId;
     }
 }
 
-void LightAppendTransparent(uint LightId)
+void LightAppendTransparent(bool Accept, uint LightId)
 {
-    uint WriteArrayId = atomicAdd(SharedCurrLightId_T, 1);
-    if (WriteArrayId < 1024)
+    uvec4 Ballot = subgroupBallot(Accept);
+    uint BaseArrayId = 0;
+    if (subgroupElect())
+    {
+        BaseArrayId = atomicAdd(SharedCurrLightId_T, subgroupBallotBitCount(Ballot));
+    }
+    BaseArrayId = subgroupBroadcastFirst(BaseArrayId);
+
+    uint WriteArrayId = BaseArrayId + subgroupBallotExclusiveBitCount(Ballot);
+    if (Accept && WriteArrayId < 1024)
     {
         SharedLightIds_T[WriteArrayId] = LightId;
     }
 }
 
-layout(local_size_x = TILE_DIM_IN_PIXELS, local_size_y = TILE_DIM_IN_PIXELS, local_size_z = 1) in;
+#else
 
-void main()
-{    
-    uint NumThreadsPerGroup = TILE_DIM_IN_PIXELS * TILE_DIM_IN_PIXELS;
+void LightAppendOpaque(bool Accept, uint LightId)
+{
+    if (Accept)
+    {
+        uint WriteArrayId = atomicAdd(SharedCurrLightId_O, 1);
+        if (WriteArrayId < 1024)
+        {
+            SharedLightIds_O[WriteArrayId] = LightId;
+        }
+    }
+}
 
-    // NOTE: Skip threads that go past the screen
-    if (!(gl_GlobalInvocationID.x < ScreenSize.x && gl_GlobalInvocationID.y < ScreenSize.y))
+void LightAppendTransparent(bool Accept, uint LightId)
+{
+    if (Accept)
+    {
+        uint WriteArrayId = atomicAdd(SharedCurrLightId_T, 1);
+        if (WriteArrayId < 1024)
+        {
+            SharedLightIds_T[WriteArrayId] = LightId;
+        }
+    }
+}
+
+#endif
+
+#endif
+
+void LightTileTest(point_light Light, float NearClipDepth, float MinDepth, plane MinPlane, float MaskNearZ, float MaskInvRange,
+                   out bool AcceptTransparent, out bool AcceptOpaque)
+{
+    AcceptTransparent = false;
+    AcceptOpaque = false;
+    if (SphereInsideFrustum(Light.Pos, Light.MaxDistance, SharedFrustum, NearClipDepth, MinDepth))
+    {
+        AcceptTransparent = true;
+
+        // NOTE: Opaque geometry only exists in the slices of the depth mask, lights that fall in the gaps between them are rejected
+        float LightMinBucket = (Light.Pos.z - Light.MaxDistance - MaskNearZ) * MaskInvRange;
+        float LightMaxBucket = (Light.Pos.z + Light.MaxDistance - MaskNearZ) * MaskInvRange;
+        if (!SphereInsidePlane(Light.Pos, Light.MaxDistance, MinPlane) && LightMaxBucket >= 0.0f && LightMinBucket < 32.0f)
+        {
+            uint FirstBit = uint(max(LightMinBucket, 0.0f));
+            uint LastBit = uint(min(LightMaxBucket, 31.0f));
+            uint LightMask = (0xFFFFFFFFu >> (31 - (LastBit - FirstBit))) << FirstBit;
+            AcceptOpaque = (LightMask & SharedDepthMask) != 0;
+        }
+    }
+}
+
+// NOTE: Sky tiles go in no bucket, the rest get lit by the kernel for their bucket. Tiles past the dispatch limit are still
+// counted, the lighting work groups loop until they covered all of them
+void TileClassify(bool HasOpaqueLights)
+{
+    if (SharedMaxDepth == 0)
     {
         return;
     }
+
+    uint BucketId = HasOpaqueLights ? TILE_BUCKET_POINT_LIT : TILE_BUCKET_DIRECTIONAL;
+    uint NumTiles = uint(GridSize.x) * uint(GridSize.y);
+    uint ListId = atomicAdd(TileBucketGet(BucketId).NumTiles, 1);
+    if (ListId < TILE_BUCKET_MAX_DISPATCH)
+    {
+        atomicAdd(TileBucketGet(BucketId).DispatchX, 1);
+    }
+    TileBucketLists[BucketId * NumTiles + ListId] = uint(gl_WorkGroupID.x) | (uint(gl_WorkGroupID.y) << 16);
+}
+
+layout(local_size_x = TILE_DIM_DEFAULT, local_size_y = TILE_DIM_DEFAULT, local_size_z = 1, local_size_x_id = 1, local_size_y_id = 2) in;
+
+void main()
+{    
+    uint NumThreadsPerGroup = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+
+    // NOTE: Threads that go past the screen don't contribute depth, but they stay alive for the barriers and subgroup ops
+    bool InsideScreen = gl_GlobalInvocationID.x < ScreenSize.x && gl_GlobalInvocationID.y < ScreenSize.y;
     
     // NOTE: Setup shared variables
     if (gl_LocalInvocationIndex == 0)
@@ -226,8 +640,19 @@ void main()
         SharedFrustum = GridFrustums[uint(gl_WorkGroupID.y) * GridSize.x + uint(gl_WorkGroupID.x)];
         SharedMinDepth = 0xFFFFFFFF;
         SharedMaxDepth = 0;
+        SharedGeometryMinDepth = 0xFFFFFFFF;
+        SharedDepthMask = 0;
+#if LIGHT_BITMASK
+        SharedTileHasOpaqueLights = 0;
+#else
         SharedCurrLightId_O = 0;
         SharedCurrLightId_T = 0;
+#endif
+
+        if (gl_WorkGroupID.x == 0 && gl_WorkGroupID.y == 0)
+        {
+            LightCountersReset();
+        }
     }
 
     barrier();
@@ -235,9 +660,56 @@ void main()
     // NOTE: Calculate min/max depth in grid tile (since our depth values are between 0 and 1, we can reinterpret them as ints and
     // comparison will still work correctly)
     ivec2 ReadPixelId = ivec2(gl_GlobalInvocationID.xy);
-    uint PixelDepth = floatBitsToInt(texelFetch(GBufferDepthTexture, ReadPixelId, 0).x);
-    atomicMin(SharedMinDepth, PixelDepth);
+    uint PixelDepth = InsideScreen ? floatBitsToUint(texelFetch(GBufferDepthTexture, ReadPixelId, 0).x) : 0;
+    uint PixelMinDepth = InsideScreen ? PixelDepth : 0xFFFFFFFF;
+    uint PixelGeometryMinDepth = PixelDepth != 0 ? PixelDepth : 0xFFFFFFFF;
+    
+#if SUBGROUP_OPS
+    // NOTE: Reduce within the subgroup first so only one lane per subgroup touches shared memory
+    uint SubgroupMinDepth = subgroupMin(PixelMinDepth);
+    uint SubgroupMaxDepth = subgroupMax(PixelDepth);
+    uint SubgroupGeometryMinDepth = subgroupMin(PixelGeometryMinDepth);
+    if (subgroupElect())
+    {
+        atomicMin(SharedMinDepth, SubgroupMinDepth);
+        atomicMax(SharedMaxDepth, SubgroupMaxDepth);
+        atomicMin(SharedGeometryMinDepth, SubgroupGeometryMinDepth);
+    }
+#else
+    atomicMin(SharedMinDepth, PixelMinDepth);
     atomicMax(SharedMaxDepth, PixelDepth);
+    if (PixelDepth != 0)
+    {
+        atomicMin(SharedGeometryMinDepth, PixelGeometryMinDepth);
+    }
+#endif
+    
+    barrier();
+
+    // NOTE: Build the depth mask between the closest and furthest geometry in the tile
+    float MaskNearZ = ClipToView(InverseProjection, vec4(0, 0, uintBitsToFloat(SharedMaxDepth), 1)).z;
+    float MaskFarZ = ClipToView(InverseProjection, vec4(0, 0, uintBitsToFloat(SharedGeometryMinDepth), 1)).z;
+    float MaskInvRange = 32.0f / max(MaskFarZ - MaskNearZ, 1e-5);
+    uint PixelMask = 0;
+    if (PixelDepth != 0)
+    {
+        float PixelZ = ClipToView(InverseProjection, vec4(0, 0, uintBitsToFloat(PixelDepth), 1)).z;
+        uint Bucket = uint(clamp((PixelZ - MaskNearZ) * MaskInvRange, 0.0f, 31.0f));
+        PixelMask = 1u << Bucket;
+    }
+    
+#if SUBGROUP_OPS
+    uint SubgroupMask = subgroupOr(PixelMask);
+    if (subgroupElect())
+    {
+        atomicOr(SharedDepthMask, SubgroupMask);
+    }
+#else
+    if (PixelMask != 0)
+    {
+        atomicOr(SharedDepthMask, PixelMask);
+    }
+#endif
 
     barrier();
 
@@ -251,39 +723,98 @@ void main()
     float NearClipDepth = ClipToView(InverseProjection, vec4(0, 0, 1, 1)).z;
     plane MinPlane = { vec3(0, 0, 1), MaxDepth };
     
-    // NOTE: Cull lights against tiles frustum (each thread culls one light at a time)
-    for (uint LightId = gl_LocalInvocationIndex; LightId < SceneBuffer.NumPointLights; LightId += NumThreadsPerGroup)
+#if LIGHT_BITMASK
+    // NOTE: Each thread culls the 32 lights of one mask word and writes it out directly, no shared lists or atomics needed. The masks
+    // are capped in size, lights past the last word get dropped
+    uint MaskOffset = (uint(gl_WorkGroupID.y) * GridSize.x + uint(gl_WorkGroupID.x)) * NumLightMaskWords;
+    uint NumWords = min((SceneBuffer.NumPointLights + 31) / 32, NumLightMaskWords);
+    if (gl_LocalInvocationIndex == 0 && SceneBuffer.NumPointLights > 32 * NumLightMaskWords)
+    {
+        atomicAdd(LightListOverflow[CounterParity].NumListTruncations, 1);
+    }
+    
+    for (uint WordId = gl_LocalInvocationIndex; WordId < NumWords; WordId += NumThreadsPerGroup)
     {
-        point_light Light = PointLights[LightId];
-        if (SphereInsideFrustum(Light.Pos, Light.MaxDistance, SharedFrustum, NearClipDepth, MinDepth))
+        uint WordOpaque = 0;
+        uint WordTransparent = 0;
+        uint NumWordLights = min(32, SceneBuffer.NumPointLights - 32 * WordId);
+        for (uint BitId = 0; BitId < NumWordLights; ++BitId)
         {
-            LightAppendTransparent(LightId);
+            bool AcceptTransparent;
+            bool AcceptOpaque;
+            LightTileTest(PointLightViewGet(32 * WordId + BitId), NearClipDepth, MinDepth, MinPlane, MaskNearZ, MaskInvRange,
+                          AcceptTransparent, AcceptOpaque);
+            WordTransparent |= uint(AcceptTransparent) << BitId;
+            WordOpaque |= uint(AcceptOpaque) << BitId;
+        }
 
-            if (!SphereInsidePlane(Light.Pos, Light.MaxDistance, MinPlane))
-            {
-                LightAppendOpaque(LightId);
-            }
+        LightMask_O[MaskOffset + WordId] = WordOpaque;
+        LightMask_T[MaskOffset + WordId] = WordTransparent;
+        if (WordOpaque != 0)
+        {
+            SharedTileHasOpaqueLights = 1;
         }
     }
 
     barrier();
 
-    // NOTE: Get space and light index lists
+    if (gl_LocalInvocationIndex == 0)
+    {
+        TileClassify(SharedTileHasOpaqueLights != 0);
+    }
+#else
+    // NOTE: Cull lights against tiles frustum (each thread culls one light at a time)
+    for (uint LightId = gl_LocalInvocationIndex; LightId < SceneBuffer.NumPointLights; LightId += NumThreadsPerGroup)
+    {
+        bool AcceptTransparent;
+        bool AcceptOpaque;
+        LightTileTest(PointLightViewGet(LightId), NearClipDepth, MinDepth, MinPlane, MaskNearZ, MaskInvRange, AcceptTransparent, AcceptOpaque);
+        LightAppendTransparent(AcceptTransparent, LightId);
+        LightAppendOpaque(AcceptOpaque, LightId);
+    }
+
+    barrier();
+
+    // NOTE: Get space and light index lists. The counters keep counting past the list capacity so the CPU sees how much space
+    // we actually needed, but we only write the lights that fit. Every cell gets written, empty tiles included, so the grid never
+    // needs a clear
     if (gl_LocalInvocationIndex == 0)
     {
         ivec2 WritePixelId = ivec2(gl_WorkGroupID.xy);
 
+        if (max(SharedCurrLightId_O, SharedCurrLightId_T) > 1024)
+        {
+            atomicAdd(LightListOverflow[CounterParity].NumTileOverflows, 1);
+        }
+        
         // NOTE: Without the ifs, we get a lot of false positives, might be quicker to skip the atomic? Idk if this matters a lot
+        SharedGlobalLightId_O = 0;
         if (SharedCurrLightId_O != 0)
         {
-            SharedGlobalLightId_O = atomicAdd(LightIndexCounter_O, SharedCurrLightId_O);
-            imageStore(LightGrid_O, WritePixelId, ivec4(SharedGlobalLightId_O, SharedCurrLightId_O, 0, 0));
+            uint NumLights = min(SharedCurrLightId_O, 1024);
+            SharedGlobalLightId_O = atomicAdd(LightIndexCounter_O[CounterParity], NumLights);
+            SharedCurrLightId_O = min(NumLights, LightIndexCapacity_O - min(SharedGlobalLightId_O, LightIndexCapacity_O));
+            if (SharedCurrLightId_O < NumLights)
+            {
+                atomicAdd(LightListOverflow[CounterParity].NumListTruncations, 1);
+            }
         }
+        imageStore(LightGrid_O, WritePixelId, ivec4(SharedGlobalLightId_O, SharedCurrLightId_O, 0, 0));
+        
+        SharedGlobalLightId_T = 0;
         if (SharedCurrLightId_T != 0)
         {
-            SharedGlobalLightId_T = atomicAdd(LightIndexCounter_T, SharedCurrLightId_T);
-            imageStore(LightGrid_T, WritePixelId, ivec4(SharedGlobalLightId_T, SharedCurrLightId_T, 0, 0));
+            uint NumLights = min(SharedCurrLightId_T, 1024);
+            SharedGlobalLightId_T = atomicAdd(LightIndexCounter_T[CounterParity], NumLights);
+            SharedCurrLightId_T = min(NumLights, LightIndexCapacity_T - min(SharedGlobalLightId_T, LightIndexCapacity_T));
+            if (SharedCurrLightId_T < NumLights)
+            {
+                atomicAdd(LightListOverflow[CounterParity].NumListTruncations, 1);
+            }
         }
+        imageStore(LightGrid_T, WritePixelId, ivec4(SharedGlobalLightId_T, SharedCurrLightId_T, 0, 0));
+
+        TileClassify(SharedCurrLightId_O != 0);
     }
 
     barrier();
@@ -299,6 +830,96 @@ void main()
     {
         LightIndexList_T[SharedGlobalLightId_T + LightId] = SharedLightIds_T[LightId];
     }
+#endif
+}
+
+#endif
+
+//
+// NOTE: Cluster Light Culling Shader
+//
+
+#if CLUSTER_LIGHT_CULLING
+
+shared vec3 SharedAabbMin;
+shared vec3 SharedAabbMax;
+shared uint SharedClusterLightCount;
+shared uint SharedClusterLightOffset;
+shared uint SharedClusterLightIds[MAX_LIGHTS_PER_CLUSTER];
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+    uint NumThreadsPerGroup = 64;
+    uvec3 ClusterPos = gl_WorkGroupID;
+    uint ClusterId = ClusterIndexGet(ClusterGridSize, ClusterPos);
+    
+    // NOTE: Build the view space AABB of this cluster
+    if (gl_LocalInvocationIndex == 0)
+    {
+        float NearZ = ClusterNearZ(InverseProjection);
+        float FarZ = ClusterFarZ(InverseProjection);
+        float SliceNearZ = ClusterSliceDepth(NearZ, FarZ, ClusterPos.z);
+        float SliceFarZ = ClusterSliceDepth(NearZ, FarZ, ClusterPos.z + 1);
+        
+        vec2 TileMin = vec2(ClusterPos.xy * CLUSTER_TILE_DIM_IN_PIXELS);
+        vec2 TileMax = min(TileMin + vec2(CLUSTER_TILE_DIM_IN_PIXELS), ScreenSize);
+        vec2 Corners[4] = vec2[4](TileMin, vec2(TileMax.x, TileMin.y), vec2(TileMin.x, TileMax.y), TileMax);
+
+        vec3 AabbMin = vec3(1e30);
+        vec3 AabbMax = vec3(-1e30);
+        for (int CornerId = 0; CornerId < 4; ++CornerId)
+        {
+            // NOTE: Scale the ray through the corner onto the slices near and far planes
+            vec3 Ray = ScreenToView(InverseProjection, ScreenSize, vec4(Corners[CornerId], 1, 1)).xyz;
+            Ray = Ray / Ray.z;
+            AabbMin = min(AabbMin, min(Ray * SliceNearZ, Ray * SliceFarZ));
+            AabbMax = max(AabbMax, max(Ray * SliceNearZ, Ray * SliceFarZ));
+        }
+
+        SharedAabbMin = AabbMin;
+        SharedAabbMax = AabbMax;
+        SharedClusterLightCount = 0;
+
+        if (gl_WorkGroupID.x == 0 && gl_WorkGroupID.y == 0 && gl_WorkGroupID.z == 0)
+        {
+            LightCountersReset();
+        }
+    }
+
+    barrier();
+
+    // NOTE: Cull lights against the cluster (each thread culls one light at a time)
+    for (uint LightId = gl_LocalInvocationIndex; LightId < SceneBuffer.NumPointLights; LightId += NumThreadsPerGroup)
+    {
+        point_light Light = PointLightViewGet(LightId);
+        if (SphereIntersectsAabb(Light.Pos, Light.MaxDistance, SharedAabbMin, SharedAabbMax))
+        {
+            uint WriteArrayId = atomicAdd(SharedClusterLightCount, 1);
+            if (WriteArrayId < MAX_LIGHTS_PER_CLUSTER)
+            {
+                SharedClusterLightIds[WriteArrayId] = LightId;
+            }
+        }
+    }
+
+    barrier();
+
+    // NOTE: The index list is sized for MAX_LIGHTS_PER_CLUSTER per cluster so clamping the count is enough to never overflow it
+    if (gl_LocalInvocationIndex == 0)
+    {
+        SharedClusterLightCount = min(SharedClusterLightCount, MAX_LIGHTS_PER_CLUSTER);
+        SharedClusterLightOffset = atomicAdd(ClusterLightIndexCounter[CounterParity], SharedClusterLightCount);
+        ClusterLightGrid[ClusterId] = uvec2(SharedClusterLightOffset, SharedClusterLightCount);
+    }
+
+    barrier();
+
+    for (uint LightId = gl_LocalInvocationIndex; LightId < SharedClusterLightCount; LightId += NumThreadsPerGroup)
+    {
+        ClusterLightIndexList[SharedClusterLightOffset + LightId] = SharedClusterLightIds[LightId];
+    }
 }
 
 #endif
@@ -318,15 +939,23 @@ layout(location = 1) out vec3 OutWorldNormal;
 layout(location = 2) out vec2 OutUv;
 layout(location = 3) out flat uint OutInstanceId;
 
+// NOTE: Zero when the draws carry the instance base as their first instance (gl_InstanceIndex includes it)
+layout(push_constant) uniform gbuffer_push_constants
+{
+    uint InstanceBase;
+};
+
 void main()
 {
-    instance_entry Entry = InstanceBuffer[gl_InstanceIndex];
+    // NOTE: gl_InstanceIndex walks the compacted visible ids of this mesh
+    uint InstanceId = VisibleInstanceIds[InstanceBase + gl_InstanceIndex];
+    instance_entry Entry = InstanceBuffer[InstanceId];
     
     gl_Position = Entry.WVPTransform * vec4(InPos, 1);
     OutWorldPos = (Entry.WTransform * vec4(InPos, 1)).xyz;
     OutWorldNormal = (Entry.WTransform * vec4(InNormal, 0)).xyz;
     OutUv = InUv;
-    OutInstanceId = gl_InstanceIndex;
+    OutInstanceId = InstanceId;
 }
 
 #endif
@@ -342,6 +971,19 @@ layout(location = 1) in vec3 InWorldNormal;
 layout(location = 2) in vec2 InUv;
 layout(location = 3) in flat uint InInstanceId;
 
+#if GBUFFER_COMPACT
+
+layout(location = 0) out vec2 OutWorldNormal;
+layout(location = 1) out uvec2 OutMaterial;
+
+void main()
+{
+    OutWorldNormal = OctahedralEncode(normalize(InWorldNormal));
+    OutMaterial = uvec2(InInstanceId, 0);
+}
+
+#else
+
 layout(location = 0) out vec4 OutWorldPos;
 layout(location = 1) out vec4 OutWorldNormal;
 layout(location = 2) out uvec2 OutMaterial;
@@ -355,6 +997,8 @@ void main()
 
 #endif
 
+#endif
+
 //
 // NOTE: Directional Light Vert
 //
@@ -374,9 +1018,33 @@ void main()
 // NOTE: Tiled Deferred Lighting
 //
 
-#if TILED_DEFERRED_LIGHTING_FRAG
+#if TILED_DEFERRED_LIGHTING_FRAG || TILED_DEFERRED_LIGHTING_COMP
 
-layout(location = 0) out vec4 OutColor;
+// NOTE: The directional bucket only gets tiles without point lights, its kernel drops the point light lists and loop altogether
+#define LIGHTING_POINT_LIGHT_KERNEL (LIGHTING_BUCKET != TILE_BUCKET_DIRECTIONAL + 1)
+
+#if TILED_DEFERRED_LIGHTING_COMP
+
+// NOTE: Compute has no implicit derivatives, so we sample the top mip
+#define CausticsFetch(Uv) textureLod(Caustics, Uv, 0)
+#define LightingTileDim TileDimInPixels
+
+layout(set = 0, binding = 22, rgba16f) uniform writeonly image2D OutColorImage;
+
+// NOTE: One work group per light tile, the tiles light list gets loaded into shared memory once instead of per pixel
+#if LIGHTING_POINT_LIGHT_KERNEL
+shared uint SharedTileNumLights;
+shared uint SharedTileLightOffset;
+shared uint SharedTileLightIds[MAX_LIGHTS_PER_TILE];
+#endif
+
+#else
+
+#define CausticsFetch(Uv) texture(Caustics, Uv)
+// NOTE: Fragments don't run in tile sized groups, the light grid lookup uses the tile size out of the globals
+#define LightingTileDim TileSize
+
+#endif
 
 vec3 CausticsSample(vec2 Uv, vec2 Scaling, vec2 Dir, vec2 Offset)
 {
@@ -384,54 +1052,128 @@ vec3 CausticsSample(vec2 Uv, vec2 Scaling, vec2 Dir, vec2 Offset)
     float SplitRgbSize = 0.005;
     
     vec2 CausticsUv = Uv / Scaling + Offset * Dir;
-    vec3 CausticsColor = vec3(texture(Caustics, CausticsUv + vec2(+SplitRgbSize, +SplitRgbSize)).r,
-                              texture(Caustics, CausticsUv + vec2(+SplitRgbSize, -SplitRgbSize)).g,
-                              texture(Caustics, CausticsUv + vec2(-SplitRgbSize, -SplitRgbSize)).b);
+    vec3 CausticsColor = vec3(CausticsFetch(CausticsUv + vec2(+SplitRgbSize, +SplitRgbSize)).r,
+                              CausticsFetch(CausticsUv + vec2(+SplitRgbSize, -SplitRgbSize)).g,
+                              CausticsFetch(CausticsUv + vec2(-SplitRgbSize, -SplitRgbSize)).b);
 
     return CausticsColor;
 }
 
-void main()
+#if LIGHTING_POINT_LIGHT_KERNEL
+
+// NOTE: Returns the pointer + # of elements of the point light list for this pixel, for the active culling mode
+uvec2 PointLightListGet(ivec2 PixelPos)
+{
+    uvec2 Result = uvec2(0);
+    if (LightCullMode == LIGHT_CULL_MODE_CLUSTERED)
+    {
+        float Depth = texelFetch(GBufferDepthTexture, PixelPos, 0).x;
+        float ViewZ = ScreenToView(InverseProjection, ScreenSize, vec4(vec2(PixelPos) + vec2(0.5), Depth, 1)).z;
+        uint Slice = ClusterSliceGet(ClusterNearZ(InverseProjection), ClusterFarZ(InverseProjection), ViewZ);
+        uvec3 ClusterPos = uvec3(uvec2(PixelPos) / uvec2(CLUSTER_TILE_DIM_IN_PIXELS), Slice);
+        Result = ClusterLightGrid[ClusterIndexGet(ClusterGridSize, ClusterPos)];
+    }
+    else
+    {
+#if TILED_DEFERRED_LIGHTING_COMP
+        Result = uvec2(0, SharedTileNumLights);
+#else
+        ivec2 GridPos = PixelPos / ivec2(LightingTileDim);
+        Result = imageLoad(LightGrid_O, GridPos).xy;
+#endif
+    }
+
+    return Result;
+}
+
+uint PointLightIdGet(uint ListId)
+{
+#if TILED_DEFERRED_LIGHTING_COMP
+    uint Result = LightCullMode == LIGHT_CULL_MODE_CLUSTERED ? ClusterLightIndexList[ListId] : SharedTileLightIds[ListId];
+#else
+    uint Result = LightCullMode == LIGHT_CULL_MODE_CLUSTERED ? ClusterLightIndexList[ListId] : LightIndexList_O[ListId];
+#endif
+    return Result;
+}
+
+#endif
+
+vec4 TiledDeferredShade(ivec2 PixelPos)
 {
     vec3 CameraPos = SceneBuffer.CameraPos;
-    ivec2 PixelPos = ivec2(gl_FragCoord.xy);
 
     uvec2 MaterialId = texelFetch(GBufferMaterialTexture, PixelPos, 0).xy;
     if (MaterialId.x == 0xFFFFFFFF)
     {
-        return;
+        return vec4(0, 0, 0, 1);
     }
     
     instance_entry Entry = InstanceBuffer[MaterialId.x];
     
+#if GBUFFER_COMPACT
+    // NOTE: Reconstruct the world position from depth
+    float Depth = texelFetch(GBufferDepthTexture, PixelPos, 0).x;
+    vec2 Ndc = 2.0f * ((vec2(PixelPos) + vec2(0.5f)) / ScreenSize) - vec2(1.0f);
+    vec4 WorldPos = InverseViewProjection * vec4(Ndc, Depth, 1);
+    vec3 SurfacePos = WorldPos.xyz / WorldPos.w;
+    vec3 SurfaceNormal = OctahedralDecode(texelFetch(GBufferNormalCompactTexture, PixelPos, 0).xy);
+#else
     vec3 SurfacePos = texelFetch(GBufferPositionTexture, PixelPos, 0).xyz;
     vec3 SurfaceNormal = texelFetch(GBufferNormalTexture, PixelPos, 0).xyz;
+#endif
     vec3 SurfaceColor = Entry.Color.rgb;
     vec3 View = normalize(CameraPos - SurfacePos);
     
     vec3 Color = vec3(0);
 
-#if 0
-    // NOTE: Calculate lighting for point lights
-    ivec2 GridPos = PixelPos / ivec2(TILE_DIM_IN_PIXELS);
-    uvec2 LightIndexMetaData = imageLoad(LightGrid_O, GridPos).xy; // NOTE: Stores the pointer + # of elements
-    for (int i = 0; i < LightIndexMetaData.y; ++i)
+    // NOTE: Calculate lighting for point lights (compiled out for scenes without any and for directional tiles)
+#if LIGHTING_POINT_LIGHT_KERNEL
+    if (LightingPointLights)
     {
-        uint LightId = LightIndexList_O[LightIndexMetaData.x + i];
-        point_light CurrLight = PointLights[LightId];
-        vec3 LightDir = normalize(SurfacePos - CurrLight.Pos);
-        Color += ToonBlinnPhongLighting(View, SurfaceColor, SurfaceNormal, 32, LightDir, PointLightAttenuate(SurfacePos, CurrLight));
+        if (LightCullMode == LIGHT_CULL_MODE_TILED_BITMASK)
+        {
+            ivec2 GridPos = PixelPos / ivec2(LightingTileDim);
+            uint MaskOffset = (GridPos.y * GridSize.x + GridPos.x) * NumLightMaskWords;
+            uint NumWords = min((SceneBuffer.NumPointLights + 31) / 32, NumLightMaskWords);
+            for (uint WordId = 0; WordId < NumWords; ++WordId)
+            {
+                uint Word = LightMask_O[MaskOffset + WordId];
+                while (Word != 0)
+                {
+                    uint LightId = 32 * WordId + findLSB(Word);
+                    Word &= Word - 1;
+                
+                    point_light CurrLight = PointLights[LightId];
+                    vec3 LightDir = normalize(SurfacePos - CurrLight.Pos);
+                    Color += ToonBlinnPhongLighting(View, SurfaceColor, SurfaceNormal, Entry.SpecularPower, Entry.RimBound, Entry.RimThreshold,
+                                                    LightingSpecular, LightingRim, LightDir, PointLightAttenuate(SurfacePos, CurrLight));
+                }
+            }
+        }
+        else
+        {
+            uvec2 LightIndexMetaData = PointLightListGet(PixelPos); // NOTE: Stores the pointer + # of elements
+            for (uint i = 0; i < LightIndexMetaData.y; ++i)
+            {
+                uint LightId = PointLightIdGet(LightIndexMetaData.x + i);
+                point_light CurrLight = PointLights[LightId];
+                vec3 LightDir = normalize(SurfacePos - CurrLight.Pos);
+                Color += ToonBlinnPhongLighting(View, SurfaceColor, SurfaceNormal, Entry.SpecularPower, Entry.RimBound, Entry.RimThreshold,
+                                                LightingSpecular, LightingRim, LightDir, PointLightAttenuate(SurfacePos, CurrLight));
+            }
+        }
     }
 #endif
     
     // NOTE: Calculate lighting for directional lights
     {
         Color += ToonBlinnPhongLighting(View, SurfaceColor, SurfaceNormal, Entry.SpecularPower, Entry.RimBound, Entry.RimThreshold,
-                                        DirectionalLight.Dir, DirectionalLight.Color);
+                                        LightingSpecular, LightingRim, DirectionalLight.Dir, DirectionalLight.Color);
         Color += DirectionalLight.AmbientLight * SurfaceColor;
     }
 
     // NOTE: Water caustics
+    if (LightingCaustics)
     {
         // NOTE: https://www.alanzucconi.com/2019/09/13/believable-caustics-reflections/
         // TODO: These are global inputs
@@ -451,7 +1193,77 @@ void main()
         Color += NDotL * min(CausticsColor1, CausticsColor2);
     }
     
-    OutColor = vec4(Color, 1);
+    return vec4(Color, 1);
+}
+
+#endif
+
+#if TILED_DEFERRED_LIGHTING_FRAG
+
+layout(location = 0) out vec4 OutColor;
+
+void main()
+{
+    OutColor = TiledDeferredShade(ivec2(gl_FragCoord.xy));
+}
+
+#endif
+
+#if TILED_DEFERRED_LIGHTING_COMP
+
+layout(local_size_x = TILE_DIM_DEFAULT, local_size_y = TILE_DIM_DEFAULT, local_size_z = 1, local_size_x_id = 1, local_size_y_id = 2) in;
+
+void TileLight(uvec2 TileId)
+{
+    uint NumThreadsPerGroup = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+
+    // NOTE: Load the tiles light list once for the whole work group (directional tiles have no point lights to load). The list only
+    // feeds the point light loop, so kernels specialized without point lights skip it
+#if LIGHTING_POINT_LIGHT_KERNEL
+    if (LightingPointLights && LightCullMode == LIGHT_CULL_MODE_TILED)
+    {
+        if (gl_LocalInvocationIndex == 0)
+        {
+            uvec2 LightIndexMetaData = imageLoad(LightGrid_O, ivec2(TileId)).xy;
+            SharedTileLightOffset = LightIndexMetaData.x;
+            SharedTileNumLights = min(LightIndexMetaData.y, MAX_LIGHTS_PER_TILE);
+        }
+
+        barrier();
+
+        for (uint ListId = gl_LocalInvocationIndex; ListId < SharedTileNumLights; ListId += NumThreadsPerGroup)
+        {
+            SharedTileLightIds[ListId] = LightIndexList_O[SharedTileLightOffset + ListId];
+        }
+
+        barrier();
+    }
+#endif
+    
+    ivec2 PixelPos = ivec2(TileId * uvec2(TileDimInPixels) + gl_LocalInvocationID.xy);
+    if (PixelPos.x < int(ScreenSize.x) && PixelPos.y < int(ScreenSize.y))
+    {
+        imageStore(OutColorImage, PixelPos, TiledDeferredShade(PixelPos));
+    }
+}
+
+void main()
+{
+#if LIGHTING_BUCKET
+    // NOTE: Only the tiles the culler put in our bucket, each work group walks the list in case it got past the dispatch limit
+    uint BucketId = LIGHTING_BUCKET - 1;
+    uint NumTiles = uint(GridSize.x) * uint(GridSize.y);
+    for (uint ListId = gl_WorkGroupID.x; ListId < TileBucketGet(BucketId).NumTiles; ListId += gl_NumWorkGroups.x)
+    {
+        uint PackedTileId = TileBucketLists[BucketId * NumTiles + ListId];
+        TileLight(uvec2(PackedTileId & 0xFFFF, PackedTileId >> 16));
+
+        // NOTE: The next tile reuses the shared light list
+        barrier();
+    }
+#else
+    TileLight(gl_WorkGroupID.xy);
+#endif
 }
 
 #endif
@@ -8,9 +8,10 @@
   
  */
 
+// NOTE: Specular and Rim are meant to be specialization constants, the disabled terms get compiled out
 vec3 ToonBlinnPhongLighting(vec3 CameraView,
                             vec3 SurfaceColor, vec3 SurfaceNormal, float SurfaceSpecularPower, float RimParam, float RimThreshold,
-                            vec3 LightDir, vec3 LightColor)
+                            bool Specular, bool Rim, vec3 LightDir, vec3 LightColor)
 {
     // IMPORTANT: We assume LightDir is pointing from the surface to the light
     vec3 Result = vec3(0);
@@ -24,17 +25,17 @@ vec3 ToonBlinnPhongLighting(vec3 CameraView,
         LightIntensity += DiffuseIntensity;
     }
 
-#if 0
     // NOTE: Specular Light
+    if (Specular)
     {
         vec3 HalfwayDir = normalize(-LightDir + CameraView);
         float SpecularIntensity = pow(max(0, dot(SurfaceNormal, HalfwayDir)), SurfaceSpecularPower*SurfaceSpecularPower);
         SpecularIntensity = smoothstep(0.005, 0.01, SpecularIntensity);
         LightIntensity += SpecularIntensity;
     }
-#endif
     
     // NOTE: Rim Light
+    if (Rim)
     {
         float RimIntensity = (1 - dot(CameraView, SurfaceNormal)) * pow(NDotL, RimThreshold);
         RimIntensity = smoothstep(RimParam - 0.01, RimParam + 0.01, RimIntensity);
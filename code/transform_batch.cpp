@@ -0,0 +1,71 @@
+
+inline soa_v3 SoaV3Create(linear_arena* Arena, u32 Count)
+{
+    soa_v3 Result = {};
+    Result.X = PushArray(Arena, f32, Count);
+    Result.Y = PushArray(Arena, f32, Count);
+    Result.Z = PushArray(Arena, f32, Count);
+
+    return Result;
+}
+
+inline void TransformBatchPointsScalar(m4 Transform, soa_v3 In, soa_v3 Out, u32 FirstId, u32 Count)
+{
+    f32* M = (f32*)&Transform;
+    for (u32 Id = FirstId; Id < Count; ++Id)
+    {
+        f32 X = In.X[Id];
+        f32 Y = In.Y[Id];
+        f32 Z = In.Z[Id];
+        Out.X[Id] = M[0]*X + M[4]*Y + M[8]*Z + M[12];
+        Out.Y[Id] = M[1]*X + M[5]*Y + M[9]*Z + M[13];
+        Out.Z[Id] = M[2]*X + M[6]*Y + M[10]*Z + M[14];
+    }
+}
+
+/*
+
+  NOTE: Out = Transform * (In, 1) for Count points. In and Out may be the same arrays.
+
+ */
+inline void TransformBatchPoints(m4 Transform, soa_v3 In, soa_v3 Out, u32 Count)
+{
+    f32* M = (f32*)&Transform;
+    u32 Id = 0;
+
+#if defined(__AVX2__)
+    {
+        __m256 M0 = _mm256_set1_ps(M[0]), M1 = _mm256_set1_ps(M[1]), M2 = _mm256_set1_ps(M[2]);
+        __m256 M4 = _mm256_set1_ps(M[4]), M5 = _mm256_set1_ps(M[5]), M6 = _mm256_set1_ps(M[6]);
+        __m256 M8 = _mm256_set1_ps(M[8]), M9 = _mm256_set1_ps(M[9]), M10 = _mm256_set1_ps(M[10]);
+        __m256 M12 = _mm256_set1_ps(M[12]), M13 = _mm256_set1_ps(M[13]), M14 = _mm256_set1_ps(M[14]);
+        for (; Id + 8 <= Count; Id += 8)
+        {
+            __m256 X = _mm256_loadu_ps(In.X + Id);
+            __m256 Y = _mm256_loadu_ps(In.Y + Id);
+            __m256 Z = _mm256_loadu_ps(In.Z + Id);
+            _mm256_storeu_ps(Out.X + Id, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(M0, X), _mm256_mul_ps(M4, Y)), _mm256_add_ps(_mm256_mul_ps(M8, Z), M12)));
+            _mm256_storeu_ps(Out.Y + Id, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(M1, X), _mm256_mul_ps(M5, Y)), _mm256_add_ps(_mm256_mul_ps(M9, Z), M13)));
+            _mm256_storeu_ps(Out.Z + Id, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(M2, X), _mm256_mul_ps(M6, Y)), _mm256_add_ps(_mm256_mul_ps(M10, Z), M14)));
+        }
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    {
+        __m128 M0 = _mm_set1_ps(M[0]), M1 = _mm_set1_ps(M[1]), M2 = _mm_set1_ps(M[2]);
+        __m128 M4 = _mm_set1_ps(M[4]), M5 = _mm_set1_ps(M[5]), M6 = _mm_set1_ps(M[6]);
+        __m128 M8 = _mm_set1_ps(M[8]), M9 = _mm_set1_ps(M[9]), M10 = _mm_set1_ps(M[10]);
+        __m128 M12 = _mm_set1_ps(M[12]), M13 = _mm_set1_ps(M[13]), M14 = _mm_set1_ps(M[14]);
+        for (; Id + 4 <= Count; Id += 4)
+        {
+            __m128 X = _mm_loadu_ps(In.X + Id);
+            __m128 Y = _mm_loadu_ps(In.Y + Id);
+            __m128 Z = _mm_loadu_ps(In.Z + Id);
+            _mm_storeu_ps(Out.X + Id, _mm_add_ps(_mm_add_ps(_mm_mul_ps(M0, X), _mm_mul_ps(M4, Y)), _mm_add_ps(_mm_mul_ps(M8, Z), M12)));
+            _mm_storeu_ps(Out.Y + Id, _mm_add_ps(_mm_add_ps(_mm_mul_ps(M1, X), _mm_mul_ps(M5, Y)), _mm_add_ps(_mm_mul_ps(M9, Z), M13)));
+            _mm_storeu_ps(Out.Z + Id, _mm_add_ps(_mm_add_ps(_mm_mul_ps(M2, X), _mm_mul_ps(M6, Y)), _mm_add_ps(_mm_mul_ps(M10, Z), M14)));
+        }
+    }
+#endif
+
+    TransformBatchPointsScalar(Transform, In, Out, Id, Count);
+}
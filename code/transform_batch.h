@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+
+  NOTE: Batched transforms for the CPU side of the scene. Positions are stored as SoA (one array per component) so the kernels can
+        load 4 (SSE) or 8 (AVX2) entries per component at once and reuse the broadcast matrix for the whole array. The matrix gets
+        read as 16 floats in the same column major order we hand to the shaders.
+
+        The AVX2 path is picked at compile time (-mavx2 / -arch:AVX2), SSE is the baseline on x64 and everything else falls back to
+        the scalar loop. The scalar loop also handles the tail of the SIMD paths.
+
+ */
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+struct soa_v3
+{
+    f32* X;
+    f32* Y;
+    f32* Z;
+};
@@ -1,14 +1,35 @@
 
 #include "under_water_demo.h"
+#include "gpu_profiler.cpp"
+#include "render_graph.cpp"
+#include "frame_staging.cpp"
+#include "upload_ring.cpp"
+#include "dirty_ranges.cpp"
+#include "scene_storage.cpp"
+#include "transform_batch.cpp"
+#include "job_system.cpp"
+#include "pipeline_cache.cpp"
 #include "tiled_deferred.cpp"
 
 //
 // NOTE: Asset Storage System
 //
 
-inline u32 SceneMeshAdd(render_scene* Scene, vk_image Color, vk_image Normal, VkBuffer VertexBuffer, VkBuffer IndexBuffer, u32 NumIndices)
+inline VkDescriptorSet SceneMaterialCreate(render_scene* Scene, vk_image Color, vk_image Normal)
 {
-    Assert(Scene->NumRenderMeshes < Scene->MaxNumRenderMeshes);
+    VkDescriptorSet Result = VkDescriptorSetAllocate(RenderState->Device, RenderState->DescriptorPool, Scene->MaterialDescLayout);
+    VkDescriptorImageWrite(&RenderState->DescriptorManager, Result, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                           Color.View, DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    VkDescriptorImageWrite(&RenderState->DescriptorManager, Result, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                           Normal.View, DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    return Result;
+}
+
+inline u32 SceneMeshAdd(render_scene* Scene, vk_image Color, vk_image Normal, VkBuffer VertexBuffer, VkBuffer IndexBuffer, u32 FirstIndex,
+                        i32 VertexOffset, u32 NumIndices, f32 BoundingRadius)
+{
+    ScenePoolFit(&Scene->MeshPool, Scene->NumRenderMeshes + 1);
     
     u32 MeshId = Scene->NumRenderMeshes++;
     render_mesh* Mesh = Scene->RenderMeshes + MeshId;
@@ -17,64 +38,1039 @@ inline u32 SceneMeshAdd(render_scene* Scene, vk_image Color, vk_image Normal, Vk
     Mesh->VertexBuffer = VertexBuffer;
     Mesh->IndexBuffer = IndexBuffer;
     Mesh->NumIndices = NumIndices;
-    Mesh->MaterialDescriptor = VkDescriptorSetAllocate(RenderState->Device, RenderState->DescriptorPool, Scene->MaterialDescLayout);
-    VkDescriptorImageWrite(&RenderState->DescriptorManager, Mesh->MaterialDescriptor, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                           Color.View, DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    VkDescriptorImageWrite(&RenderState->DescriptorManager, Mesh->MaterialDescriptor, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                           Normal.View, DemoState->PointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    Mesh->FirstIndex = FirstIndex;
+    Mesh->VertexOffset = VertexOffset;
+    Mesh->BoundingRadius = BoundingRadius;
+
+    // NOTE: Meshes with the same textures share their material, so they can end up in the same draw group
+    Mesh->MaterialDescriptor = VK_NULL_HANDLE;
+    for (u32 OtherMeshId = 0; OtherMeshId < MeshId; ++OtherMeshId)
+    {
+        render_mesh* OtherMesh = Scene->RenderMeshes + OtherMeshId;
+        if (OtherMesh->Color.View == Color.View && OtherMesh->Normal.View == Normal.View)
+        {
+            Mesh->MaterialDescriptor = OtherMesh->MaterialDescriptor;
+            break;
+        }
+    }
+
+    if (Mesh->MaterialDescriptor == VK_NULL_HANDLE)
+    {
+        Mesh->MaterialDescriptor = SceneMaterialCreate(Scene, Color, Normal);
+    }
+
+    return MeshId;
+}
+
+inline u32 SceneMeshAdd(render_scene* Scene, vk_image Color, vk_image Normal, procedural_mesh Mesh, f32 BoundingRadius)
+{
+    u32 Result = SceneMeshAdd(Scene, Color, Normal, Mesh.Vertices, Mesh.Indices, 0, 0, Mesh.NumIndices, BoundingRadius);
+    return Result;
+}
+
+inline u32 SceneMeshVariantAdd(render_scene* Scene, u32 BaseMeshId)
+{
+    // NOTE: Same geometry as the base mesh but a material set of its own, so it doesn't get merged into the base meshes draw group
+    ScenePoolFit(&Scene->MeshPool, Scene->NumRenderMeshes + 1);
+
+    u32 Result = Scene->NumRenderMeshes++;
+    render_mesh* Mesh = Scene->RenderMeshes + Result;
+    *Mesh = Scene->RenderMeshes[BaseMeshId];
+    Mesh->MaterialDescriptor = SceneMaterialCreate(Scene, Mesh->Color, Mesh->Normal);
+
+    return Result;
+}
+
+inline void SceneGeometryCreate(render_scene* Scene, linear_arena* Arena)
+{
+    scene_geometry* Geometry = &Scene->Geometry;
+    Geometry->VertexBuffer = VkBufferCreate(RenderState->Device, &RenderState->GpuArena, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                            sizeof(scene_vertex) * SCENE_GEOMETRY_MAX_VERTICES);
+    Geometry->IndexBuffer = VkBufferCreate(RenderState->Device, &RenderState->GpuArena, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           sizeof(u32) * SCENE_GEOMETRY_MAX_INDICES);
+    Geometry->Vertices = PushArray(Arena, scene_vertex, SCENE_GEOMETRY_MAX_VERTICES);
+    Geometry->Indices = PushArray(Arena, u32, SCENE_GEOMETRY_MAX_INDICES);
+}
+
+inline u32 SceneGeometryMeshAdd(render_scene* Scene, vk_image Color, vk_image Normal, u32 NumVertices, u32 NumIndices, f32 BoundingRadius,
+                                scene_vertex** OutVertices, u32** OutIndices)
+{
+    // NOTE: Indices stay relative to the mesh, the draws add the vertex offset
+    scene_geometry* Geometry = &Scene->Geometry;
+    Assert(Geometry->NumVertices + NumVertices <= SCENE_GEOMETRY_MAX_VERTICES);
+    Assert(Geometry->NumIndices + NumIndices <= SCENE_GEOMETRY_MAX_INDICES);
+
+    u32 Result = SceneMeshAdd(Scene, Color, Normal, Geometry->VertexBuffer, Geometry->IndexBuffer, Geometry->NumIndices, i32(Geometry->NumVertices),
+                              NumIndices, BoundingRadius);
+    *OutVertices = Geometry->Vertices + Geometry->NumVertices;
+    *OutIndices = Geometry->Indices + Geometry->NumIndices;
+    Geometry->NumVertices += NumVertices;
+    Geometry->NumIndices += NumIndices;
+
+    return Result;
+}
+
+inline u32 SceneCubeAdd(render_scene* Scene, vk_image Color, vk_image Normal)
+{
+    // NOTE: Spans [-0.5, 0.5], every face gets its own vertices so the normals stay flat
+    v3 FaceNormals[6] = { V3(1, 0, 0), V3(-1, 0, 0), V3(0, 1, 0), V3(0, -1, 0), V3(0, 0, 1), V3(0, 0, -1) };
+    v3 FaceU[6] = { V3(0, 1, 0), V3(0, 0, 1), V3(0, 0, 1), V3(1, 0, 0), V3(1, 0, 0), V3(0, 1, 0) };
+    v3 FaceV[6] = { V3(0, 0, 1), V3(0, 1, 0), V3(1, 0, 0), V3(0, 0, 1), V3(0, 1, 0), V3(1, 0, 0) };
+    
+    scene_vertex* Vertices = 0;
+    u32* Indices = 0;
+    u32 Result = SceneGeometryMeshAdd(Scene, Color, Normal, 6*4, 6*6, 0.8661f, &Vertices, &Indices);
+    for (u32 FaceId = 0; FaceId < 6; ++FaceId)
+    {
+        v2 Corners[4] = { V2(0, 0), V2(1, 0), V2(1, 1), V2(0, 1) };
+        for (u32 CornerId = 0; CornerId < 4; ++CornerId)
+        {
+            v2 Uv = Corners[CornerId];
+            scene_vertex* Vertex = Vertices + 4*FaceId + CornerId;
+            Vertex->Pos = 0.5f*FaceNormals[FaceId] + (Uv.x - 0.5f)*FaceU[FaceId] + (Uv.y - 0.5f)*FaceV[FaceId];
+            Vertex->Normal = FaceNormals[FaceId];
+            Vertex->Uv = Uv;
+        }
+
+        // NOTE: Counter clockwise around the face normal
+        u32* FaceIndices = Indices + 6*FaceId;
+        FaceIndices[0] = 4*FaceId + 0;
+        FaceIndices[1] = 4*FaceId + 1;
+        FaceIndices[2] = 4*FaceId + 2;
+        FaceIndices[3] = 4*FaceId + 0;
+        FaceIndices[4] = 4*FaceId + 2;
+        FaceIndices[5] = 4*FaceId + 3;
+    }
+
+    return Result;
+}
+
+inline u32 SceneSphereAdd(render_scene* Scene, vk_image Color, vk_image Normal, u32 NumLatitude, u32 NumLongitude)
+{
+    // NOTE: Radius 0.5 so it spans [-0.5, 0.5] like the cube. The seam column is duplicated so the uvs wrap cleanly
+    scene_vertex* Vertices = 0;
+    u32* Indices = 0;
+    u32 Result = SceneGeometryMeshAdd(Scene, Color, Normal, (NumLatitude + 1)*(NumLongitude + 1), 6*NumLatitude*NumLongitude, 0.5f,
+                                      &Vertices, &Indices);
+    for (u32 LatId = 0; LatId <= NumLatitude; ++LatId)
+    {
+        f32 Theta = Pi32 * f32(LatId) / f32(NumLatitude);
+        for (u32 LongId = 0; LongId <= NumLongitude; ++LongId)
+        {
+            f32 Phi = 2.0f * Pi32 * f32(LongId) / f32(NumLongitude);
+            scene_vertex* Vertex = Vertices + LatId*(NumLongitude + 1) + LongId;
+            Vertex->Normal = V3(Sin(Theta)*Cos(Phi), Cos(Theta), Sin(Theta)*Sin(Phi));
+            Vertex->Pos = 0.5f*Vertex->Normal;
+            Vertex->Uv = V2(f32(LongId) / f32(NumLongitude), f32(LatId) / f32(NumLatitude));
+        }
+    }
+
+    for (u32 LatId = 0; LatId < NumLatitude; ++LatId)
+    {
+        for (u32 LongId = 0; LongId < NumLongitude; ++LongId)
+        {
+            // NOTE: Counter clockwise seen from the outside
+            u32 Top = LatId*(NumLongitude + 1) + LongId;
+            u32 Bottom = Top + NumLongitude + 1;
+            u32* QuadIndices = Indices + 6*(LatId*NumLongitude + LongId);
+            QuadIndices[0] = Top;
+            QuadIndices[1] = Top + 1;
+            QuadIndices[2] = Bottom;
+            QuadIndices[3] = Top + 1;
+            QuadIndices[4] = Bottom + 1;
+            QuadIndices[5] = Bottom;
+        }
+    }
+
+    return Result;
+}
+
+inline void SceneGeometryUpload(render_scene* Scene)
+{
+    scene_geometry* Geometry = &Scene->Geometry;
+    if (Geometry->NumVertices > 0)
+    {
+        scene_vertex* GpuVertices = VkTransferPushWriteArray(&RenderState->TransferManager, Geometry->VertexBuffer, scene_vertex, Geometry->NumVertices,
+                                                             BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
+                                                             BarrierMask(VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT));
+        Copy(Geometry->Vertices, GpuVertices, sizeof(scene_vertex) * Geometry->NumVertices);
+
+        u32* GpuIndices = VkTransferPushWriteArray(&RenderState->TransferManager, Geometry->IndexBuffer, u32, Geometry->NumIndices,
+                                                   BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
+                                                   BarrierMask(VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT));
+        Copy(Geometry->Indices, GpuIndices, sizeof(u32) * Geometry->NumIndices);
+    }
+}
+
+//
+// NOTE: Retained Scene
+//
+
+inline void SceneHandleTableGrow(scene_handle_table* Table, u32 OldCapacity, u32 NewCapacity)
+{
+    for (u32 HandleId = NewCapacity; HandleId > OldCapacity; --HandleId)
+    {
+        // NOTE: Popped from the back, so the first handles we give out are the low ones
+        Table->FreeHandles[Table->NumFreeHandles++] = HandleId - 1;
+        Table->HandleToIndex[HandleId - 1] = SCENE_INVALID_INDEX;
+    }
+}
+
+inline scene_handle_table SceneHandleTableCreate(scene_pool* Pool)
+{
+    // NOTE: The handles are part of the pool, so they grow with the elements they point at
+    scene_handle_table Result = {};
+    Result.HandleToIndex = ScenePoolArrayPush(Pool, u32);
+    Result.IndexToHandle = ScenePoolArrayPush(Pool, u32);
+    Result.FreeHandles = ScenePoolArrayPush(Pool, u32);
+    Result.NumFreeHandles = 0;
+    SceneHandleTableGrow(&Result, 0, Pool->Capacity);
+
+    return Result;
+}
+
+inline void SceneHandleTableFit(scene_handle_table* Table, scene_pool* Pool, u32 Required)
+{
+    u32 OldCapacity = Pool->Capacity;
+    if (ScenePoolFit(Pool, Required))
+    {
+        SceneHandleTableGrow(Table, OldCapacity, Pool->Capacity);
+    }
+}
+
+inline u32 SceneHandleAlloc(scene_handle_table* Table, u32 Index)
+{
+    Assert(Table->NumFreeHandles > 0);
+    
+    u32 Result = Table->FreeHandles[--Table->NumFreeHandles];
+    Table->HandleToIndex[Result] = Index;
+    Table->IndexToHandle[Index] = Result;
+
+    return Result;
+}
+
+inline u32 SceneHandleIndexGet(scene_handle_table* Table, u32 Handle)
+{
+    u32 Result = Table->HandleToIndex[Handle];
+    Assert(Result != SCENE_INVALID_INDEX);
+    return Result;
+}
+
+inline u32 SceneHandleFree(scene_handle_table* Table, u32 Handle, u32 LastIndex)
+{
+    // NOTE: Returns the hole the element at LastIndex has to be moved into
+    u32 Result = SceneHandleIndexGet(Table, Handle);
+    u32 LastHandle = Table->IndexToHandle[LastIndex];
+    Table->HandleToIndex[LastHandle] = Result;
+    Table->IndexToHandle[Result] = LastHandle;
+    Table->HandleToIndex[Handle] = SCENE_INVALID_INDEX;
+    Table->FreeHandles[Table->NumFreeHandles++] = Handle;
+
+    return Result;
+}
+
+inline u32 SceneOpaqueInstanceCreate(render_scene* Scene, u32 MeshId, m4 WTransform, v4 Color, float SpecularPower, float RimBound,
+                                     float RimThreshold)
+{
+    SceneHandleTableFit(&Scene->OpaqueInstanceHandles, &Scene->OpaqueInstancePool, Scene->NumOpaqueInstances + 1);
+
+    u32 Index = Scene->NumOpaqueInstances++;
+    gpu_instance_entry* Instance = Scene->OpaqueInstances + Index;
+    *Instance = {};
+    Instance->WTransform = WTransform;
+    // NOTE: WVPTransform is written by the instance culling pass on the GPU
+    Instance->MeshId = MeshId;
+    Instance->Color = Color;
+    Instance->SpecularPower = SpecularPower;
+    Instance->RimBound = RimBound;
+    Instance->RimThreshold = RimThreshold;
+
+    Scene->MeshNumInstances[MeshId] += 1;
+    DirtyRangesMark(&Scene->OpaqueInstancesDirty, Index);
+    
+    u32 Result = SceneHandleAlloc(&Scene->OpaqueInstanceHandles, Index);
+    return Result;
+}
+
+inline void SceneOpaqueInstanceUpdate(render_scene* Scene, u32 Handle, m4 WTransform)
+{
+    u32 Index = SceneHandleIndexGet(&Scene->OpaqueInstanceHandles, Handle);
+    Scene->OpaqueInstances[Index].WTransform = WTransform;
+    DirtyRangesMark(&Scene->OpaqueInstancesDirty, Index);
+}
+
+inline void SceneOpaqueInstanceDestroy(render_scene* Scene, u32 Handle)
+{
+    u32 LastIndex = Scene->NumOpaqueInstances - 1;
+    u32 Index = SceneHandleFree(&Scene->OpaqueInstanceHandles, Handle, LastIndex);
+    Scene->MeshNumInstances[Scene->OpaqueInstances[Index].MeshId] -= 1;
+    if (Index != LastIndex)
+    {
+        Scene->OpaqueInstances[Index] = Scene->OpaqueInstances[LastIndex];
+        DirtyRangesMark(&Scene->OpaqueInstancesDirty, Index);
+    }
+    Scene->NumOpaqueInstances -= 1;
+}
+
+inline u32 ScenePointLightCreate(render_scene* Scene, v3 Pos, v3 Color, f32 MaxDistance)
+{
+    SceneHandleTableFit(&Scene->PointLightHandles, &Scene->PointLightPool, Scene->NumPointLights + 1);
+
+    // TODO: Specify strength or a sphere so that we can visualize nicely too?
+    u32 Index = Scene->NumPointLights++;
+    point_light* PointLight = Scene->PointLights + Index;
+    *PointLight = {};
+    PointLight->Pos = Pos;
+    PointLight->Color = Color;
+    PointLight->MaxDistance = MaxDistance;
+    DirtyRangesMark(&Scene->PointLightsDirty, Index);
+
+    u32 Result = SceneHandleAlloc(&Scene->PointLightHandles, Index);
+    return Result;
+}
+
+inline void ScenePointLightUpdate(render_scene* Scene, u32 Handle, v3 Pos)
+{
+    u32 Index = SceneHandleIndexGet(&Scene->PointLightHandles, Handle);
+    Scene->PointLights[Index].Pos = Pos;
+    DirtyRangesMark(&Scene->PointLightsDirty, Index);
+}
+
+inline void ScenePointLightDestroy(render_scene* Scene, u32 Handle)
+{
+    u32 LastIndex = Scene->NumPointLights - 1;
+    u32 Index = SceneHandleFree(&Scene->PointLightHandles, Handle, LastIndex);
+    if (Index != LastIndex)
+    {
+        Scene->PointLights[Index] = Scene->PointLights[LastIndex];
+        DirtyRangesMark(&Scene->PointLightsDirty, Index);
+    }
+    Scene->NumPointLights -= 1;
+}
+
+inline void SceneOpaqueBatchesBuild(render_scene* Scene)
+{
+    // NOTE: Every mesh with live instances gets its own range of the visible instance ids. The culling pass compacts the visible
+    // instances into those, so the instances themselves can stay in any order
+    Scene->NumOpaqueBatches = 0;
+    u32 CurrOffset = 0;
+    for (u32 MeshId = 0; MeshId < Scene->NumRenderMeshes; ++MeshId)
+    {
+        u32 NumInstances = Scene->MeshNumInstances[MeshId];
+        if (NumInstances > 0)
+        {
+            instance_batch* Batch = Scene->OpaqueBatches + Scene->NumOpaqueBatches++;
+            Batch->MeshId = MeshId;
+            Batch->FirstInstance = CurrOffset;
+            Batch->NumInstances = NumInstances;
+        }
+
+        CurrOffset += NumInstances;
+    }
+
+    // NOTE: Consecutive batches that bind the same buffers and material get merged, every group is a single indirect count draw
+    Scene->NumDrawGroups = 0;
+    for (u32 BatchId = 0; BatchId < Scene->NumOpaqueBatches; ++BatchId)
+    {
+        render_mesh* CurrMesh = Scene->RenderMeshes + Scene->OpaqueBatches[BatchId].MeshId;
+        if (Scene->NumDrawGroups > 0)
+        {
+            draw_group* PrevGroup = Scene->DrawGroups + Scene->NumDrawGroups - 1;
+            render_mesh* PrevMesh = Scene->RenderMeshes + Scene->OpaqueBatches[PrevGroup->FirstBatch].MeshId;
+            if (PrevMesh->VertexBuffer == CurrMesh->VertexBuffer && PrevMesh->IndexBuffer == CurrMesh->IndexBuffer &&
+                PrevMesh->MaterialDescriptor == CurrMesh->MaterialDescriptor)
+            {
+                PrevGroup->NumBatches += 1;
+                continue;
+            }
+        }
+
+        draw_group* Group = Scene->DrawGroups + Scene->NumDrawGroups++;
+        Group->FirstBatch = BatchId;
+        Group->NumBatches = 1;
+    }
+}
+
+inline void SceneGpuBufferFit(render_scene* Scene, render_graph* Graph, scene_gpu_buffer* Buffer, u32 GraphResourceId, scene_pool* Pool,
+                              dirty_ranges* Dirty, u32 NumElements)
+{
+    if (Buffer->Capacity >= Pool->Capacity)
+    {
+        return;
+    }
+    
+    // NOTE: Frames in flight may still read the old buffer, it gets freed once they are all done
+    Assert(Scene->NumRetiredBuffers < SCENE_MAX_RETIRED_BUFFERS);
+    scene_retired_buffer* Retired = Scene->RetiredBuffers + Scene->NumRetiredBuffers++;
+    Retired->FrameId = Scene->FrameId;
+    Retired->Memory = Buffer->Memory;
+    Retired->Buffer = Buffer->Buffer;
+
+    // NOTE: The new buffer starts out empty, so everything live gets uploaded again
+    SceneGpuBufferAlloc(Buffer, Pool->Capacity);
+    DirtyRangesMarkRange(Dirty, 0, NumElements);
+    RenderGraphBufferSet(Graph, GraphResourceId, Buffer->Buffer);
+    Scene->BufferVersion += 1;
+}
+
+inline void SceneRetiredBuffersFree(render_scene* Scene)
+{
+    for (u32 RetiredId = 0; RetiredId < Scene->NumRetiredBuffers;)
+    {
+        scene_retired_buffer* Retired = Scene->RetiredBuffers + RetiredId;
+        if (Scene->FrameId - Retired->FrameId >= SCENE_MAX_FRAME_DESCRIPTORS)
+        {
+            vkDestroyBuffer(RenderState->Device, Retired->Buffer, 0);
+            vkFreeMemory(RenderState->Device, Retired->Memory, 0);
+            *Retired = Scene->RetiredBuffers[--Scene->NumRetiredBuffers];
+        }
+        else
+        {
+            RetiredId += 1;
+        }
+    }
+}
+
+inline void SceneUpload(render_scene* Scene, render_graph* Graph, frame_staging* Staging, u32 FrameSlot)
+{
+    Scene->FrameId += 1;
+    SceneRetiredBuffersFree(Scene);
+
+    // NOTE: The GPU buffers follow their pools, growing them re-uploads the live elements into a new buffer
+    SceneGpuBufferFit(Scene, Graph, &Scene->OpaqueInstanceBuffer, Scene->GraphResources.OpaqueInstances, &Scene->OpaqueInstancePool,
+                      &Scene->OpaqueInstancesDirty, Scene->NumOpaqueInstances);
+    SceneGpuBufferFit(Scene, Graph, &Scene->PointLightBuffer, Scene->GraphResources.PointLights, &Scene->PointLightPool,
+                      &Scene->PointLightsDirty, Scene->NumPointLights);
+
+    // NOTE: This frames descriptor set isn't in use anymore (its fence passed), so we can point it at the current buffers
+    if (Scene->FrameDescriptorVersions[FrameSlot] != Scene->BufferVersion)
+    {
+        VkDescriptorSet Descriptor = Scene->FrameDescriptors[FrameSlot];
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Descriptor, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Scene->OpaqueInstanceBuffer.Buffer);
+        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Descriptor, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Scene->PointLightBuffer.Buffer);
+        VkDescriptorManagerFlush(RenderState->Device, &RenderState->DescriptorManager);
+        Scene->FrameDescriptorVersions[FrameSlot] = Scene->BufferVersion;
+    }
+    Scene->SceneDescriptor = Scene->FrameDescriptors[FrameSlot];
+    
+    // NOTE: Only what changed since the last frame gets copied, the buffers are shared by all frames in flight since the queue
+    // runs the copies in order
+    if (DirtyRangesUpload(&Scene->OpaqueInstancesDirty, Staging, Scene->OpaqueInstanceBuffer.Buffer, Scene->OpaqueInstances, sizeof(gpu_instance_entry)))
+    {
+        RenderGraphTransferWrite(Graph, Scene->GraphResources.OpaqueInstances);
+    }
+    
+    if (DirtyRangesUpload(&Scene->PointLightsDirty, Staging, Scene->PointLightBuffer.Buffer, Scene->PointLights, sizeof(point_light)))
+    {
+        RenderGraphTransferWrite(Graph, Scene->GraphResources.PointLights);
+    }
+
+    SceneOpaqueBatchesBuild(Scene);
+}
+
+inline void SceneDirectionalLightSet(render_scene* Scene, v3 LightDir, v3 Color, v3 AmbientColor, v3 BoundsMin, v3 BoundsMax)
+{
+    Scene->DirectionalLight.Dir = LightDir;
+    Scene->DirectionalLight.Color = Color;
+    Scene->DirectionalLight.AmbientColor = AmbientColor;
+}
+
+//
+// NOTE: Demo Code
+//
+
+inline void DemoAllocGlobals(linear_arena* Arena)
+{
+    // IMPORTANT: These are always the top of the program memory
+    DemoState = PushStruct(Arena, demo_state);
+    RenderState = PushStruct(Arena, render_state);
+}
+
+inline void DemoScenePopulate(render_scene* Scene)
+{
+    // NOTE: Add point lights
+    /*
+    ScenePointLightCreate(Scene, V3(0.0f, 0.0f, -1.0f), V3(1.0f, 0.0f, 0.0f), 1);
+    ScenePointLightCreate(Scene, V3(-1.0f, 0.0f, 0.0f), V3(1.0f, 1.0f, 0.0f), 1);
+    ScenePointLightCreate(Scene, V3(0.0f, 1.0f, 1.0f), V3(1.0f, 0.0f, 1.0f), 1);
+    ScenePointLightCreate(Scene, V3(0.0f, -1.0f, 1.0f), V3(0.0f, 1.0f, 1.0f), 1);
+    ScenePointLightCreate(Scene, V3(-1.0f, 0.0f, -1.0f), V3(0.0f, 0.0f, 1.0f), 1);
+    */
+
+    //v3 LightDir = Normalize(V3(0.5f*Sin(T), 0.5f*Cos(T), 0.0f));
+    v3 LightDir = Normalize(V3(0.4f, -1.0f, 0.0f));
+            
+    SceneDirectionalLightSet(Scene, LightDir, V3(1.0f, 1.0f, 1.0f), V3(0.4),
+                             V3(-5.0f, -5.0f, -10.0f), V3(5.0f, 5.0f, 10.0f));
+            
+    // NOTE: Add Instances
+    {
+#if 0
+        i32 NumX = 1;
+        i32 NumY = 1;
+        i32 NumZ = 1;
+        for (i32 Z = -NumZ; Z <= NumZ; ++Z)
+        {
+            for (i32 Y = -NumY; Y <= NumY; ++Y)
+            {
+                for (i32 X = -NumX; X <= NumX; ++X)
+                {
+                    m4 Transform = M4Pos(V3(X, Y, Z)) * M4Scale(V3(0.25f));
+                    SceneOpaqueInstanceCreate(Scene, DemoState->Sphere, Transform, V4(1.0f), 32, 0.716, 0.1);
+                }
+            }
+        }
+#endif
+                
+        SceneOpaqueInstanceCreate(Scene, DemoState->Sphere, M4Pos(V3(0.0f, 0.0f, 0.0f)) * M4Scale(V3(1.0f)), V4(0.3f, 0.3f, 0.9f, 1.0f),
+                                  32, 0.716, 0.1);
+
+        SceneOpaqueInstanceCreate(Scene, DemoState->Cube, M4Pos(V3(0.0f, -3.0f, 0.0f)) * M4Scale(V3(10.0f, 1.0f, 10.0f)), V4(0.2f, 0.2f, 0.7f, 1.0f),
+                                  32, 0.99, 1);
+        SceneOpaqueInstanceCreate(Scene, DemoState->Cube, M4Pos(V3(-3.0f, 0.0f, 0.0f)) * M4Scale(V3(1.0f, 10.0f, 10.0f)), V4(0.2f, 0.2f, 0.7f, 1.0f),
+                                  32, 0.99, 1);
+    }
+}
+
+inline void DemoBenchmarkLightsSync(render_scene* Scene)
+{
+    // NOTE: Lattice of lights filling the scene bounds, 16x16 per layer. Only the lights that got added or removed since the last
+    // frame touch the scene
+    u32 NumLights = Min(DemoState->NumBenchmarkLights, Scene->PointLightPool.MaxCapacity);
+    while (DemoState->NumBenchmarkLightHandles < NumLights)
+    {
+        u32 LightId = DemoState->NumBenchmarkLightHandles;
+        u32 X = LightId % 16;
+        u32 Z = (LightId / 16) % 16;
+        u32 Y = LightId / 256;
+        v3 Pos = V3(-5.0f + 0.66f*f32(X), -2.5f + 0.5f*f32(Y), -5.0f + 0.66f*f32(Z));
+        v3 Color = V3(f32((X + Y) % 2), f32((Z + Y) % 2), f32((X + Z + 1) % 2));
+        DemoState->BenchmarkLightBasePos.X[LightId] = Pos.x;
+        DemoState->BenchmarkLightBasePos.Y[LightId] = Pos.y;
+        DemoState->BenchmarkLightBasePos.Z[LightId] = Pos.z;
+        DemoState->BenchmarkLightHandles[DemoState->NumBenchmarkLightHandles++] = ScenePointLightCreate(Scene, Pos, Color, 1.0f);
+    }
+
+    while (DemoState->NumBenchmarkLightHandles > NumLights)
+    {
+        ScenePointLightDestroy(Scene, DemoState->BenchmarkLightHandles[--DemoState->NumBenchmarkLightHandles]);
+    }
+}
+
+inline void DemoBenchmarkMeshesSync(render_scene* Scene)
+{
+    // NOTE: Alternating sphere and cube variants, one small instance each on a 16x16 grid above the floor. Meshes can't be removed from
+    // the scene, so lowering the count later keeps the ones we have
+    u32 NumMeshes = Min(DemoState->NumBenchmarkMeshes, u32(DEMO_MAX_BENCHMARK_MESHES));
+    if (DemoState->NumBenchmarkMeshesAdded >= NumMeshes)
+    {
+        return;
+    }
+    
+    while (DemoState->NumBenchmarkMeshesAdded < NumMeshes)
+    {
+        u32 BenchmarkId = DemoState->NumBenchmarkMeshesAdded++;
+        u32 MeshId = SceneMeshVariantAdd(Scene, BenchmarkId % 2 == 0 ? DemoState->Sphere : DemoState->Cube);
+        u32 X = BenchmarkId % 16;
+        u32 Z = BenchmarkId / 16;
+        m4 Transform = M4Pos(V3(-4.5f + 0.6f*f32(X), 1.5f, -4.5f + 0.6f*f32(Z))) * M4Scale(V3(0.25f));
+        SceneOpaqueInstanceCreate(Scene, MeshId, Transform, V4(0.9f, 0.5f, 0.2f, 1.0f), 32, 0.716, 0.1);
+    }
+
+    VkDescriptorManagerFlush(RenderState->Device, &RenderState->DescriptorManager);
+}
+
+struct demo_light_animate_job
+{
+    render_scene* Scene;
+    m4 Transform;
+    u32 FirstLight;
+    u32 OnePastLastLight;
+};
+
+JOB_CALLBACK(DemoLightAnimateJob)
+{
+    demo_light_animate_job* Job = (demo_light_animate_job*)Data;
+    render_scene* Scene = Job->Scene;
+    u32 FirstLight = Job->FirstLight;
+    u32 NumLights = Job->OnePastLastLight - FirstLight;
+
+    soa_v3 BasePos = DemoState->BenchmarkLightBasePos;
+    BasePos.X += FirstLight;
+    BasePos.Y += FirstLight;
+    BasePos.Z += FirstLight;
+    soa_v3 Pos = DemoState->BenchmarkLightPos;
+    Pos.X += FirstLight;
+    Pos.Y += FirstLight;
+    Pos.Z += FirstLight;
+    TransformBatchPoints(Job->Transform, BasePos, Pos, NumLights);
+
+    // NOTE: Every light has its own slot, so the jobs never write the same one. The dirty bits are shared, the caller marks those
+    for (u32 LightId = 0; LightId < NumLights; ++LightId)
+    {
+        u32 Index = SceneHandleIndexGet(&Scene->PointLightHandles, DemoState->BenchmarkLightHandles[FirstLight + LightId]);
+        Scene->PointLights[Index].Pos = V3(Pos.X[LightId], Pos.Y[LightId], Pos.Z[LightId]);
+    }
+}
+
+inline void DemoBenchmarkLightsAnimate(render_scene* Scene, f32 FrameTime)
+{
+    u32 NumLights = DemoState->NumBenchmarkLightHandles;
+    if (!DemoState->AnimateBenchmarkLights || NumLights == 0)
+    {
+        return;
+    }
+
+    // NOTE: One transform for the whole lattice, the positions get transformed in batches spread across the workers
+    DemoState->BenchmarkLightTime += FrameTime;
+    f32 T = DemoState->BenchmarkLightTime;
+    m4 Transform = M4Pos(V3(0.0f, 0.5f*Sin(T), 0.0f)) * M4Scale(V3(1.0f + 0.1f*Sin(0.5f*T)));
+
+    job_system* Jobs = &DemoState->Jobs;
+    u32 NumJobs = DemoState->JobsEnabled ? Min(Jobs->NumWorkers, CeilU32(f32(NumLights) / f32(DEMO_LIGHTS_PER_JOB))) : 1;
+    u32 LightsPerJob = CeilU32(f32(NumLights) / f32(NumJobs));
+    demo_light_animate_job JobData[JOB_SYSTEM_MAX_WORKERS];
+    job_counter Counter = {};
+    for (u32 JobId = 0; JobId < NumJobs; ++JobId)
+    {
+        demo_light_animate_job* Job = JobData + JobId;
+        Job->Scene = Scene;
+        Job->Transform = Transform;
+        Job->FirstLight = Min(JobId * LightsPerJob, NumLights);
+        Job->OnePastLastLight = Min(Job->FirstLight + LightsPerJob, NumLights);
+        JobSystemPush(Jobs, 0, DemoLightAnimateJob, Job, &Counter);
+    }
+    JobSystemWait(Jobs, 0, &Counter);
+
+    for (u32 LightId = 0; LightId < NumLights; ++LightId)
+    {
+        DirtyRangesMark(&Scene->PointLightsDirty, SceneHandleIndexGet(&Scene->PointLightHandles, DemoState->BenchmarkLightHandles[LightId]));
+    }
+}
+
+inline void DemoFramesCreate()
+{
+    // NOTE: Our frames submit to the graphics queue, so their pool lives on its family
+    u32 QueueFamilyIndex = DemoState->QueueFamilyIndex;
+    VkCommandPoolCreateInfo PoolCreateInfo = {};
+    PoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    PoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    PoolCreateInfo.queueFamilyIndex = QueueFamilyIndex;
+    VkCheckResult(vkCreateCommandPool(RenderState->Device, &PoolCreateInfo, 0, &DemoState->FrameCommandPool));
+
+    DemoState->NumFramesInFlight = 2;
+    for (u32 FrameId = 0; FrameId < DEMO_MAX_FRAMES_IN_FLIGHT; ++FrameId)
+    {
+        demo_frame* Frame = DemoState->Frames + FrameId;
+        
+        VkCommandBufferAllocateInfo AllocateInfo = {};
+        AllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        AllocateInfo.commandPool = DemoState->FrameCommandPool;
+        AllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        AllocateInfo.commandBufferCount = 1;
+        VkCheckResult(vkAllocateCommandBuffers(RenderState->Device, &AllocateInfo, &Frame->Commands.Buffer));
+
+        // NOTE: Created signaled so the first wait on every frame returns right away
+        VkFenceCreateInfo FenceCreateInfo = {};
+        FenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        FenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        VkCheckResult(vkCreateFence(RenderState->Device, &FenceCreateInfo, 0, &Frame->Commands.Fence));
+
+        VkSemaphoreCreateInfo SemaphoreCreateInfo = {};
+        SemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkCheckResult(vkCreateSemaphore(RenderState->Device, &SemaphoreCreateInfo, 0, &Frame->ImageAvailableSemaphore));
+        VkCheckResult(vkCreateSemaphore(RenderState->Device, &SemaphoreCreateInfo, 0, &Frame->FinishedRenderingSemaphore));
+
+        FrameStagingCreate(&Frame->Staging, DEMO_FRAME_STAGING_SIZE);
+        WorkerCommandBuffersCreate(&Frame->WorkerCommands, DemoState->Jobs.NumWorkers, QueueFamilyIndex);
+    }
+}
+
+inline demo_frame* DemoFrameBegin()
+{
+    // NOTE: Waits for the frame that used this slot NumFramesInFlight frames ago, after that all of its memory is ours again
+    u32 FrameSlot = DemoState->FrameId % DemoState->NumFramesInFlight;
+    demo_frame* Result = DemoState->Frames + FrameSlot;
+    VkCheckResult(vkWaitForFences(RenderState->Device, 1, &Result->Commands.Fence, VK_TRUE, UINT64_MAX));
+    VkCheckResult(vkResetFences(RenderState->Device, 1, &Result->Commands.Fence));
+    FrameStagingReset(&Result->Staging);
+    WorkerCommandBuffersReset(&Result->WorkerCommands);
+    UploadRingRegionBegin(&DemoState->UploadRing, FrameSlot);
+    PipelineCacheFrameBegin(&DemoState->PipelineCache, DemoState->FrameId);
+
+    VkCheckResult(vkResetCommandBuffer(Result->Commands.Buffer, 0));
+    VkCommandBufferBeginInfo BeginInfo = {};
+    BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkCheckResult(vkBeginCommandBuffer(Result->Commands.Buffer, &BeginInfo));
+    
+    return Result;
+}
+
+inline void DemoSwapChainImagesReserve(u32 NumImages)
+{
+    // NOTE: Only ever grows, the old arrays hold handles that got retired already so they can stay behind in the arena
+    if (NumImages > DemoState->SwapChainImageCapacity)
+    {
+        DemoState->SwapChainImages = PushArray(&DemoState->Arena, VkImage, NumImages);
+        DemoState->SwapChainViews = PushArray(&DemoState->Arena, VkImageView, NumImages);
+        DemoState->CopyToSwapFrameBuffers = PushArray(&DemoState->Arena, VkFramebuffer, NumImages);
+        DemoState->SwapChainImageCapacity = NumImages;
+    }
+    DemoState->NumSwapChainImages = NumImages;
+}
+
+inline void DemoCopyToSwapFrameBuffersCreate()
+{
+    for (u32 ImageId = 0; ImageId < DemoState->NumSwapChainImages; ++ImageId)
+    {
+        VkFramebufferCreateInfo CreateInfo = {};
+        CreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        CreateInfo.renderPass = DemoState->CopyToSwapRenderPass;
+        CreateInfo.attachmentCount = 1;
+        CreateInfo.pAttachments = DemoState->SwapChainViews + ImageId;
+        CreateInfo.width = RenderState->WindowWidth;
+        CreateInfo.height = RenderState->WindowHeight;
+        CreateInfo.layers = 1;
+        VkCheckResult(vkCreateFramebuffer(RenderState->Device, &CreateInfo, 0, DemoState->CopyToSwapFrameBuffers + ImageId));
+    }
+}
+
+inline void DemoSwapChainReCreate(u32 Width, u32 Height)
+{
+    // NOTE: Replaces VkSwapChainReCreate, the framework destroys the old swap chain right away which forces a wait on every frame in
+    // flight. We hand the old one in as oldSwapchain so the driver can reuse its memory and retire it instead. The driver can return
+    // more images than we asked for, so they land in our own arrays and never in the framework's. Init creates the first one through
+    // here too, without an old swap chain
+    VkSurfaceCapabilitiesKHR Capabilities;
+    VkCheckResult(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(RenderState->PhysicalDevice, RenderState->WindowSurface, &Capabilities));
+
+    VkExtent2D Extent = Capabilities.currentExtent;
+    if (Extent.width == 0xFFFFFFFF)
+    {
+        Extent.width = Min(Max(Width, Capabilities.minImageExtent.width), Capabilities.maxImageExtent.width);
+        Extent.height = Min(Max(Height, Capabilities.minImageExtent.height), Capabilities.maxImageExtent.height);
+    }
+
+    // NOTE: One image on top of the minimum, so acquire doesn't wait for the presentation engine
+    u32 MinImageCount = Max(DemoState->NumSwapChainImages, Capabilities.minImageCount + 1);
+    if (Capabilities.maxImageCount > 0)
+    {
+        MinImageCount = Min(MinImageCount, Capabilities.maxImageCount);
+    }
+    
+    VkSwapchainKHR OldSwapChain = RenderState->SwapChain;
+    {
+        VkSwapchainCreateInfoKHR CreateInfo = {};
+        CreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+        CreateInfo.surface = RenderState->WindowSurface;
+        CreateInfo.minImageCount = MinImageCount;
+        CreateInfo.imageFormat = RenderState->SwapChainFormat;
+        CreateInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+        CreateInfo.imageExtent = Extent;
+        CreateInfo.imageArrayLayers = 1;
+        CreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        CreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        CreateInfo.preTransform = Capabilities.currentTransform;
+        CreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+        CreateInfo.presentMode = RenderState->PresentMode;
+        CreateInfo.clipped = VK_TRUE;
+        CreateInfo.oldSwapchain = OldSwapChain;
+        VkCheckResult(vkCreateSwapchainKHR(RenderState->Device, &CreateInfo, 0, &RenderState->SwapChain));
+    }
 
-    return MeshId;
+    if (OldSwapChain != VK_NULL_HANDLE)
+    {
+        RenderGraphSwapChainRetire(&DemoState->RenderGraph, OldSwapChain, DemoState->SwapChainViews, DemoState->NumSwapChainImages);
+        for (u32 ImageId = 0; ImageId < DemoState->NumSwapChainImages; ++ImageId)
+        {
+            RenderGraphRetire(&DemoState->RenderGraph, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, DemoState->CopyToSwapFrameBuffers[ImageId]);
+        }
+    }
+
+    u32 NumImages = 0;
+    VkCheckResult(vkGetSwapchainImagesKHR(RenderState->Device, RenderState->SwapChain, &NumImages, 0));
+    DemoSwapChainImagesReserve(NumImages);
+    VkCheckResult(vkGetSwapchainImagesKHR(RenderState->Device, RenderState->SwapChain, &NumImages, DemoState->SwapChainImages));
+    
+    for (u32 ImageId = 0; ImageId < NumImages; ++ImageId)
+    {
+        VkImageViewCreateInfo CreateInfo = {};
+        CreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        CreateInfo.image = DemoState->SwapChainImages[ImageId];
+        CreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        CreateInfo.format = RenderState->SwapChainFormat;
+        CreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        CreateInfo.subresourceRange.levelCount = 1;
+        CreateInfo.subresourceRange.layerCount = 1;
+        VkCheckResult(vkCreateImageView(RenderState->Device, &CreateInfo, 0, DemoState->SwapChainViews + ImageId));
+    }
+
+    RenderState->WindowWidth = Extent.width;
+    RenderState->WindowHeight = Extent.height;
+    DemoCopyToSwapFrameBuffersCreate();
 }
 
-inline u32 SceneMeshAdd(render_scene* Scene, vk_image Color, vk_image Normal, procedural_mesh Mesh)
+//
+// NOTE: Vulkan Init
+//
+
+/*
+
+  NOTE: We create the instance and device ourselves instead of going through VkInit. The headless runner has no window, so nothing
+        here touches a surface unless we have one, and we pick which of the optional features and extensions get enabled (VkInit
+        only enables what the framework needs). Everything the framework's helpers read out of RenderState gets filled in here.
+
+        Graphics and present share one queue family, we skip devices where the graphics family can't present.
+
+ */
+
+inline b32 DemoQueueFamilyFind(VkPhysicalDevice PhysicalDevice, VkSurfaceKHR Surface, u32* OutFamilyIndex)
 {
-    u32 Result = SceneMeshAdd(Scene, Color, Normal, Mesh.Vertices, Mesh.Indices, Mesh.NumIndices);
-    return Result;
+    VkQueueFamilyProperties QueueFamilies[16];
+    u32 NumQueueFamilies = ArrayCount(QueueFamilies);
+    vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &NumQueueFamilies, QueueFamilies);
+    for (u32 FamilyId = 0; FamilyId < NumQueueFamilies; ++FamilyId)
+    {
+        if (!(QueueFamilies[FamilyId].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            continue;
+        }
+
+        VkBool32 CanPresent = VK_TRUE;
+        if (Surface != VK_NULL_HANDLE)
+        {
+            VkCheckResult(vkGetPhysicalDeviceSurfaceSupportKHR(PhysicalDevice, FamilyId, Surface, &CanPresent));
+        }
+
+        if (CanPresent)
+        {
+            *OutFamilyIndex = FamilyId;
+            return true;
+        }
+    }
+
+    return false;
 }
 
-inline void SceneOpaqueInstanceAdd(render_scene* Scene, u32 MeshId, m4 WTransform, v4 Color, float SpecularPower, float RimBound,
-                                   float RimThreshold)
+inline void DemoInstanceCreate(b32 ValidationEnabled)
 {
-    Assert(Scene->NumOpaqueInstances < Scene->MaxNumOpaqueInstances);
+    const char* Extensions[2];
+    u32 NumExtensions = 0;
+#if !HEADLESS
+    Extensions[NumExtensions++] = VK_KHR_SURFACE_EXTENSION_NAME;
+    Extensions[NumExtensions++] = VK_KHR_WIN32_SURFACE_EXTENSION_NAME;
+#endif
 
-    instance_entry* Instance = Scene->OpaqueInstances + Scene->NumOpaqueInstances++;
-    Instance->MeshId = MeshId;
-    Instance->GpuData.WTransform = WTransform;
-    Instance->GpuData.WVPTransform = CameraGetVP(&Scene->Camera)*Instance->GpuData.WTransform;
-    Instance->GpuData.Color = Color;
-    Instance->GpuData.SpecularPower = SpecularPower;
-    Instance->GpuData.RimBound = RimBound;
-    Instance->GpuData.RimThreshold = RimThreshold;
+    // NOTE: Machines without the SDK don't have the validation layer, we run without it there
+    const char* ValidationLayer = "VK_LAYER_KHRONOS_validation";
+    u32 NumLayers = 0;
+    if (ValidationEnabled)
+    {
+        VkLayerProperties Layers[64];
+        u32 NumAvailableLayers = ArrayCount(Layers);
+        vkEnumerateInstanceLayerProperties(&NumAvailableLayers, Layers);
+        for (u32 LayerId = 0; LayerId < NumAvailableLayers; ++LayerId)
+        {
+            if (strcmp(Layers[LayerId].layerName, ValidationLayer) == 0)
+            {
+                NumLayers = 1;
+                break;
+            }
+        }
+    }
+
+    // NOTE: A 1.0 loader fails instance creation for any other version, it doesn't have vkEnumerateInstanceVersion
+    PFN_vkEnumerateInstanceVersion EnumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(0, "vkEnumerateInstanceVersion");
+    
+    VkApplicationInfo AppInfo = {};
+    AppInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    AppInfo.pApplicationName = "under_water_demo";
+    AppInfo.pEngineName = "under_water_demo";
+    AppInfo.apiVersion = EnumerateInstanceVersion ? DEMO_VULKAN_API_VERSION : VK_API_VERSION_1_0;
+    
+    VkInstanceCreateInfo CreateInfo = {};
+    CreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    CreateInfo.pApplicationInfo = &AppInfo;
+    CreateInfo.enabledLayerCount = NumLayers;
+    CreateInfo.ppEnabledLayerNames = &ValidationLayer;
+    CreateInfo.enabledExtensionCount = NumExtensions;
+    CreateInfo.ppEnabledExtensionNames = Extensions;
+    VkCheckResult(vkCreateInstance(&CreateInfo, 0, &RenderState->Instance));
+    
+    VkGetInstanceFunctionPointers();
 }
 
-inline void ScenePointLightAdd(render_scene* Scene, v3 Pos, v3 Color, f32 MaxDistance)
+inline u32 DemoPhysicalDevicePick(VkSurfaceKHR Surface)
 {
-    Assert(Scene->NumPointLights < Scene->MaxNumPointLights);
+    VkPhysicalDevice PhysicalDevices[16];
+    u32 NumPhysicalDevices = ArrayCount(PhysicalDevices);
+    vkEnumeratePhysicalDevices(RenderState->Instance, &NumPhysicalDevices, PhysicalDevices);
 
-    // TODO: Specify strength or a sphere so that we can visualize nicely too?
-    point_light* PointLight = Scene->PointLights + Scene->NumPointLights++;
-    PointLight->Pos = Pos;
-    PointLight->Color = Color;
-    PointLight->MaxDistance = MaxDistance;
+    // NOTE: Discrete GPUs first, then anything that can draw (lavapipe is a CPU device)
+    for (u32 SearchId = 0; SearchId < 2; ++SearchId)
+    {
+        for (u32 DeviceId = 0; DeviceId < NumPhysicalDevices; ++DeviceId)
+        {
+            VkPhysicalDeviceProperties Properties;
+            vkGetPhysicalDeviceProperties(PhysicalDevices[DeviceId], &Properties);
+            if (SearchId == 0 && Properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+            {
+                continue;
+            }
+
+            u32 QueueFamilyIndex = 0;
+            if (DemoQueueFamilyFind(PhysicalDevices[DeviceId], Surface, &QueueFamilyIndex))
+            {
+                RenderState->PhysicalDevice = PhysicalDevices[DeviceId];
+                return QueueFamilyIndex;
+            }
+        }
+    }
+
+    InvalidCodePath;
+    return 0;
 }
 
-inline void SceneDirectionalLightSet(render_scene* Scene, v3 LightDir, v3 Color, v3 AmbientColor, v3 BoundsMin, v3 BoundsMax)
+inline void DemoDeviceCreate(u32 QueueFamilyIndex)
 {
-    Scene->DirectionalLight.Dir = LightDir;
-    Scene->DirectionalLight.Color = Color;
-    Scene->DirectionalLight.AmbientColor = AmbientColor;
+    VkExtensionProperties Available[256];
+    u32 NumAvailable = ArrayCount(Available);
+    vkEnumerateDeviceExtensionProperties(RenderState->PhysicalDevice, 0, &NumAvailable, Available);
+
+    // NOTE: Only the swap chain is required, the others get enabled when the device has them
+    const char* WantedExtensions[] =
+        {
+            "VK_KHR_swapchain",
+            "VK_EXT_shader_viewport_index_layer",
+            "VK_KHR_draw_indirect_count",
+        };
+#if HEADLESS
+    u32 FirstWantedId = 1;
+#else
+    u32 FirstWantedId = 0;
+#endif
+    const char* Extensions[ArrayCount(WantedExtensions)];
+    u32 NumExtensions = 0;
+    for (u32 WantedId = FirstWantedId; WantedId < ArrayCount(WantedExtensions); ++WantedId)
+    {
+        b32 Supported = false;
+        for (u32 AvailableId = 0; AvailableId < NumAvailable && !Supported; ++AvailableId)
+        {
+            Supported = strcmp(Available[AvailableId].extensionName, WantedExtensions[WantedId]) == 0;
+        }
+        Assert(Supported || WantedId != 0);
+
+        if (Supported)
+        {
+            Extensions[NumExtensions++] = WantedExtensions[WantedId];
+            if (strcmp(WantedExtensions[WantedId], "VK_KHR_draw_indirect_count") == 0)
+            {
+                DemoState->DrawIndirectCountEnabled = true;
+            }
+        }
+    }
+
+    // NOTE: Everything the device has, except for bounds checked buffer accesses which cost us on every load and store
+    VkPhysicalDeviceFeatures Features;
+    vkGetPhysicalDeviceFeatures(RenderState->PhysicalDevice, &Features);
+    Features.robustBufferAccess = VK_FALSE;
+    DemoState->DeviceFeatures = Features;
+
+    f32 QueuePriority = 1.0f;
+    VkDeviceQueueCreateInfo QueueCreateInfo = {};
+    QueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    QueueCreateInfo.queueFamilyIndex = QueueFamilyIndex;
+    QueueCreateInfo.queueCount = 1;
+    QueueCreateInfo.pQueuePriorities = &QueuePriority;
+    
+    VkDeviceCreateInfo CreateInfo = {};
+    CreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    CreateInfo.queueCreateInfoCount = 1;
+    CreateInfo.pQueueCreateInfos = &QueueCreateInfo;
+    CreateInfo.enabledExtensionCount = NumExtensions;
+    CreateInfo.ppEnabledExtensionNames = Extensions;
+    CreateInfo.pEnabledFeatures = &Features;
+    VkCheckResult(vkCreateDevice(RenderState->PhysicalDevice, &CreateInfo, 0, &RenderState->Device));
+
+    VkGetDeviceFunctionPointers();
+    vkGetDeviceQueue(RenderState->Device, QueueFamilyIndex, 0, &RenderState->GraphicsQueue);
+    RenderState->PresentQueue = RenderState->GraphicsQueue;
+    DemoState->QueueFamilyIndex = QueueFamilyIndex;
 }
 
-//
-// NOTE: Demo Code
-//
+inline void DemoDeviceResourcesCreate(linear_arena* Arena, u64 StagingBufferSize)
+{
+    // NOTE: Device local memory
+    {
+        VkPhysicalDeviceMemoryProperties MemoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(RenderState->PhysicalDevice, &MemoryProperties);
+        RenderState->LocalMemoryId = 0xFFFFFFFF;
+        for (u32 TypeId = 0; TypeId < MemoryProperties.memoryTypeCount; ++TypeId)
+        {
+            if (MemoryProperties.memoryTypes[TypeId].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+            {
+                RenderState->LocalMemoryId = TypeId;
+                break;
+            }
+        }
+        Assert(RenderState->LocalMemoryId != 0xFFFFFFFF);
 
-inline void DemoAllocGlobals(linear_arena* Arena)
+        RenderState->GpuArena = VkLinearArenaCreate(VkMemoryAllocate(RenderState->Device, RenderState->LocalMemoryId, DEMO_GPU_ARENA_SIZE),
+                                                    DEMO_GPU_ARENA_SIZE);
+    }
+
+    // NOTE: Init commands, they get waited on right after every submit
+    {
+        VkCommandPoolCreateInfo PoolCreateInfo = {};
+        PoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        PoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        PoolCreateInfo.queueFamilyIndex = DemoState->QueueFamilyIndex;
+        VkCommandPool CommandPool;
+        VkCheckResult(vkCreateCommandPool(RenderState->Device, &PoolCreateInfo, 0, &CommandPool));
+
+        VkCommandBufferAllocateInfo AllocateInfo = {};
+        AllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        AllocateInfo.commandPool = CommandPool;
+        AllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        AllocateInfo.commandBufferCount = 1;
+        VkCheckResult(vkAllocateCommandBuffers(RenderState->Device, &AllocateInfo, &RenderState->Commands.Buffer));
+
+        VkFenceCreateInfo FenceCreateInfo = {};
+        FenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkCheckResult(vkCreateFence(RenderState->Device, &FenceCreateInfo, 0, &RenderState->Commands.Fence));
+    }
+
+    // NOTE: The framework's managers, same as VkInit sets them up
+    RenderState->CpuArena = LinearSubArena(Arena, MegaBytes(16));
+    RenderState->TransferManager = VkTransferManagerCreate(RenderState->Device, HostCoherentMemoryTypeGet(0xFFFFFFFF), StagingBufferSize);
+    RenderState->DescriptorManager = VkDescriptorManagerCreate(MegaBytes(1));
+    RenderState->BarrierManager = VkBarrierManagerCreate(&RenderState->CpuArena, 1024);
+}
+
+#if !HEADLESS
+inline void DemoSurfaceFormatPick()
 {
-    // IMPORTANT: These are always the top of the program memory
-    DemoState = PushStruct(Arena, demo_state);
-    RenderState = PushStruct(Arena, render_state);
+    // NOTE: The copy to swap shader writes the values as they are, so we want a UNORM swap chain
+    VkSurfaceFormatKHR Formats[64];
+    u32 NumFormats = ArrayCount(Formats);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(RenderState->PhysicalDevice, RenderState->WindowSurface, &NumFormats, Formats);
+    Assert(NumFormats > 0);
+    
+    RenderState->SwapChainFormat = Formats[0].format == VK_FORMAT_UNDEFINED ? VK_FORMAT_B8G8R8A8_UNORM : Formats[0].format;
+    for (u32 FormatId = 0; FormatId < NumFormats; ++FormatId)
+    {
+        if (Formats[FormatId].format == VK_FORMAT_B8G8R8A8_UNORM)
+        {
+            RenderState->SwapChainFormat = VK_FORMAT_B8G8R8A8_UNORM;
+            break;
+        }
+    }
+
+    // NOTE: FIFO is the only mode every driver has
+    RenderState->PresentMode = VK_PRESENT_MODE_FIFO_KHR;
 }
+#endif
 
 DEMO_INIT(Init)
 {
@@ -91,24 +1087,34 @@ DEMO_INIT(Init)
     // NOTE: Init Vulkan
     {
         {
-            const char* DeviceExtensions[] =
-            {
-                "VK_EXT_shader_viewport_index_layer",
-            };
+            VkGetGlobalFunctionPointers(VulkanLib);
+            DemoInstanceCreate(VALIDATION);
+            
+#if !HEADLESS
+            PFN_vkCreateWin32SurfaceKHR CreateWin32Surface = (PFN_vkCreateWin32SurfaceKHR)vkGetInstanceProcAddr(RenderState->Instance,
+                                                                                                               "vkCreateWin32SurfaceKHR");
+            VkWin32SurfaceCreateInfoKHR SurfaceCreateInfo = {};
+            SurfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+            SurfaceCreateInfo.hinstance = (HINSTANCE)hInstance;
+            SurfaceCreateInfo.hwnd = (HWND)WindowHandle;
+            VkCheckResult(CreateWin32Surface(RenderState->Instance, &SurfaceCreateInfo, 0, &RenderState->WindowSurface));
+#endif
             
-            render_init_params InitParams = {};
-            InitParams.ValidationEnabled = true;
-            InitParams.WindowWidth = WindowWidth;
-            InitParams.WindowHeight = WindowHeight;
-            InitParams.StagingBufferSize = MegaBytes(400);
-            InitParams.DeviceExtensionCount = ArrayCount(DeviceExtensions);
-            InitParams.DeviceExtensions = DeviceExtensions;
-            VkInit(VulkanLib, hInstance, WindowHandle, &DemoState->Arena, &DemoState->TempArena, InitParams);
+            // NOTE: Headless runs have no surface, the device only has to draw
+            DemoDeviceCreate(DemoPhysicalDevicePick(RenderState->WindowSurface));
+            // NOTE: Only init and resize uploads go through the transfer manager, per frame data has its own ring and staging memory
+            DemoDeviceResourcesCreate(&DemoState->Arena, MegaBytes(16));
+            RenderState->WindowWidth = WindowWidth;
+            RenderState->WindowHeight = WindowHeight;
+#if !HEADLESS
+            DemoSurfaceFormatPick();
+#endif
         }
         
         // NOTE: Init descriptor pool
         {
-            VkDescriptorPoolSize Pools[5] = {};
+            // NOTE: Strict ICDs (lavapipe) don't let us over allocate a type, so every type we use has to be listed here
+            VkDescriptorPoolSize Pools[9] = {};
             Pools[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
             Pools[0].descriptorCount = 1000;
             Pools[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
@@ -119,6 +1125,14 @@ DEMO_INIT(Init)
             Pools[3].descriptorCount = 1000;
             Pools[4].type = VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
             Pools[4].descriptorCount = 1000;
+            Pools[5].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            Pools[5].descriptorCount = 1000;
+            Pools[6].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            Pools[6].descriptorCount = 1000;
+            Pools[7].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            Pools[7].descriptorCount = 1000;
+            Pools[8].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            Pools[8].descriptorCount = 1000;
             
             VkDescriptorPoolCreateInfo CreateInfo = {};
             CreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -129,6 +1143,13 @@ DEMO_INIT(Init)
         }
     }
     
+    GpuProfilerCreate(&DemoState->Profiler);
+    RenderGraphCreate(&DemoState->RenderGraph, MegaBytes(512));
+    JobSystemCreate(&DemoState->Jobs, &DemoState->Arena, 0);
+    DemoState->JobsEnabled = true;
+    PipelineCacheCreate(&DemoState->PipelineCache, &DemoState->TempArena, PIPELINE_CACHE_FILE_NAME);
+    DemoFramesCreate();
+    
     // NOTE: Create samplers
     DemoState->PointSampler = VkSamplerCreate(RenderState->Device, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 0.0f);
     DemoState->LinearSampler = VkSamplerCreate(RenderState->Device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 0.0f);
@@ -136,8 +1157,23 @@ DEMO_INIT(Init)
                                                     VK_SAMPLER_MIPMAP_MODE_LINEAR, 0, 0, 5);    
         
     // NOTE: Init render target entries
-    DemoState->SwapChainEntry = RenderTargetSwapChainEntryCreate(RenderState->WindowWidth, RenderState->WindowHeight,
-                                                                 RenderState->SwapChainFormat);
+#if HEADLESS
+    VkFormat OutputFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    VkImageLayout OutputLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    {
+        u64 HeapSize = MegaBytes(64);
+        DemoState->OffscreenArena = VkLinearArenaCreate(VkMemoryAllocate(RenderState->Device, RenderState->LocalMemoryId, HeapSize), HeapSize);
+        RenderTargetEntryReCreate(&DemoState->OffscreenArena, RenderState->WindowWidth, RenderState->WindowHeight, OutputFormat,
+                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+                                  &DemoState->OffscreenImage, &DemoState->OffscreenEntry);
+        DemoSwapChainImagesReserve(1);
+        DemoState->SwapChainImages[0] = DemoState->OffscreenImage;
+        DemoState->SwapChainViews[0] = DemoState->OffscreenEntry.View;
+    }
+#else
+    VkFormat OutputFormat = RenderState->SwapChainFormat;
+    VkImageLayout OutputLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+#endif
 
     // NOTE: Copy To Swap RT
     {
@@ -147,21 +1183,23 @@ DEMO_INIT(Init)
             VkDescriptorLayoutEnd(RenderState->Device, &Builder);
         }
 
-        render_target_builder Builder = RenderTargetBuilderBegin(&DemoState->Arena, &DemoState->TempArena, RenderState->WindowWidth,
-                                                                 RenderState->WindowHeight);
-        RenderTargetAddTarget(&Builder, &DemoState->SwapChainEntry, VkClearColorCreate(0, 0, 0, 1));
-                            
+        // NOTE: The triangle covers every pixel, so nothing has to be loaded or cleared
         vk_render_pass_builder RpBuilder = VkRenderPassBuilderBegin(&DemoState->TempArena);
 
-        u32 ColorId = VkRenderPassAttachmentAdd(&RpBuilder, RenderState->SwapChainFormat, VK_ATTACHMENT_LOAD_OP_CLEAR,
-                                                VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_UNDEFINED,
-                                                VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        u32 ColorId = VkRenderPassAttachmentAdd(&RpBuilder, OutputFormat, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                                VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_UNDEFINED, OutputLayout);
 
         VkRenderPassSubPassBegin(&RpBuilder, VK_PIPELINE_BIND_POINT_GRAPHICS);
         VkRenderPassColorRefAdd(&RpBuilder, ColorId, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
         VkRenderPassSubPassEnd(&RpBuilder);
 
-        DemoState->CopyToSwapTarget = RenderTargetBuilderEnd(&Builder, VkRenderPassBuilderEnd(&RpBuilder, RenderState->Device));
+        DemoState->CopyToSwapRenderPass = VkRenderPassBuilderEnd(&RpBuilder, RenderState->Device);
+#if HEADLESS
+        DemoCopyToSwapFrameBuffersCreate();
+#else
+        // NOTE: The first swap chain, it needs the render pass for its framebuffers
+        DemoSwapChainReCreate(RenderState->WindowWidth, RenderState->WindowHeight);
+#endif
     }
 
     // NOTE: Init scene system
@@ -171,31 +1209,43 @@ DEMO_INIT(Init)
         Scene->Camera = CameraFpsCreate(V3(0, 0, -5), V3(0, 0, 1), f32(RenderState->WindowWidth / RenderState->WindowHeight),
                                         0.01f, 1000.0f, 90.0f, 1.0f, 0.005f);
 
-        Scene->SceneBuffer = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
-                                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                            sizeof(scene_globals));
-
-        Scene->MaxNumRenderMeshes = 1000;
-        Scene->RenderMeshes = PushArray(&DemoState->Arena, render_mesh, Scene->MaxNumRenderMeshes);
+        // NOTE: The pools commit memory as they grow, MeshNumInstances starts out zeroed
+        Scene->MeshPool = ScenePoolCreate(SCENE_INITIAL_CAPACITY, SCENE_MAX_RENDER_MESHES);
+        Scene->RenderMeshes = ScenePoolArrayPush(&Scene->MeshPool, render_mesh);
+        Scene->OpaqueBatches = ScenePoolArrayPush(&Scene->MeshPool, instance_batch);
+        Scene->DrawGroups = ScenePoolArrayPush(&Scene->MeshPool, draw_group);
+        Scene->MeshNumInstances = ScenePoolArrayPush(&Scene->MeshPool, u32);
 
-        Scene->MaxNumOpaqueInstances = 1000;
-        Scene->OpaqueInstances = PushArray(&DemoState->Arena, instance_entry, Scene->MaxNumOpaqueInstances);
-        Scene->OpaqueInstanceBuffer = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
-                                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                                     sizeof(gpu_instance_entry)*Scene->MaxNumOpaqueInstances);
+        Scene->OpaqueInstancePool = ScenePoolCreate(SCENE_INITIAL_CAPACITY, SCENE_MAX_OPAQUE_INSTANCES);
+        Scene->OpaqueInstances = ScenePoolArrayPush(&Scene->OpaqueInstancePool, gpu_instance_entry);
+        Scene->OpaqueInstanceHandles = SceneHandleTableCreate(&Scene->OpaqueInstancePool);
+        Scene->OpaqueInstancesDirty = DirtyRangesCreate(&DemoState->Arena, Scene->OpaqueInstancePool.MaxCapacity);
+        Scene->OpaqueInstanceBuffer = SceneGpuBufferCreate(sizeof(gpu_instance_entry), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                           Scene->OpaqueInstancePool.Capacity);
         
-        Scene->MaxNumPointLights = 1000;
-        Scene->PointLights = PushArray(&DemoState->Arena, point_light, Scene->MaxNumPointLights);
-        Scene->PointLightBuffer = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
-                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                                 sizeof(point_light)*Scene->MaxNumPointLights);
-        Scene->PointLightTransforms = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
-                                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                                     sizeof(m4)*Scene->MaxNumPointLights);
-
-        Scene->DirectionalLightGpu = VkBufferCreate(RenderState->Device, &RenderState->GpuArena,
-                                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                                    sizeof(directional_light));
+        Scene->PointLightPool = ScenePoolCreate(SCENE_INITIAL_CAPACITY, SCENE_MAX_POINT_LIGHTS);
+        Scene->PointLights = ScenePoolArrayPush(&Scene->PointLightPool, point_light);
+        Scene->PointLightHandles = SceneHandleTableCreate(&Scene->PointLightPool);
+        Scene->PointLightsDirty = DirtyRangesCreate(&DemoState->Arena, Scene->PointLightPool.MaxCapacity);
+        Scene->PointLightBuffer = SceneGpuBufferCreate(sizeof(point_light), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                       Scene->PointLightPool.Capacity);
+        DemoState->BenchmarkLightHandles = PushArray(&DemoState->Arena, u32, Scene->PointLightPool.MaxCapacity);
+        DemoState->BenchmarkLightBasePos = SoaV3Create(&DemoState->Arena, Scene->PointLightPool.MaxCapacity);
+        DemoState->BenchmarkLightPos = SoaV3Create(&DemoState->Arena, Scene->PointLightPool.MaxCapacity);
+
+        // NOTE: The per frame scene data lives in the upload ring, every frame moves the descriptors to its own data with dynamic offsets
+        VkDeviceSize SceneRanges[SceneDynamic_Count] = {};
+        SceneRanges[SceneDynamic_Globals] = sizeof(scene_globals);
+        SceneRanges[SceneDynamic_DirectionalLight] = sizeof(directional_light);
+        {
+            // NOTE: The tiled deferred globals are the largest binding we read out of the ring
+            VkDeviceSize MaxRange = sizeof(tiled_deferred_globals);
+            for (u32 BindingId = 0; BindingId < SceneDynamic_Count; ++BindingId)
+            {
+                MaxRange = SceneRanges[BindingId] > MaxRange ? SceneRanges[BindingId] : MaxRange;
+            }
+            UploadRingCreate(&DemoState->UploadRing, DEMO_UPLOAD_RING_REGION_SIZE, DEMO_MAX_FRAMES_IN_FLIGHT + 1, MaxRange);
+        }
         
         // NOTE: Create general descriptor set layouts
         {
@@ -208,29 +1258,50 @@ DEMO_INIT(Init)
 
             {
                 vk_descriptor_layout_builder Builder = VkDescriptorLayoutBegin(&Scene->SceneDescLayout);
-                VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
-                VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
-                VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+                VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
                 VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
                 VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+                VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
                 VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
                 VkDescriptorLayoutAdd(&Builder, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
                 VkDescriptorLayoutEnd(RenderState->Device, &Builder);
             }
         }
 
-        // NOTE: Populate descriptors
-        Scene->SceneDescriptor = VkDescriptorSetAllocate(RenderState->Device, RenderState->DescriptorPool, Scene->SceneDescLayout);
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Scene->SceneDescriptor, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, Scene->SceneBuffer);
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Scene->SceneDescriptor, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Scene->OpaqueInstanceBuffer);
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Scene->SceneDescriptor, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Scene->PointLightBuffer);
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Scene->SceneDescriptor, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Scene->PointLightTransforms);
-        VkDescriptorBufferWrite(&RenderState->DescriptorManager, Scene->SceneDescriptor, 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Scene->DirectionalLightGpu);
+        // NOTE: Populate descriptors, the retained buffers get written by SceneUpload once a frame uses the set
+        for (u32 FrameSlot = 0; FrameSlot < SCENE_MAX_FRAME_DESCRIPTORS; ++FrameSlot)
+        {
+            VkDescriptorSet Descriptor = VkDescriptorSetAllocate(RenderState->Device, RenderState->DescriptorPool, Scene->SceneDescLayout);
+            UploadRingDescriptorWrite(&DemoState->UploadRing, Descriptor, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                                      SceneRanges[SceneDynamic_Globals]);
+            UploadRingDescriptorWrite(&DemoState->UploadRing, Descriptor, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                                      SceneRanges[SceneDynamic_DirectionalLight]);
+            Scene->FrameDescriptors[FrameSlot] = Descriptor;
+        }
+        Scene->BufferVersion = 1;
+        Scene->SceneDescriptor = Scene->FrameDescriptors[0];
+
+        render_graph* Graph = &DemoState->RenderGraph;
+        Scene->GraphResources.OpaqueInstances = RenderGraphBufferImport(Graph, "OpaqueInstances", Scene->OpaqueInstanceBuffer.Buffer);
+        Scene->GraphResources.PointLights = RenderGraphBufferImport(Graph, "PointLights", Scene->PointLightBuffer.Buffer);
     }
 
     // NOTE: Create render data
     DemoState->SwapChainFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-    DemoState->CopyToSwapDesc = VkDescriptorSetAllocate(RenderState->Device, RenderState->DescriptorPool, DemoState->CopyToSwapDescLayout);
+    for (u32 FrameSlot = 0; FrameSlot < TILED_DEFERRED_MAX_FRAME_DESCRIPTORS; ++FrameSlot)
+    {
+        DemoState->CopyToSwapDescs[FrameSlot] = VkDescriptorSetAllocate(RenderState->Device, RenderState->DescriptorPool,
+                                                                        DemoState->CopyToSwapDescLayout);
+    }
+
+    // NOTE: Copy To Swap Pipeline, a fullscreen triangle without vertex input. It gets compiled with the renderer's pipelines
+    {
+        pipeline_graphics_desc Desc = PipelineGraphicsDescBegin("shader_copy_to_swap_vert.spv", DemoState->CopyToSwapRenderPass);
+        Desc.NumColorAttachments = 1;
+        DemoState->CopyToSwapPipeline = PipelineGraphicsAdd(&DemoState->PipelineCache, Desc, "shader_copy_to_swap_frag.spv",
+                                                            &DemoState->CopyToSwapDescLayout, 1);
+    }
+    
     {
         renderer_create_info CreateInfo = {};
         CreateInfo.Width = RenderState->WindowWidth; //710;
@@ -239,12 +1310,9 @@ DEMO_INIT(Init)
         CreateInfo.MaterialDescLayout = DemoState->Scene.MaterialDescLayout;
         CreateInfo.SceneDescLayout = DemoState->Scene.SceneDescLayout;
         CreateInfo.Scene = &DemoState->Scene;
-        TiledDeferredCreate(CreateInfo, &DemoState->CopyToSwapDesc, &DemoState->TiledDeferredState);
+        TiledDeferredCreate(CreateInfo, DemoState->CopyToSwapDescs, &DemoState->TiledDeferredState);
+        DemoState->TiledDeferredState.Jobs = &DemoState->Jobs;
     }
-
-    // NOTE: Copy To Swap FullScreen Pass
-    DemoState->CopyToSwapPass = FullScreenPassCreate("shader_copy_to_swap_frag.spv", "main", &DemoState->CopyToSwapTarget, 1,
-                                                     &DemoState->CopyToSwapDescLayout, 1, &DemoState->CopyToSwapDesc);
     
     // NOTE: Upload assets
     vk_commands Commands = RenderState->Commands;
@@ -281,35 +1349,86 @@ DEMO_INIT(Init)
             Copy(Texels, GpuMemory, ImageSize);
         }
                         
-        // NOTE: Push meshes
-        DemoState->Quad = SceneMeshAdd(Scene, WhiteTexture, WhiteTexture, AssetsPushQuad());
-        DemoState->Cube = SceneMeshAdd(Scene, WhiteTexture, WhiteTexture, AssetsPushCube());
-        DemoState->Sphere = SceneMeshAdd(Scene, WhiteTexture, WhiteTexture, AssetsPushSphere(64, 64));
+        // NOTE: Push meshes. The quad is only used for the fullscreen lighting pass, the instanced meshes live in the shared scene
+        // geometry so they all go out in one draw
+        DemoState->Quad = SceneMeshAdd(Scene, WhiteTexture, WhiteTexture, AssetsPushQuad(), 0.7072f);
+        SceneGeometryCreate(Scene, &DemoState->Arena);
+        DemoState->Cube = SceneCubeAdd(Scene, WhiteTexture, WhiteTexture);
+        DemoState->Sphere = SceneSphereAdd(Scene, WhiteTexture, WhiteTexture, 64, 64);
+        SceneGeometryUpload(Scene);
         TiledDeferredAddMeshes(&DemoState->TiledDeferredState, Scene->RenderMeshes + DemoState->Quad);
+        DemoScenePopulate(Scene);
         
         VkDescriptorManagerFlush(RenderState->Device, &RenderState->DescriptorManager);
         VkTransferManagerFlush(&RenderState->TransferManager, RenderState->Device, RenderState->Commands.Buffer, &RenderState->BarrierManager);
+
+#if HEADLESS
+        // NOTE: Frame timestamps (start + end of the frame, per frame in flight)
+        {
+            VkQueryPoolCreateInfo CreateInfo = {};
+            CreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            CreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            CreateInfo.queryCount = 2 * DEMO_MAX_FRAMES_IN_FLIGHT;
+            VkCheckResult(vkCreateQueryPool(RenderState->Device, &CreateInfo, 0, &DemoState->FrameQueryPool));
+            vkCmdResetQueryPool(Commands.Buffer, DemoState->FrameQueryPool, 0, 2 * DEMO_MAX_FRAMES_IN_FLIGHT);
+
+            VkPhysicalDeviceProperties Properties;
+            vkGetPhysicalDeviceProperties(RenderState->PhysicalDevice, &Properties);
+            DemoState->TimestampPeriod = Properties.limits.timestampPeriod;
+        }
+#endif
     }
     
     VkCommandsSubmit(RenderState->GraphicsQueue, Commands);
+
+    // NOTE: Everything we compile at startup is in the cache now
+    PipelineCacheSave(&DemoState->PipelineCache, &DemoState->TempArena);
+    PipelineCacheWatcherCreate(&DemoState->PipelineCache, &DemoState->Arena);
 }
 
 DEMO_DESTROY(Destroy)
 {
+    // NOTE: Permutations built at runtime only get saved here, so the frames never wait on the file system
+    PipelineCacheBuildFinish(&DemoState->PipelineCache, &DemoState->Jobs);
+    if (DemoState->PipelineCache.Unsaved)
+    {
+        PipelineCacheSave(&DemoState->PipelineCache, &DemoState->TempArena);
+    }
+    PipelineCacheWatcherStop(&DemoState->PipelineCache);
+    JobSystemStop(&DemoState->Jobs);
 }
 
 DEMO_SWAPCHAIN_CHANGE(SwapChainChange)
 {
-    VkCheckResult(vkDeviceWaitIdle(RenderState->Device));
-    VkSwapChainReCreate(&DemoState->TempArena, WindowWidth, WindowHeight, RenderState->PresentMode);
+    // NOTE: Only remembered here, the main loop resizes once before its next frame
+    DemoState->SwapChainResizePending = true;
+    DemoState->SwapChainResizeWidth = WindowWidth;
+    DemoState->SwapChainResizeHeight = WindowHeight;
+}
+
+inline void DemoSwapChainResize()
+{
+    if (!DemoState->SwapChainResizePending)
+    {
+        return;
+    }
+
+    // NOTE: Minimized windows report a zero size, we keep the old swap chain until they come back
+    u32 Width = DemoState->SwapChainResizeWidth;
+    u32 Height = DemoState->SwapChainResizeHeight;
+    if (Width == 0 || Height == 0)
+    {
+        return;
+    }
+    DemoState->SwapChainResizePending = false;
 
-    DemoState->SwapChainEntry.Width = RenderState->WindowWidth;
-    DemoState->SwapChainEntry.Height = RenderState->WindowHeight;
+    // NOTE: Nothing waits for the GPU here. The old swap chain and its views get retired like the rest of our size dependent resources
+    // (light grids, transients, descriptor sets), the frames in flight still present to them
+    DemoSwapChainReCreate(Width, Height);
 
-    DemoState->Scene.Camera.AspectRatio = f32(RenderState->WindowWidth / RenderState->WindowHeight);
+    DemoState->Scene.Camera.AspectRatio = f32(RenderState->WindowWidth) / f32(RenderState->WindowHeight);
     
-    TiledDeferredSwapChainChange(&DemoState->TiledDeferredState, RenderState->WindowWidth, RenderState->WindowHeight,
-                                 DemoState->SwapChainFormat, &DemoState->Scene, &DemoState->CopyToSwapDesc);
+    TiledDeferredSwapChainChange(&DemoState->TiledDeferredState, RenderState->WindowWidth, RenderState->WindowHeight, &DemoState->Scene);
 }
 
 DEMO_CODE_RELOAD(CodeReload)
@@ -322,130 +1441,78 @@ DEMO_CODE_RELOAD(CodeReload)
     VkGetGlobalFunctionPointers(VulkanLib);
     VkGetInstanceFunctionPointers();
     VkGetDeviceFunctionPointers();
+
+    // NOTE: The workers still sit in the loop of the module we got loaded over. They are parked on the semaphore between frames, so
+    // they only have to wake up and return once, then the new threads run the new code. Same for the shader watcher. Pipeline builds
+    // are the only jobs that outlive a frame, they have to be done first
+    PipelineCacheBuildFinish(&DemoState->PipelineCache, &DemoState->Jobs);
+    JobSystemStop(&DemoState->Jobs);
+    JobSystemStart(&DemoState->Jobs);
+    PipelineCacheWatcherStop(&DemoState->PipelineCache);
+    PipelineCacheWatcherStart(&DemoState->PipelineCache);
 }
 
-DEMO_MAIN_LOOP(MainLoop)
+RENDER_GRAPH_PASS_CALLBACK(DemoUploadPass)
 {
-    u32 ImageIndex;
-    VkCheckResult(vkAcquireNextImageKHR(RenderState->Device, RenderState->SwapChain, UINT64_MAX, RenderState->ImageAvailableSemaphore,
-                                        VK_NULL_HANDLE, &ImageIndex));
-    DemoState->SwapChainEntry.View = RenderState->SwapChainViews[ImageIndex];
+    demo_frame* Frame = (demo_frame*)Data;
+    FrameStagingFlush(&Frame->Staging, Commands.Buffer);
+}
 
-    vk_commands Commands = RenderState->Commands;
-    VkCommandsBegin(RenderState->Device, Commands);
+RENDER_GRAPH_PASS_CALLBACK(DemoCopyToSwapPass)
+{
+    // NOTE: The swap chain image isn't a graph resource, so the pass begins its own render pass
+    demo_copy_to_swap_pass* Pass = (demo_copy_to_swap_pass*)Data;
+    VkRenderPassBeginInfo BeginInfo = {};
+    BeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    BeginInfo.renderPass = DemoState->CopyToSwapRenderPass;
+    BeginInfo.framebuffer = Pass->FrameBuffer;
+    BeginInfo.renderArea.extent.width = Pass->Width;
+    BeginInfo.renderArea.extent.height = Pass->Height;
+    vkCmdBeginRenderPass(Commands.Buffer, &BeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    RenderGraphViewPortSet(Commands.Buffer, Pass->Width, Pass->Height);
 
-    // NOTE: Update pipelines
-    VkPipelineUpdateShaders(RenderState->Device, &RenderState->CpuArena, &RenderState->PipelineManager);
+    vk_pipeline* Pipeline = DemoState->CopyToSwapPipeline;
+    vkCmdBindPipeline(Commands.Buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Handle);
+    vkCmdBindDescriptorSets(Commands.Buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Layout, 0, 1, &Pass->Descriptor, 0, 0);
+    vkCmdDraw(Commands.Buffer, 3, 1, 0, 0);
+    
+    vkCmdEndRenderPass(Commands.Buffer);
+}
+
+inline void DemoFrameRecord(demo_frame* Frame, u32 ImageIndex, f32 FrameTime)
+{
+    vk_commands Commands = Frame->Commands;
+    frame_staging* Staging = &Frame->Staging;
+    upload_ring* Ring = &DemoState->UploadRing;
+    GpuProfilerFrameBegin(&DemoState->Profiler, Commands.Buffer);
 
-    RenderTargetUpdateEntries(&DemoState->TempArena, &DemoState->CopyToSwapTarget);
+    u32 FrameSlot = u32(Frame - DemoState->Frames);
+    render_graph* Graph = &DemoState->RenderGraph;
+    RenderGraphBegin(Graph);
     
-    // NOTE: Upload scene data
+    // NOTE: Upload scene data. Most of it goes into the upload ring where the shaders read it directly, the staging pushes get flushed
+    // by the upload pass which declares everything they write
+    RenderGraphPassAdd(Graph, "Upload", DemoUploadPass, Frame);
     {
         render_scene* Scene = &DemoState->Scene;
-        Scene->NumOpaqueInstances = 0;
-        Scene->NumPointLights = 0;
-        CameraUpdate(&Scene->Camera, CurrInput, PrevInput);
-        
-        // NOTE: Populate scene
-        {
-            // NOTE: Add point lights
-            /*
-            ScenePointLightAdd(Scene, V3(0.0f, 0.0f, -1.0f), V3(1.0f, 0.0f, 0.0f), 1);
-            ScenePointLightAdd(Scene, V3(-1.0f, 0.0f, 0.0f), V3(1.0f, 1.0f, 0.0f), 1);
-            ScenePointLightAdd(Scene, V3(0.0f, 1.0f, 1.0f), V3(1.0f, 0.0f, 1.0f), 1);
-            ScenePointLightAdd(Scene, V3(0.0f, -1.0f, 1.0f), V3(0.0f, 1.0f, 1.0f), 1);
-            ScenePointLightAdd(Scene, V3(-1.0f, 0.0f, -1.0f), V3(0.0f, 0.0f, 1.0f), 1);
-            */
-            
-            local_global f32 T = 0.0f;
-            T += 0.001f;
-            if (T > 2.0f * Pi32)
-            {
-                T = 0.0f;
-            }
-
-            //v3 LightDir = Normalize(V3(0.5f*Sin(T), 0.5f*Cos(T), 0.0f));
-            v3 LightDir = Normalize(V3(0.4f, -1.0f, 0.0f));
-            
-            SceneDirectionalLightSet(Scene, LightDir, V3(1.0f, 1.0f, 1.0f), V3(0.4),
-                                     V3(-5.0f, -5.0f, -10.0f), V3(5.0f, 5.0f, 10.0f));
-            
-            // NOTE: Add Instances
-            {
-#if 0
-                i32 NumX = 1;
-                i32 NumY = 1;
-                i32 NumZ = 1;
-                for (i32 Z = -NumZ; Z <= NumZ; ++Z)
-                {
-                    for (i32 Y = -NumY; Y <= NumY; ++Y)
-                    {
-                        for (i32 X = -NumX; X <= NumX; ++X)
-                        {
-                            m4 Transform = M4Pos(V3(X, Y, Z)) * M4Scale(V3(0.25f));
-                            SceneOpaqueInstanceAdd(Scene, DemoState->Sphere, Transform);
-                        }
-                    }
-                }
-#endif
-                
-                SceneOpaqueInstanceAdd(Scene, DemoState->Sphere, M4Pos(V3(0.0f, 0.0f, 0.0f)) * M4Scale(V3(1.0f)), V4(0.3f, 0.3f, 0.9f, 1.0f),
-                                       32, 0.716, 0.1);
-
-                SceneOpaqueInstanceAdd(Scene, DemoState->Cube, M4Pos(V3(0.0f, -3.0f, 0.0f)) * M4Scale(V3(10.0f, 1.0f, 10.0f)), V4(0.2f, 0.2f, 0.7f, 1.0f),
-                                       32, 0.99, 1);
-                SceneOpaqueInstanceAdd(Scene, DemoState->Cube, M4Pos(V3(-3.0f, 0.0f, 0.0f)) * M4Scale(V3(1.0f, 10.0f, 10.0f)), V4(0.2f, 0.2f, 0.7f, 1.0f),
-                                       32, 0.99, 1);
-            }
-        }        
+        DemoBenchmarkLightsSync(Scene);
+        DemoBenchmarkMeshesSync(Scene);
+        DemoBenchmarkLightsAnimate(Scene, FrameTime);
+        SceneUpload(Scene, Graph, Staging, FrameSlot);
 
-        // NOTE: Push opaque instances
-        if (Scene->NumOpaqueInstances > 0)
-        {
-            gpu_instance_entry* GpuData = VkTransferPushWriteArray(&RenderState->TransferManager, Scene->OpaqueInstanceBuffer, gpu_instance_entry, Scene->NumOpaqueInstances,
-                                                                   BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
-                                                                   BarrierMask(VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT));
-
-            for (u32 InstanceId = 0; InstanceId < Scene->NumOpaqueInstances; ++InstanceId)
-            {
-                GpuData[InstanceId] = Scene->OpaqueInstances[InstanceId].GpuData;
-            }
-        }
+        // NOTE: Resize the light index lists from the counters read back a few frames ago before the globals get their capacity
+        TiledDeferredLightListsUpdate(&DemoState->TiledDeferredState);
+        TiledDeferredUpload(&DemoState->TiledDeferredState, Scene, Graph, Staging, Ring);
         
-        // NOTE: Push Point Lights
-        if (Scene->NumPointLights > 0)
-        {
-            point_light* PointLights = VkTransferPushWriteArray(&RenderState->TransferManager, Scene->PointLightBuffer, point_light, Scene->NumPointLights,
-                                                                BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
-                                                                BarrierMask(VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT));
-            m4* Transforms = VkTransferPushWriteArray(&RenderState->TransferManager, Scene->PointLightTransforms, m4, Scene->NumPointLights,
-                                                      BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
-                                                      BarrierMask(VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT));
-
-            for (u32 LightId = 0; LightId < Scene->NumPointLights; ++LightId)
-            {
-                point_light* CurrLight = Scene->PointLights + LightId;
-                PointLights[LightId] = *CurrLight;
-                // NOTE: Convert to view space
-                v4 Test = CameraGetV(&Scene->Camera) * V4(CurrLight->Pos, 1.0f);
-                PointLights[LightId].Pos = (CameraGetV(&Scene->Camera) * V4(CurrLight->Pos, 1.0f)).xyz;
-                Transforms[LightId] = CameraGetVP(&Scene->Camera) * M4Pos(CurrLight->Pos) * M4Scale(V3(CurrLight->MaxDistance));
-            }
-        }
-
         // NOTE: Push Directional Lights
         {
-            directional_light* GpuData = VkTransferPushWriteStruct(&RenderState->TransferManager, Scene->DirectionalLightGpu, directional_light,
-                                                                   BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
-                                                                   BarrierMask(VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT));
+            directional_light* GpuData = UploadRingPushStruct(Ring, directional_light, Scene->DynamicOffsets + SceneDynamic_DirectionalLight);
             Copy(&Scene->DirectionalLight, GpuData, sizeof(directional_light));
         }
 
         // NOTE: Push Scene Globals
         {
-            scene_globals* Data = VkTransferPushWriteStruct(&RenderState->TransferManager, Scene->SceneBuffer, scene_globals,
-                                                            BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
-                                                            BarrierMask(VK_ACCESS_UNIFORM_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT));
+            scene_globals* Data = UploadRingPushStruct(Ring, scene_globals, Scene->DynamicOffsets + SceneDynamic_Globals);
             *Data = {};
             Data->CameraPos = Scene->Camera.Pos;
             Data->NumPointLights = Scene->NumPointLights;
@@ -455,23 +1522,73 @@ DEMO_MAIN_LOOP(MainLoop)
         {
             local_global f32 T = 0.0f;
             
-            gpu_caustics_input_buffer* Data = VkTransferPushWriteStruct(&RenderState->TransferManager, DemoState->TiledDeferredState.CausticsInputBuffer, gpu_caustics_input_buffer,
-                                                                        BarrierMask(VkAccessFlagBits(0), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
-                                                                        BarrierMask(VK_ACCESS_UNIFORM_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT));
+            gpu_caustics_input_buffer* Data = UploadRingPushStruct(Ring, gpu_caustics_input_buffer, &DemoState->TiledDeferredState.CausticsInputOffset);
             *Data = {};
             Data->Time = T;
 
             T += FrameTime;
         }
-        
-        VkTransferManagerFlush(&RenderState->TransferManager, RenderState->Device, RenderState->Commands.Buffer, &RenderState->BarrierManager);
     }
 
     // NOTE: Render Scene
-    TiledDeferredRender(Commands, &DemoState->TiledDeferredState, &DemoState->Scene);
-    FullScreenPassRender(Commands, &DemoState->CopyToSwapPass);
+    tiled_deferred_state* TiledDeferredState = &DemoState->TiledDeferredState;
+    TiledDeferredState->WorkerCommands = &Frame->WorkerCommands;
+    TiledDeferredGraphBuild(Graph, TiledDeferredState, &DemoState->Scene);
+
+    // NOTE: The swap chain image isn't tracked by the graph, the copy pass keeps its own render pass
+    demo_copy_to_swap_pass* CopyToSwapPass = DemoState->CopyToSwapPasses + FrameSlot;
+    CopyToSwapPass->FrameBuffer = DemoState->CopyToSwapFrameBuffers[ImageIndex];
+    CopyToSwapPass->Descriptor = DemoState->CopyToSwapDescs[FrameSlot];
+    CopyToSwapPass->Width = RenderState->WindowWidth;
+    CopyToSwapPass->Height = RenderState->WindowHeight;
+    RenderGraphPassAdd(Graph, "CopyToSwap", DemoCopyToSwapPass, CopyToSwapPass);
+    RenderGraphImageRead(Graph, TiledDeferredState->GraphResources.OutColor, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    RenderGraphCompile(Graph);
+    TiledDeferredTransientsBind(TiledDeferredState, Graph);
+    TiledDeferredDescriptorsSync(TiledDeferredState, FrameSlot);
+    RenderGraphExecute(Graph, Commands, &DemoState->Profiler);
+    TiledDeferredFrameEnd(TiledDeferredState);
+
+    GpuProfilerFrameEnd(&DemoState->Profiler);
+}
+
+DEMO_MAIN_LOOP(MainLoop)
+{
+    DemoSwapChainResize();
+    TiledDeferredTileSizeUpdate(&DemoState->TiledDeferredState, &DemoState->Scene);
+    TiledDeferredTileTuneUpdate(&DemoState->TiledDeferredState, &DemoState->Profiler, &DemoState->Scene);
+    demo_frame* Frame = DemoFrameBegin();
     
-    VkCheckResult(vkEndCommandBuffer(Commands.Buffer));
+    u32 ImageIndex;
+    VkResult AcquireResult = vkAcquireNextImageKHR(RenderState->Device, RenderState->SwapChain, UINT64_MAX, Frame->ImageAvailableSemaphore,
+                                                   VK_NULL_HANDLE, &ImageIndex);
+    if (AcquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        // NOTE: Nothing got acquired so the semaphore isn't signaled. We still submit the empty command buffer so the fence of this slot
+        // gets signaled for the next time we wait on it, and resize before the next frame
+        DemoState->SwapChainResizePending = true;
+        DemoState->SwapChainResizeWidth = RenderState->WindowWidth;
+        DemoState->SwapChainResizeHeight = RenderState->WindowHeight;
+        
+        VkCheckResult(vkEndCommandBuffer(Frame->Commands.Buffer));
+        VkSubmitInfo SubmitInfo = {};
+        SubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        SubmitInfo.commandBufferCount = 1;
+        SubmitInfo.pCommandBuffers = &Frame->Commands.Buffer;
+        VkCheckResult(vkQueueSubmit(RenderState->GraphicsQueue, 1, &SubmitInfo, Frame->Commands.Fence));
+        return;
+    }
+    else if (AcquireResult != VK_SUBOPTIMAL_KHR)
+    {
+        VkCheckResult(AcquireResult);
+    }
+
+    CameraUpdate(&DemoState->Scene.Camera, CurrInput, PrevInput);
+    DemoFrameRecord(Frame, ImageIndex, FrameTime);
+    
+    VkCheckResult(vkEndCommandBuffer(Frame->Commands.Buffer));
                     
     // NOTE: Render to our window surface
     // NOTE: Tell queue where we render to surface to wait
@@ -479,18 +1596,19 @@ DEMO_MAIN_LOOP(MainLoop)
     VkSubmitInfo SubmitInfo = {};
     SubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     SubmitInfo.waitSemaphoreCount = 1;
-    SubmitInfo.pWaitSemaphores = &RenderState->ImageAvailableSemaphore;
+    SubmitInfo.pWaitSemaphores = &Frame->ImageAvailableSemaphore;
     SubmitInfo.pWaitDstStageMask = &WaitDstMask;
     SubmitInfo.commandBufferCount = 1;
-    SubmitInfo.pCommandBuffers = &Commands.Buffer;
+    SubmitInfo.pCommandBuffers = &Frame->Commands.Buffer;
     SubmitInfo.signalSemaphoreCount = 1;
-    SubmitInfo.pSignalSemaphores = &RenderState->FinishedRenderingSemaphore;
-    VkCheckResult(vkQueueSubmit(RenderState->GraphicsQueue, 1, &SubmitInfo, Commands.Fence));
+    SubmitInfo.pSignalSemaphores = &Frame->FinishedRenderingSemaphore;
+    VkCheckResult(vkQueueSubmit(RenderState->GraphicsQueue, 1, &SubmitInfo, Frame->Commands.Fence));
+    DemoState->FrameId += 1;
     
     VkPresentInfoKHR PresentInfo = {};
     PresentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     PresentInfo.waitSemaphoreCount = 1;
-    PresentInfo.pWaitSemaphores = &RenderState->FinishedRenderingSemaphore;
+    PresentInfo.pWaitSemaphores = &Frame->FinishedRenderingSemaphore;
     PresentInfo.swapchainCount = 1;
     PresentInfo.pSwapchains = &RenderState->SwapChain;
     PresentInfo.pImageIndices = &ImageIndex;
@@ -505,8 +1623,13 @@ DEMO_MAIN_LOOP(MainLoop)
         case VK_ERROR_OUT_OF_DATE_KHR:
         case VK_SUBOPTIMAL_KHR:
         {
-            // NOTE: Window size changed
-            InvalidCodePath;
+            // NOTE: Window size changed, if the platform didn't tell us yet we recreate at the last size we know of
+            if (!DemoState->SwapChainResizePending)
+            {
+                DemoState->SwapChainResizePending = true;
+                DemoState->SwapChainResizeWidth = RenderState->WindowWidth;
+                DemoState->SwapChainResizeHeight = RenderState->WindowHeight;
+            }
         } break;
 
         default:
@@ -515,3 +1638,88 @@ DEMO_MAIN_LOOP(MainLoop)
         } break;
     }
 }
+
+#if HEADLESS
+
+//
+// NOTE: Headless Benchmark Path
+//
+
+inline void HeadlessCameraScript(camera* Camera, u32 FrameId)
+{
+    // NOTE: Deterministic orbit around the scene so every run renders the same frames
+    f32 Angle = 2.0f * Pi32 * f32(FrameId % 600) / 600.0f;
+    f32 Radius = 6.0f;
+    v3 Pos = V3(Radius * Sin(Angle), 1.0f, -Radius * Cos(Angle));
+    v3 View = Normalize(V3(0.0f, -0.5f, 0.0f) - Pos);
+    *Camera = CameraFpsCreate(Pos, View, f32(RenderState->WindowWidth) / f32(RenderState->WindowHeight),
+                              0.01f, 1000.0f, 90.0f, 1.0f, 0.005f);
+}
+
+inline f32 HeadlessGpuFrameTimeGet(u32 FrameId)
+{
+    // NOTE: Returns the GPU time of the given frame in ms, or -1 if its timestamps aren't there (never submitted or already overwritten)
+    f32 Result = -1.0f;
+    if (FrameId < DemoState->FrameId && DemoState->FrameId - FrameId <= DemoState->NumFramesInFlight)
+    {
+        u32 FirstQuery = 2 * (FrameId % DemoState->NumFramesInFlight);
+        u64 Timestamps[2] = {};
+        VkResult QueryResult = vkGetQueryPoolResults(RenderState->Device, DemoState->FrameQueryPool, FirstQuery, 2, sizeof(Timestamps), Timestamps,
+                                                     sizeof(u64), VK_QUERY_RESULT_64_BIT);
+        if (QueryResult == VK_SUCCESS)
+        {
+            Result = f32(f64(Timestamps[1] - Timestamps[0]) * f64(DemoState->TimestampPeriod) / 1000000.0);
+        }
+    }
+
+    return Result;
+}
+
+/*
+
+  NOTE: Renders one frame into the offscreen target. DemoFrameBegin waits on the fence of the frame that used this slot before, so by
+        the time we read its timestamps they are already available and we never stall on the query. Returns the GPU time of that
+        frame (NumFramesInFlight frames ago).
+  
+ */
+inline f32 HeadlessMainLoop(f32 FrameTime)
+{
+    TiledDeferredTileSizeUpdate(&DemoState->TiledDeferredState, &DemoState->Scene);
+    TiledDeferredTileTuneUpdate(&DemoState->TiledDeferredState, &DemoState->Profiler, &DemoState->Scene);
+    demo_frame* Frame = DemoFrameBegin();
+    vk_commands Commands = Frame->Commands;
+
+    u32 FirstQuery = 2 * (DemoState->FrameId % DemoState->NumFramesInFlight);
+    f32 Result = -1.0f;
+    if (DemoState->FrameId >= DemoState->NumFramesInFlight)
+    {
+        Result = HeadlessGpuFrameTimeGet(DemoState->FrameId - DemoState->NumFramesInFlight);
+    }
+    
+    vkCmdResetQueryPool(Commands.Buffer, DemoState->FrameQueryPool, FirstQuery, 2);
+    vkCmdWriteTimestamp(Commands.Buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, DemoState->FrameQueryPool, FirstQuery + 0);
+
+    HeadlessCameraScript(&DemoState->Scene.Camera, DemoState->FrameId);
+    DemoFrameRecord(Frame, 0, FrameTime);
+
+    vkCmdWriteTimestamp(Commands.Buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, DemoState->FrameQueryPool, FirstQuery + 1);
+    VkCheckResult(vkEndCommandBuffer(Commands.Buffer));
+
+    VkSubmitInfo SubmitInfo = {};
+    SubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    SubmitInfo.commandBufferCount = 1;
+    SubmitInfo.pCommandBuffers = &Commands.Buffer;
+    VkCheckResult(vkQueueSubmit(RenderState->GraphicsQueue, 1, &SubmitInfo, Commands.Fence));
+
+    DemoState->FrameId += 1;
+    
+    return Result;
+}
+
+inline void HeadlessFinish()
+{
+    // NOTE: Drains the queue, the last NumFramesInFlight frame times can be read with HeadlessGpuFrameTimeGet after this
+    VkCheckResult(vkDeviceWaitIdle(RenderState->Device));
+}
+
+#endif
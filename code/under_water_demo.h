@@ -2,7 +2,11 @@
 
 #define VALIDATION 1
 
-#include "framework_vulkan\framework_vulkan.h"
+// NOTE: The apiVersion we create the instance with (see DemoInstanceCreate). What a device can use is capped at the lower of this and
+// its own version
+#define DEMO_VULKAN_API_VERSION VK_API_VERSION_1_1
+
+#include "framework_vulkan/framework_vulkan.h"
 
 /*
 
@@ -47,13 +51,21 @@ struct gpu_instance_entry
     float SpecularPower;
     float RimBound;
     float RimThreshold;
-    u32 Pad;
+    u32 MeshId;
 };
 
-struct instance_entry
+struct instance_batch
 {
     u32 MeshId;
-    gpu_instance_entry GpuData;
+    u32 FirstInstance;
+    u32 NumInstances;
+};
+
+// NOTE: Consecutive batches that share their buffers and material, the whole group goes out as one indirect count draw
+struct draw_group
+{
+    u32 FirstBatch;
+    u32 NumBatches;
 };
 
 struct render_mesh
@@ -65,6 +77,31 @@ struct render_mesh
     VkBuffer VertexBuffer;
     VkBuffer IndexBuffer;
     u32 NumIndices;
+    u32 FirstIndex;
+    i32 VertexOffset;
+
+    // NOTE: Object space bounding sphere around the origin, used for GPU frustum culling
+    f32 BoundingRadius;
+};
+
+// NOTE: Vertex layout of the GBuffer pipelines
+struct scene_vertex
+{
+    v3 Pos;
+    v3 Normal;
+    v2 Uv;
+};
+
+// NOTE: One vertex and index buffer that all the scene meshes get suballocated from, so they can share a draw
+struct scene_geometry
+{
+    VkBuffer VertexBuffer;
+    VkBuffer IndexBuffer;
+
+    u32 NumVertices;
+    u32 NumIndices;
+    scene_vertex* Vertices;
+    u32* Indices;
 };
 
 struct render_scene;
@@ -79,37 +116,133 @@ struct renderer_create_info
     render_scene* Scene;
 };
 
+#include "gpu_profiler.h"
+#include "render_graph.h"
+#include "frame_staging.h"
+#include "upload_ring.h"
+#include "dirty_ranges.h"
+#include "scene_storage.h"
+#include "transform_batch.h"
+#include "job_system.h"
+#include "pipeline_cache.h"
 #include "tiled_deferred.h"
 
+// NOTE: Per frame scene data read out of the upload ring, one dynamic offset per binding (in binding order)
+enum scene_dynamic_binding
+{
+    SceneDynamic_Globals,
+    SceneDynamic_DirectionalLight,
+
+    SceneDynamic_Count,
+};
+
+// NOTE: Render graph ids of the retained scene buffers (the per frame data is host written)
+struct scene_graph_resources
+{
+    u32 OpaqueInstances;
+    u32 PointLights;
+};
+
+#define SCENE_INVALID_INDEX 0xFFFFFFFF
+
+// NOTE: Handles stay the same while the objects move around in their dense arrays (destroy moves the last one into the hole)
+struct scene_handle_table
+{
+    u32* HandleToIndex;
+    u32* IndexToHandle;
+    u32 NumFreeHandles;
+    u32* FreeHandles;
+};
+
 struct render_scene
 {
     // NOTE: General Render Data
     camera Camera;
     VkDescriptorSetLayout MaterialDescLayout;
     VkDescriptorSetLayout SceneDescLayout;
-    VkBuffer SceneBuffer;
-    VkDescriptorSet SceneDescriptor;
+    VkDescriptorSet SceneDescriptor; // NOTE: The set of the frame we are recording
+    u32 DynamicOffsets[SceneDynamic_Count]; // NOTE: This frame's data in the upload ring
+
+    // NOTE: One descriptor set per frame in flight, a set gets rewritten when the buffers changed since it was last used
+    u32 FrameId;
+    u32 BufferVersion;
+    VkDescriptorSet FrameDescriptors[SCENE_MAX_FRAME_DESCRIPTORS];
+    u32 FrameDescriptorVersions[SCENE_MAX_FRAME_DESCRIPTORS];
+    u32 NumRetiredBuffers;
+    scene_retired_buffer RetiredBuffers[SCENE_MAX_RETIRED_BUFFERS];
 
-    // NOTE: Scene Lights
-    u32 MaxNumPointLights;
+    // NOTE: Scene Lights (retained, in world space)
+    scene_pool PointLightPool;
     u32 NumPointLights;
     point_light* PointLights;
-    VkBuffer PointLightBuffer;
-    VkBuffer PointLightTransforms;
+    scene_handle_table PointLightHandles;
+    dirty_ranges PointLightsDirty;
+    scene_gpu_buffer PointLightBuffer;
 
     directional_light DirectionalLight;
-    VkBuffer DirectionalLightGpu;
     
     // NOTE: Scene Meshes
-    u32 MaxNumRenderMeshes;
+    scene_pool MeshPool;
     u32 NumRenderMeshes;
     render_mesh* RenderMeshes;
+    scene_geometry Geometry;
     
-    // NOTE: Opaque Instances
-    u32 MaxNumOpaqueInstances;
+    // NOTE: Opaque Instances (retained, the WVP transforms get written by the culling pass on the GPU)
+    scene_pool OpaqueInstancePool;
     u32 NumOpaqueInstances;
-    instance_entry* OpaqueInstances;
-    VkBuffer OpaqueInstanceBuffer;
+    gpu_instance_entry* OpaqueInstances;
+    scene_handle_table OpaqueInstanceHandles;
+    dirty_ranges OpaqueInstancesDirty;
+    scene_gpu_buffer OpaqueInstanceBuffer;
+
+    // NOTE: Live instances per mesh (part of the mesh pool), the batches get rebuilt from these every frame
+    u32* MeshNumInstances;
+    u32 NumOpaqueBatches;
+    instance_batch* OpaqueBatches;
+    u32 NumDrawGroups;
+    draw_group* DrawGroups;
+
+    scene_graph_resources GraphResources;
+};
+
+// NOTE: Everything the CPU touches while recording a frame is owned by one of these, so we can record the next frame while the GPU still
+// renders up to DEMO_MAX_FRAMES_IN_FLIGHT - 1 older ones
+#define DEMO_MAX_FRAMES_IN_FLIGHT 3
+#define DEMO_FRAME_STAGING_SIZE MegaBytes(1)
+#define DEMO_UPLOAD_RING_REGION_SIZE MegaBytes(1)
+// NOTE: Device local memory for the retained buffers and textures, the transients and light grids have their own
+#define DEMO_GPU_ARENA_SIZE MegaBytes(256)
+#define DEMO_LIGHTS_PER_JOB 1024
+// NOTE: Every benchmark mesh has its own material, so it is its own draw group. Bounded by the material sets the descriptor pool holds
+#define DEMO_MAX_BENCHMARK_MESHES 256
+// NOTE: Extra upload ring region for uploads outside of the frame loop (init), these run with the device idle
+#define DEMO_UPLOAD_RING_SETUP_REGION DEMO_MAX_FRAMES_IN_FLIGHT
+
+// NOTE: Readbacks are read LATENCY frames after they got recorded, by then that frame has to be done
+static_assert(DEMO_MAX_FRAMES_IN_FLIGHT <= PIPELINE_RETIRE_FRAMES, "Hot reload would destroy a pipeline that is still in flight");
+static_assert(DEMO_MAX_FRAMES_IN_FLIGHT <= SCENE_MAX_FRAME_DESCRIPTORS, "Frames in flight would share a scene descriptor set");
+static_assert(DEMO_MAX_FRAMES_IN_FLIGHT <= LIGHT_LIST_READBACK_LATENCY, "Light list readback would read a frame that is still in flight");
+static_assert(DEMO_MAX_FRAMES_IN_FLIGHT <= GPU_PROFILER_FRAME_LATENCY, "Profiler would read timestamps of a frame that is still in flight");
+static_assert(DEMO_MAX_FRAMES_IN_FLIGHT <= TILED_DEFERRED_RETIRE_FRAMES, "Resize would destroy light grid resources that are still in flight");
+static_assert(DEMO_MAX_FRAMES_IN_FLIGHT <= TILED_DEFERRED_MAX_FRAME_DESCRIPTORS, "Frames in flight would share a tiled deferred descriptor set");
+static_assert(DEMO_MAX_FRAMES_IN_FLIGHT <= RENDER_GRAPH_RETIRE_FRAMES, "Resize would destroy transient images that are still in flight");
+
+struct demo_frame
+{
+    vk_commands Commands;
+    VkSemaphore ImageAvailableSemaphore;
+    VkSemaphore FinishedRenderingSemaphore;
+    frame_staging Staging;
+    worker_command_buffers WorkerCommands;
+};
+
+// NOTE: What the copy to swap pass of one frame draws into, the framebuffer is the one of the swap chain image that frame acquired
+struct demo_copy_to_swap_pass
+{
+    VkFramebuffer FrameBuffer;
+    VkDescriptorSet Descriptor;
+    u32 Width;
+    u32 Height;
 };
 
 struct demo_state
@@ -117,6 +250,11 @@ struct demo_state
     linear_arena Arena;
     linear_arena TempArena;
 
+    // NOTE: What we enabled on the device, everything optional has a fallback when the device doesn't have it
+    u32 QueueFamilyIndex;
+    VkPhysicalDeviceFeatures DeviceFeatures;
+    b32 DrawIndirectCountEnabled;
+
     // NOTE: Samplers
     VkSampler PointSampler;
     VkSampler LinearSampler;
@@ -124,11 +262,23 @@ struct demo_state
 
     // NOTE: Render Target Entries
     VkFormat SwapChainFormat;
-    render_target_entry SwapChainEntry;
-    render_target CopyToSwapTarget;
+    // NOTE: Our own copy of the swap chain images and views, a recreate can hand back more images than we had before. Every image has
+    // its own copy to swap framebuffer, those only get rebuilt (and the old ones retired) when the swap chain gets recreated
+    u32 NumSwapChainImages;
+    u32 SwapChainImageCapacity;
+    VkImage* SwapChainImages;
+    VkImageView* SwapChainViews;
+    VkFramebuffer* CopyToSwapFrameBuffers;
+    VkRenderPass CopyToSwapRenderPass;
+    vk_pipeline* CopyToSwapPipeline;
     VkDescriptorSetLayout CopyToSwapDescLayout;
-    VkDescriptorSet CopyToSwapDesc;
-    render_fullscreen_pass CopyToSwapPass;
+    VkDescriptorSet CopyToSwapDescs[TILED_DEFERRED_MAX_FRAME_DESCRIPTORS]; // NOTE: Per frame slot, resizes rewrite them
+    demo_copy_to_swap_pass CopyToSwapPasses[TILED_DEFERRED_MAX_FRAME_DESCRIPTORS];
+
+    // NOTE: Resizes get handled at the start of the next frame, the window can send a bunch of them before that
+    b32 SwapChainResizePending;
+    u32 SwapChainResizeWidth;
+    u32 SwapChainResizeHeight;
 
     render_scene Scene;
 
@@ -137,7 +287,47 @@ struct demo_state
     u32 Cube;
     u32 Sphere;
 
+    // NOTE: Synthetic point lights for benchmarking the light culling paths
+    u32 NumBenchmarkLights;
+    u32 NumBenchmarkLightHandles;
+    u32* BenchmarkLightHandles;
+    b32 AnimateBenchmarkLights; // NOTE: Moves every light each frame, so the whole light array gets transformed and uploaded
+    f32 BenchmarkLightTime;
+    soa_v3 BenchmarkLightBasePos;
+    soa_v3 BenchmarkLightPos;
+
+    // NOTE: Synthetic meshes for benchmarking the GBuffer recording, they only ever get added
+    u32 NumBenchmarkMeshes;
+    u32 NumBenchmarkMeshesAdded;
+
+    // NOTE: Worker 0 is the main thread
+    job_system Jobs;
+    b32 JobsEnabled;
+
+    // NOTE: All our pipelines, saved next to the shaders so warm starts skip the compile
+    pipeline_cache PipelineCache;
+
+    // NOTE: Frames in flight (2 or 3), FrameId counts every frame we recorded
+    u32 NumFramesInFlight;
+    u32 FrameId;
+    VkCommandPool FrameCommandPool;
+    demo_frame Frames[DEMO_MAX_FRAMES_IN_FLIGHT];
+    upload_ring UploadRing;
+    
+    render_graph RenderGraph;
     tiled_deferred_state TiledDeferredState;
+    gpu_profiler Profiler;
+
+#if HEADLESS
+    // NOTE: Offscreen target that replaces the swap chain when we run without a window, it is swap chain image 0
+    vk_linear_arena OffscreenArena;
+    VkImage OffscreenImage;
+    render_target_entry OffscreenEntry;
+    
+    // NOTE: Frame timing, a start + end timestamp per frame in flight
+    VkQueryPool FrameQueryPool;
+    f32 TimestampPeriod;
+#endif
 };
 
 global demo_state* DemoState;
@@ -0,0 +1,71 @@
+
+inline void UploadRingCreate(upload_ring* Ring, VkDeviceSize RegionSize, u32 NumRegions, VkDeviceSize MaxRange)
+{
+    *Ring = {};
+    
+    // NOTE: Every dynamic offset has to satisfy the alignment of both buffer types we bind out of the ring
+    VkPhysicalDeviceProperties Properties;
+    vkGetPhysicalDeviceProperties(RenderState->PhysicalDevice, &Properties);
+    Ring->Alignment = Properties.limits.minUniformBufferOffsetAlignment;
+    if (Properties.limits.minStorageBufferOffsetAlignment > Ring->Alignment)
+    {
+        Ring->Alignment = Properties.limits.minStorageBufferOffsetAlignment;
+    }
+    Ring->RegionSize = (RegionSize + Ring->Alignment - 1) & ~(Ring->Alignment - 1);
+    Ring->NumRegions = NumRegions;
+
+    VkDeviceSize Size = Ring->RegionSize * NumRegions + MaxRange;
+    Assert(Size <= VkDeviceSize(0xFFFFFFFF));
+    
+    VkBufferCreateInfo BufferCreateInfo = {};
+    BufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    BufferCreateInfo.size = Size;
+    BufferCreateInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkCheckResult(vkCreateBuffer(RenderState->Device, &BufferCreateInfo, 0, &Ring->Buffer));
+
+    // NOTE: Prefer device local host visible memory (resizable BAR, integrated GPUs), the GPU reads this data many times per frame
+    VkMemoryRequirements MemoryRequirements;
+    vkGetBufferMemoryRequirements(RenderState->Device, Ring->Buffer, &MemoryRequirements);
+    u32 MemoryTypeId = HostCoherentMemoryTypeGet(MemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    Ring->Memory = VkMemoryAllocate(RenderState->Device, MemoryTypeId, MemoryRequirements.size);
+    VkCheckResult(vkBindBufferMemory(RenderState->Device, Ring->Buffer, Ring->Memory, 0));
+    VkCheckResult(vkMapMemory(RenderState->Device, Ring->Memory, 0, VK_WHOLE_SIZE, 0, (void**)&Ring->Data));
+}
+
+inline void UploadRingRegionBegin(upload_ring* Ring, u32 RegionId)
+{
+    // NOTE: Only once the GPU finished the work that last read this region
+    Assert(RegionId < Ring->NumRegions);
+    Ring->Used = Ring->RegionSize * RegionId;
+    Ring->RegionEnd = Ring->Used + Ring->RegionSize;
+}
+
+inline void* UploadRingPush(upload_ring* Ring, VkDeviceSize Size, u32* OutOffset)
+{
+    VkDeviceSize Offset = (Ring->Used + Ring->Alignment - 1) & ~(Ring->Alignment - 1);
+    Assert(Offset + Size <= Ring->RegionEnd);
+    Ring->Used = Offset + Size;
+
+    *OutOffset = u32(Offset);
+    void* Result = Ring->Data + Offset;
+    return Result;
+}
+
+inline void UploadRingDescriptorWrite(upload_ring* Ring, VkDescriptorSet Set, u32 Binding, VkDescriptorType Type, VkDeviceSize Range)
+{
+    // NOTE: Dynamic descriptors need an explicit range, the offset comes from vkCmdBindDescriptorSets
+    VkDescriptorBufferInfo BufferInfo = {};
+    BufferInfo.buffer = Ring->Buffer;
+    BufferInfo.offset = 0;
+    BufferInfo.range = Range;
+
+    VkWriteDescriptorSet Write = {};
+    Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    Write.dstSet = Set;
+    Write.dstBinding = Binding;
+    Write.descriptorCount = 1;
+    Write.descriptorType = Type;
+    Write.pBufferInfo = &BufferInfo;
+    vkUpdateDescriptorSets(RenderState->Device, 1, &Write, 0, 0);
+}
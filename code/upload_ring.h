@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+
+  NOTE: Persistently mapped host visible buffer that shaders read straight out of, through dynamic uniform/storage buffer offsets. It is
+        split into one region per frame in flight (plus whatever extra regions the caller asks for), a region gets rewound once the
+        fence of the frame that last used it passed. There are no copies or barriers for this data, the queue submit already makes
+        host writes visible to the GPU.
+
+        Dynamic descriptors have a fixed range, so the buffer carries a tail of the largest range past the last region. That way a
+        binding placed at the end of a region never reaches past the end of the buffer.
+
+ */
+
+struct upload_ring
+{
+    VkBuffer Buffer;
+    VkDeviceMemory Memory;
+    u8* Data;
+    VkDeviceSize Alignment;
+    VkDeviceSize RegionSize;
+    u32 NumRegions;
+    
+    VkDeviceSize RegionEnd;
+    VkDeviceSize Used;
+};
+
+#define UploadRingPushStruct(Ring, type, OutOffset) (type*)UploadRingPush(Ring, sizeof(type), OutOffset)
+#define UploadRingPushArray(Ring, type, Count, OutOffset) (type*)UploadRingPush(Ring, sizeof(type)*(Count), OutOffset)